@@ -11,6 +11,7 @@ in vec3 v_Color;
 in float v_Alpha;
 in vec3 v_FragPos;
 in vec3 v_Normal;
+in vec3 v_LayerCoords; // xy inside the tile, z is the layer or negative if there isn't one
 
 struct Light {
     vec2 intensity; // x is brightness, y is range
@@ -19,12 +20,23 @@ struct Light {
 };
 
 uniform sampler2D u_DiffuseMap;
+uniform sampler2DArray u_DiffuseArray; // the tileset split up per tile with mips
+uniform int u_UseTextureArray;
 uniform int u_numLights;
+uniform int u_UseLightMap; // the vertex colors hold the baked light values
 uniform float u_CameraZoom;
 uniform float u_AmbientIntensity;
 uniform vec3 u_AmbientColor;
 uniform Light lights[MAX_MAP_LIGHTS];
 
+vec4 sampleDiffuse()
+{
+    if (u_UseTextureArray == 1 && v_LayerCoords.z >= 0.0) {
+        return texture(u_DiffuseArray, v_LayerCoords);
+    }
+    return texture(u_DiffuseMap, v_TexCoords);
+}
+
 /*
 NOTE: looks really cool, but not really functional for 2d...
 */
@@ -40,8 +52,8 @@ vec3 CalcPointLight(Light light)
     float dist = length(light.origin - v_FragPos.xy);
     float attenuation = 1.0 / (constant + linear * dist + quadratic * (dist * dist));
 
-    vec3 diffuse = diff * texture(u_DiffuseMap, v_TexCoords).rgb;
-    vec3 ambient = u_AmbientColor * texture(u_DiffuseMap, v_TexCoords).rgb;
+    vec3 diffuse = diff * sampleDiffuse().rgb;
+    vec3 ambient = u_AmbientColor * sampleDiffuse().rgb;
 
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -70,11 +82,15 @@ void applyLighting()
 
 void main()
 {
-    if (texture(u_DiffuseMap, v_TexCoords).a < 1.0) {
+    a_Color = sampleDiffuse();
+    if (a_Color.a < 1.0) {
         discard;
     }
-    
-    a_Color = texture(u_DiffuseMap, v_TexCoords);
+
+    if (u_UseLightMap == 1) {
+        a_Color.rgb *= v_Color;
+        return;
+    }
     if (u_numLights == 0) {
         a_Color.rgb *= u_AmbientColor + u_AmbientIntensity;
     }
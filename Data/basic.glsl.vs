@@ -6,6 +6,7 @@ layout(location = 2) in vec3 a_Color;
 layout(location = 3) in float a_Alpha;
 layout(location = 4) in vec2 a_WorldPos;
 layout(location = 5) in vec3 a_Normal;
+layout(location = 6) in vec3 a_LayerCoords;
 
 uniform mat4 u_ViewProjection;
 
@@ -16,6 +17,7 @@ out vec3 v_Color;
 out float v_Alpha;
 out vec3 v_FragPos;
 out vec3 v_Normal;
+out vec3 v_LayerCoords;
 
 void main() {
    mat4 modelMatrix = mat4(1.0);
@@ -25,6 +27,7 @@ void main() {
    v_TexCoords = a_TexCoords;
    v_Color = a_Color;
    v_Alpha = a_Alpha;
+   v_LayerCoords = a_LayerCoords;
    v_FragPos = vec3(modelMatrix * vec4(a_Position, 1.0));
    v_Normal = mat3(transpose(inverse(modelMatrix))) * a_Normal;
    gl_Position = u_ViewProjection * vec4(a_Position, 1.0);
@@ -7,13 +7,30 @@
 
 #define IMAGE_MAJOR "image"
 
-// Load an image file
+// Load an image file, the pixels are always RGBA
 typedef void ( *PFN_ERPLUG_LOADIMAGE )( const char *name, byte **pic, uint32_t *width, uint32_t *height );
 
+// Check the first bytes of a file for the format's signature
+typedef bool ( *PFN_ERPLUG_MATCHIMAGE )( const byte *buf, uint64_t length );
+
+// Decode an image that's already in memory into 3 or 4 channel pixels allocated with GetMemory,
+// returns NULL and sets error on failure
+typedef byte *( *PFN_ERPLUG_DECODEIMAGE )( const byte *buf, uint64_t length, uint32_t *width, uint32_t *height,
+	uint32_t *channels, const char **error );
+
+// Encode 3 or 4 channel pixels into a buffer allocated with GetMemory, NULL if the format can't be written
+typedef byte *( *PFN_ERPLUG_ENCODEIMAGE )( const byte *pic, uint32_t width, uint32_t height, uint32_t channels,
+	uint64_t *length );
+
 struct _ERPlugImageTable
 {
-	uint64_t m_nSize;
+	uint64_t m_nSize; // sizeof the table the plugin was built with, newer fields past it are treated as NULL
 	PFN_ERPLUG_LOADIMAGE m_pfnLoadImage;
+	const char *m_pszName;
+	const char *m_pszExtensions; // space separated, with the dots
+	PFN_ERPLUG_MATCHIMAGE m_pfnMatchImage;
+	PFN_ERPLUG_DECODEIMAGE m_pfnDecodeImage;
+	PFN_ERPLUG_ENCODEIMAGE m_pfnEncodeImage; // optional
 };
 
 #endif // _IIMAGE_H_
@@ -1,62 +1,279 @@
 #include "gln.h"
-#include "stb_image.h"
 #include "Texture.h"
 
-void CTexture::Clear(void)
-{
-    if (mFileBuf)
-        FreeMemory(mFileBuf);
-    if (mTexBuffer)
-        FreeMemory(mTexBuffer);
-    if (mId)
-        glDeleteTextures(1, (const GLuint *)&mId);
-}
+/*
+textureLoad_t: a load that's been handed to an async worker, the worker only ever touches the file and pixel fields
+and the texture pointer is only read and cleared on the main thread
+*/
+struct textureLoad_s {
+    CTexture *texture; // NULL once the texture has been cleared or started another load
+    std::string path;
+    textureReady_t onReady;
 
-void CTexture::Load(const std::string& path)
-{
-    stbi_uc *image;
-    GLint min, mag;
-    
-//    stbi_set_flip_vertically_on_load(true);
-    image = stbi_load(path.c_str(), (int *)&mWidth, (int *)&mHeight, (int *)&mChannels, 0);
-    if (!image) {
-        Printf("[CTexture::Load] failed to load texture file '%s', stbimage error message: %s", path.c_str(), stbi_failure_reason());
-        return;
-    }
+    byte *pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint64_t hash;
+    uint64_t prevHash; // what the texture had when the load started
+    bool unchanged; // same contents as what's already uploaded, nothing to do
+    bool cached; // came out of the texture cache instead of the decoder
+    const char *error;
+    uint64_t fileSize;
+    uint64_t decodeTime;
+};
 
-    mTexBuffer = image;
-    LoadFile(path.c_str(), (void **)&mFileBuf);
-
-    Printf("[CTexture::Load] Initializing OpenGL texture object...");
-    if (mName != path)
-        mName = path;
-    
+static void Texture_GetFilters(GLint *min, GLint *mag)
+{
     switch (gameConfig->mTextureFiltering) {
     case 0: // Nearest
-        min = GL_NEAREST;
-        mag = GL_NEAREST;
+        *min = GL_NEAREST;
+        *mag = GL_NEAREST;
         break;
     case 1: // Linear
-        min = GL_LINEAR;
-        mag = GL_LINEAR;
+        *min = GL_LINEAR;
+        *mag = GL_LINEAR;
         break;
     case 2: // Bilinear
-        min = GL_NEAREST;
-        mag = GL_LINEAR;
+        *min = GL_NEAREST;
+        *mag = GL_LINEAR;
         break;
     case 3: // Trilinear
-        min = GL_LINEAR;
-        mag = GL_NEAREST;
+    default:
+        *min = GL_LINEAR;
+        *mag = GL_NEAREST;
         break;
     };
+}
+
+/*
+Texture_Decode: runs on an async worker, maps the file in once and either pulls the pixels out of the texture cache
+by the file's hash or decodes them straight out of the mapping with whichever codec recognizes it
+*/
+static void Texture_Decode(textureLoad_t *load)
+{
+    PROFILE_FUNC();
+    const uint64_t start = Sys_Microseconds();
+    const byte *file;
+
+    file = (const byte *)Sys_MapFile(load->path.c_str(), &load->fileSize);
+    if (!file) {
+        load->error = "failed to open file";
+        return;
+    }
+
+    load->hash = HashData(file, load->fileSize);
+    if (load->hash == load->prevHash) {
+        Sys_UnmapFile(file, load->fileSize);
+        load->unchanged = true;
+        return;
+    }
+
+    load->pixels = TexCache_Load(load->hash, load->fileSize, &load->width, &load->height, &load->channels);
+    if (load->pixels) {
+        Sys_UnmapFile(file, load->fileSize);
+        load->cached = true;
+        load->decodeTime = Sys_Microseconds() - start;
+        return;
+    }
+
+    load->pixels = Image_Decode(file, load->fileSize, &load->width, &load->height, &load->channels, &load->error);
+    Sys_UnmapFile(file, load->fileSize);
+    if (!load->pixels) {
+        return;
+    }
+    load->decodeTime = Sys_Microseconds() - start;
+
+    // writing the cache entry shouldn't hold up the upload
+    {
+        const uint64_t size = (uint64_t)load->width * load->height * load->channels;
+        byte *copy = (byte *)GetMemory(size);
+        const std::string name = GetFilename(load->path.c_str());
+        const uint64_t fileSize = load->fileSize;
+        const uint64_t hash = load->hash;
+        const uint32_t w = load->width, h = load->height, c = load->channels;
+
+        memcpy(copy, load->pixels, size);
+        Job_Async([=](void) {
+            TexCache_Store(hash, fileSize, name.c_str(), copy, w, h, c);
+            FreeMemory(copy);
+        });
+    }
+}
+
+void CTexture::Clear(void)
+{
+    if (mLoad) {
+        mLoad->texture = NULL;
+        mLoad = nullptr;
+    }
+    TexMem_Free((void **)&mTexBuffer);
+    if (mId)
+        glDeleteTextures(1, (const GLuint *)&mId);
+    mId = 0;
+    mWidth = mHeight = mChannels = 0;
+    mHash = 0;
+}
+
+/*
+CTexture::Pixels: the decoded pixels, read back from the texture if texmem purged them. Don't hold on to the
+pointer past the end of the frame.
+*/
+const byte *CTexture::Pixels(void)
+{
+    uint64_t size;
+    byte *pixels;
+
+    if (mTexBuffer) {
+        TexMem_Touch((void **)&mTexBuffer);
+        return mTexBuffer;
+    }
+    if (!IsLoaded()) {
+        return NULL;
+    }
+
+    PROFILE_FUNC();
+    size = (uint64_t)mWidth * mHeight * mChannels;
+    pixels = (byte *)GetMemory(size);
+
+    Bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, mChannels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    Unbind();
+
+    TexMem_Add(pixels, size, (void **)&mTexBuffer, mName.c_str());
+
+    return mTexBuffer;
+}
+
+/*
+CTexture::CreatePlaceholder: a 2x2 checkerboard shown until the first load has been uploaded
+*/
+void CTexture::CreatePlaceholder(void)
+{
+    const byte pixels[] = {
+        255, 0, 255, 255,   0, 0, 0, 255,
+        0, 0, 0, 255,       255, 0, 255, 255
+    };
+
+    glGenTextures(1, (GLuint *)&mId);
+    Bind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    Unbind();
+}
+
+/*
+CTexture::Load: starts loading the image at path in the background, the texture keeps its id the whole time and
+shows a placeholder (or whatever it had before) until onReady is called on the main thread
+*/
+void CTexture::Load(const std::string& path, const textureReady_t& onReady)
+{
+    std::shared_ptr<textureLoad_t> load;
+
+    // only the newest load gets uploaded
+    if (mLoad) {
+        mLoad->texture = NULL;
+    }
+
+    if (mName != path)
+        mName = path;
+    if (!mId)
+        CreatePlaceholder();
+
+    load = std::make_shared<textureLoad_t>();
+    load->texture = this;
+    load->path = path;
+    load->onReady = onReady;
+    load->prevHash = IsLoaded() ? mHash : 0;
+    mLoad = load;
+
+    Job_Async([load](void) {
+        Texture_Decode(load.get());
+        Job_QueueMain([load](void) {
+            if (!load->texture) {
+                if (load->pixels) {
+                    FreeMemory(load->pixels);
+                }
+                return;
+            }
+            load->texture->Upload(load.get());
+        });
+    });
+}
+
+/*
+CTexture::Upload: finishes a load on the main thread, the pixels are staged through a pixel buffer so the driver
+can copy them over without stalling on the texture
+*/
+void CTexture::Upload(textureLoad_t *load)
+{
+    PROFILE_FUNC();
+    const uint64_t size = (uint64_t)load->width * load->height * load->channels;
+    const GLenum format = load->channels == 4 ? GL_RGBA : GL_RGB;
+    GLint min, mag;
+    GLuint pbo;
+    void *data;
+
+    mLoad = nullptr;
+    if (load->unchanged) {
+        if (load->onReady) {
+            load->onReady(this);
+        }
+        return;
+    }
+    if (!load->pixels) {
+        Printf("[CTexture::Load] failed to load texture file '%s', %s", load->path.c_str(), load->error);
+        return;
+    }
+
+    // the copy stays around for the tileset's analysis until texmem needs the room back
+    TexMem_Add(load->pixels, size, (void **)&mTexBuffer, load->path.c_str());
+    mWidth = load->width;
+    mHeight = load->height;
+    mChannels = load->channels;
+    mHash = load->hash;
+    load->pixels = NULL;
+
+    Texture_GetFilters(&min, &mag);
+
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (data) {
+        memcpy(data, mTexBuffer, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else {
+        // upload straight from the client copy instead
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
 
     Bind();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D, 0, mChannels == 4 ? GL_RGBA8 : GL_RGB8, mWidth, mHeight, 0, mChannels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, image);
+    // RGB rows aren't always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, mChannels == 4 ? GL_RGBA8 : GL_RGB8, mWidth, mHeight, 0, format, GL_UNSIGNED_BYTE,
+        data ? NULL : mTexBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     Unbind();
 
-    Printf("[CTexture::Load] done");
+    // the driver holds on to the storage until the copy is done
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+
+    Printf("[CTexture::Load] loaded '%s', %ux%u, %lu bytes read, %s in %.3f ms", load->path.c_str(), load->width, load->height,
+        load->fileSize, load->cached ? "read from the cache" : "decoded", load->decodeTime / 1000.0);
+
+    if (load->onReady) {
+        load->onReady(this);
+    }
 }
@@ -3,12 +3,15 @@
 
 #pragma once
 
+class CTexture;
+typedef struct textureLoad_s textureLoad_t;
+typedef std::function<void(CTexture *texture)> textureReady_t;
+
 class CTexture
 {
 public:
     std::string mName;
-    byte *mTexBuffer;
-    char *mFileBuf;
+    byte *mTexBuffer; // the decoded pixels, owned by texmem and NULL once purged, use Pixels() to get them
     uint32_t mId;
     uint32_t mMinFilter;
     uint32_t mMagFilter;
@@ -16,25 +19,36 @@ public:
     uint32_t mWidth;
     uint32_t mHeight;
     uint32_t mChannels;
+    uint64_t mHash; // of the source file's contents, a load of the same contents is skipped
 
     CTexture(const std::string& path)
-        : mName{ GetFilename(path.c_str()) }, mTexBuffer{ NULL }, mFileBuf{ NULL }, mId{ 0 }, mMinFilter{ GL_NEAREST }, mMagFilter{ GL_NEAREST },
-        mSamples{ 0 }, mWidth{ 0 }, mHeight{ 0 }
+        : mName{ GetFilename(path.c_str()) }, mTexBuffer{ NULL }, mId{ 0 }, mMinFilter{ GL_NEAREST }, mMagFilter{ GL_NEAREST },
+        mSamples{ 0 }, mWidth{ 0 }, mHeight{ 0 }, mChannels{ 0 }, mHash{ 0 }
     { Load(path); }
     CTexture(void)
-        : mName{ "None" }, mTexBuffer{ NULL }, mFileBuf{ NULL }, mId{ 0 }, mMinFilter{ GL_NEAREST }, mMagFilter{ GL_NEAREST },
-        mSamples{ 0 }, mWidth{ 0 }, mHeight{ 0 }
+        : mName{ "None" }, mTexBuffer{ NULL }, mId{ 0 }, mMinFilter{ GL_NEAREST }, mMagFilter{ GL_NEAREST },
+        mSamples{ 0 }, mWidth{ 0 }, mHeight{ 0 }, mChannels{ 0 }, mHash{ 0 }
     { }
     ~CTexture()
     { Clear(); }
 
     void Clear(void);
-    void Load(const std::string& path);
+    void Load(const std::string& path, const textureReady_t& onReady = nullptr);
+    INLINE bool IsLoading(void) const
+    { return mLoad != nullptr; }
+    INLINE bool IsLoaded(void) const
+    { return mWidth != 0; }
+    const byte *Pixels(void);
     
     INLINE void Bind(void) const
     { glBindTexture(GL_TEXTURE_2D, mId); }
     INLINE void Unbind(void) const
     { glBindTexture(GL_TEXTURE_2D, 0); }
+private:
+    std::shared_ptr<textureLoad_t> mLoad; // the load in flight, if there is one
+
+    void CreatePlaceholder(void);
+    void Upload(textureLoad_t *load);
 };
 
-#endif
\ No newline at end of file
+#endif
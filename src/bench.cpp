@@ -0,0 +1,268 @@
+#include "gln.h"
+#include <time.h>
+
+glStats_t glStats;
+
+typedef struct {
+    float x;
+    float y;
+    float zoom;
+    float rotation;
+} benchKeyframe_t;
+
+static uint64_t Bench_TexelSize(GLenum format, GLenum type)
+{
+    uint64_t components, size;
+
+    switch (format) {
+    case GL_RED: components = 1; break;
+    case GL_RG: components = 2; break;
+    case GL_RGB:
+    case GL_BGR: components = 3; break;
+    default: components = 4; break;
+    }
+    switch (type) {
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT: size = 2; break;
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT: size = 4; break;
+    default: size = 1; break;
+    }
+
+    return components * size;
+}
+
+/*
+the procs the editor's renderer uses, each one gets a hook that counts it before calling the driver's version
+*/
+#define BENCH_GL_PROCS \
+    BENCH_GLPROC( void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices), \
+        glStats.drawCalls++ ) \
+    BENCH_GLPROC( void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count), glStats.drawCalls++ ) \
+    BENCH_GLPROC( void, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage), \
+        glStats.bytesUploaded += data ? size : 0 ) \
+    BENCH_GLPROC( void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data), \
+        glStats.bytesUploaded += size ) \
+    BENCH_GLPROC( void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, \
+        GLenum format, GLenum type, const void *pixels), (target, level, internalformat, width, height, border, format, type, pixels), \
+        glStats.bytesUploaded += pixels ? Bench_TexelSize(format, type) * width * height : 0 ) \
+    BENCH_GLPROC( void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, \
+        GLenum format, GLenum type, const void *pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels), \
+        glStats.bytesUploaded += Bench_TexelSize(format, type) * width * height ) \
+    BENCH_GLPROC( void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param), ) \
+    BENCH_GLPROC( void, glBindTexture, (GLenum target, GLuint texture), (target, texture), ) \
+    BENCH_GLPROC( void, glActiveTexture, (GLenum texture), (texture), ) \
+    BENCH_GLPROC( void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer), ) \
+    BENCH_GLPROC( void, glBindVertexArray, (GLuint array), (array), ) \
+    BENCH_GLPROC( void, glUseProgram, (GLuint program), (program), ) \
+    BENCH_GLPROC( GLint, glGetUniformLocation, (GLuint program, const GLchar *name), (program, name), ) \
+    BENCH_GLPROC( void, glUniform1i, (GLint location, GLint v0), (location, v0), ) \
+    BENCH_GLPROC( void, glUniform1f, (GLint location, GLfloat v0), (location, v0), ) \
+    BENCH_GLPROC( void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1), ) \
+    BENCH_GLPROC( void, glUniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2), ) \
+    BENCH_GLPROC( void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), \
+        (location, count, transpose, value), ) \
+    BENCH_GLPROC( void, glEnable, (GLenum cap), (cap), ) \
+    BENCH_GLPROC( void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor), ) \
+    BENCH_GLPROC( void, glClear, (GLbitfield mask), (mask), ) \
+    BENCH_GLPROC( void, glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha), ) \
+    BENCH_GLPROC( void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), )
+
+#define BENCH_GLPROC( ret, name, params, args, stat ) \
+static decltype(glad_##name) real_##name; \
+static ret GLAD_API_PTR Hook_##name params \
+{ \
+    glStats.calls++; \
+    stat; \
+    return real_##name args; \
+}
+BENCH_GL_PROCS
+#undef BENCH_GLPROC
+
+/*
+GL_HookStats: swaps glad's function pointers for the counting hooks, must be called after the procs are loaded
+*/
+void GL_HookStats(void)
+{
+    static bool hooked = false;
+
+    if (hooked) {
+        return;
+    }
+    hooked = true;
+
+#define BENCH_GLPROC( ret, name, params, args, stat ) \
+    real_##name = glad_##name; \
+    glad_##name = Hook_##name;
+    BENCH_GL_PROCS
+#undef BENCH_GLPROC
+}
+
+static uint64_t Bench_ThreadCPUMicroseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+Bench_LoadCamera: reads a camera path in the form of { "keyframes": [ { "x", "y", "zoom", "rotation" }, ... ] },
+the keyframes are spread evenly over the run
+*/
+static void Bench_LoadCamera(const char *path, std::vector<benchKeyframe_t>& keyframes)
+{
+    json data;
+
+    if (!LoadJSON(data, path)) {
+        Error("Bench_LoadCamera: failed to load camera path '%s'", path);
+    }
+    if (!data.contains("keyframes") || !data["keyframes"].is_array() || data["keyframes"].empty()) {
+        Error("Bench_LoadCamera: camera path '%s' has no keyframes", path);
+    }
+
+    for (const auto& it : data["keyframes"]) {
+        keyframes.push_back({
+            it.value("x", 0.0f),
+            it.value("y", 0.0f),
+            it.value("zoom", 1.5f),
+            it.value("rotation", 0.0f)
+        });
+    }
+}
+
+/*
+Bench_DefaultCamera: circles the map's center while zooming out far enough to fit the whole map in and back again
+*/
+static void Bench_DefaultCamera(std::vector<benchKeyframe_t>& keyframes)
+{
+    const uint32_t numKeyframes = 16;
+    const float maxZoom = 1.5f + std::max(mapData->mWidth, mapData->mHeight) / 6.0f;
+
+    for (uint32_t i = 0; i <= numKeyframes; i++) {
+        const float angle = (float)i / numKeyframes * 2.0f * M_PI;
+
+        keyframes.push_back({
+            cosf(angle) * mapData->mWidth * 0.25f,
+            mapData->mHeight * 0.5f + sinf(angle) * mapData->mHeight * 0.25f,
+            1.5f + (maxZoom - 1.5f) * 0.5f * (1.0f - cosf(angle)),
+            0.0f
+        });
+    }
+}
+
+static void Bench_SetCamera(const std::vector<benchKeyframe_t>& keyframes, uint32_t frame, uint32_t numFrames)
+{
+    const float t = numFrames > 1 ? (float)frame / (numFrames - 1) * (keyframes.size() - 1) : 0.0f;
+    const uint32_t key = std::min((uint32_t)t, (uint32_t)keyframes.size() - 1);
+    const benchKeyframe_t *a = &keyframes[key];
+    const benchKeyframe_t *b = &keyframes[std::min(key + 1, (uint32_t)keyframes.size() - 1)];
+    const float frac = t - key;
+
+    gui->mCameraPos.x = a->x + (b->x - a->x) * frac;
+    gui->mCameraPos.y = a->y + (b->y - a->y) * frac;
+    gui->mCameraZoom = a->zoom + (b->zoom - a->zoom) * frac;
+    gui->mCameraRotation = a->rotation + (b->rotation - a->rotation) * frac;
+}
+
+/*
+Bench_Run: renders parms->numFrames editor frames along a camera path and writes the cost of each one to parms->output
+*/
+int Bench_Run(const benchParms_t *parms)
+{
+    std::vector<benchKeyframe_t> keyframes;
+    json data, frame;
+    uint64_t cpuStart, wallStart, cpuTime, wallTime;
+    uint64_t totalCPU, totalWall, maxCPU, totalCalls, totalBytes;
+
+    if (!gui->mHeadless) {
+        Error("Bench_Run: the benchmark needs a headless window");
+    }
+
+    GL_HookStats();
+
+    if (!N_stricmp(GetExtension(parms->path), "proj")) {
+        Project_Load(parms->path);
+    }
+    else {
+        Project_New();
+        Map_Load(parms->path);
+    }
+    // the textures have to be there before anything is measured
+    Job_Flush();
+
+    if (parms->camera) {
+        Bench_LoadCamera(parms->camera, keyframes);
+    }
+    else {
+        Bench_DefaultCamera(keyframes);
+    }
+
+    Printf("Bench_Run: rendering %u frames of '%s' with %s", parms->numFrames, parms->path, (const char *)glGetString(GL_RENDERER));
+
+    // the first frame compiles shaders and builds ImGui's font atlas, keep it out of the results
+    gui->BeginFrame();
+    editor->Draw();
+    gui->EndFrame();
+    glFinish();
+
+    data["path"] = parms->path;
+    data["renderer"] = (const char *)glGetString(GL_RENDERER);
+    data["mapWidth"] = mapData->mWidth;
+    data["mapHeight"] = mapData->mHeight;
+    data["frames"] = json::array();
+
+    totalCPU = totalWall = maxCPU = totalCalls = totalBytes = 0;
+    for (uint32_t i = 0; i < parms->numFrames; i++) {
+        Bench_SetCamera(keyframes, i, parms->numFrames);
+        memset(&glStats, 0, sizeof(glStats));
+        Profile_BeginFrame();
+
+        wallStart = Sys_Microseconds();
+        cpuStart = Bench_ThreadCPUMicroseconds();
+
+        gui->BeginFrame();
+        editor->Draw();
+        gui->EndFrame();
+
+        cpuTime = Bench_ThreadCPUMicroseconds() - cpuStart;
+        glFinish(); // wall time includes the rasterizer catching up
+        wallTime = Sys_Microseconds() - wallStart;
+
+        frame["frame"] = i;
+        frame["cpuMs"] = cpuTime / 1000.0;
+        frame["wallMs"] = wallTime / 1000.0;
+        frame["glCalls"] = glStats.calls;
+        frame["drawCalls"] = glStats.drawCalls;
+        frame["bytesUploaded"] = glStats.bytesUploaded;
+        data["frames"].push_back(frame);
+
+        totalCPU += cpuTime;
+        totalWall += wallTime;
+        maxCPU = std::max(maxCPU, cpuTime);
+        totalCalls += glStats.calls;
+        totalBytes += glStats.bytesUploaded;
+    }
+
+    if (parms->numFrames) {
+        data["summary"]["avgCpuMs"] = totalCPU / 1000.0 / parms->numFrames;
+        data["summary"]["maxCpuMs"] = maxCPU / 1000.0;
+        data["summary"]["avgWallMs"] = totalWall / 1000.0 / parms->numFrames;
+        data["summary"]["avgGlCalls"] = (double)totalCalls / parms->numFrames;
+        data["summary"]["avgBytesUploaded"] = (double)totalBytes / parms->numFrames;
+    }
+
+    std::ofstream file(parms->output, std::ios::out);
+    if (!file.is_open()) {
+        Error("Bench_Run: failed to open '%s' in write mode", parms->output);
+    }
+    file << data.dump(4);
+    file.close();
+
+    Printf("Bench_Run: %u frames, %.3f ms average cpu time, results written to '%s'", parms->numFrames,
+        parms->numFrames ? totalCPU / 1000.0 / parms->numFrames : 0.0, parms->output);
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef __BENCH__
+#define __BENCH__
+
+#pragma once
+
+/*
+glStats_t: what the editor's renderer asked of GL since the counters were last reset, the calls made by
+ImGui's backend go through its own loader and aren't counted
+*/
+typedef struct {
+    uint64_t calls;
+    uint64_t drawCalls;
+    uint64_t bytesUploaded;
+} glStats_t;
+
+typedef struct {
+    const char *path;       // .proj or .map to load
+    const char *camera;     // json camera path, NULL for the default flight over the map
+    const char *output;     // where the per-frame json goes
+    uint32_t numFrames;
+} benchParms_t;
+
+#define BENCH_DEFAULT_FRAMES 300
+
+extern glStats_t glStats;
+
+void GL_HookStats(void);
+int Bench_Run(const benchParms_t *parms);
+
+#endif
@@ -0,0 +1,403 @@
+#include "gln.h"
+
+const char *BMF_LumpName(int lumpnum)
+{
+    switch (lumpnum) {
+    case LUMP_TILES: return "tiles";
+    case LUMP_CHECKPOINTS: return "checkpoints";
+    case LUMP_SPAWNS: return "spawns";
+    case LUMP_LIGHTS: return "lights";
+    case LUMP_VERTICES: return "vertices";
+    case LUMP_INDICES: return "indices";
+    case LUMP_SPRITES: return "sprites";
+    case LUMP_LIGHTMAP: return "lightmap";
+    case LUMP_COLLISION: return "collision";
+    case LUMP_NAVIGATION: return "navigation";
+    case LUMP_SECTORS: return "sectors";
+    case LUMP_TEXTURE: return "texture";
+    default: break;
+    };
+    return "unknown";
+}
+
+/*
+BMF_LumpRecordSize: the size of one of the lump's records, every lump's length is a multiple of it
+*/
+uint64_t BMF_LumpRecordSize(int lumpnum)
+{
+    switch (lumpnum) {
+    case LUMP_TILES: return sizeof(maptile_t);
+    case LUMP_CHECKPOINTS: return sizeof(mapcheckpoint_t);
+    case LUMP_SPAWNS: return sizeof(mapspawn_t);
+    case LUMP_LIGHTS: return sizeof(maplight_t);
+    case LUMP_VERTICES: return sizeof(mapdrawvert_t);
+    case LUMP_INDICES: return sizeof(uint32_t);
+    case LUMP_SPRITES: return sizeof(tile2d_sprite_t);
+    case LUMP_LIGHTMAP: return sizeof(maplightsample_t);
+    case LUMP_COLLISION: return sizeof(mapcollider_t);
+    case LUMP_NAVIGATION: return 1; // more than one kind of record, see Nav_Load
+    case LUMP_SECTORS: return sizeof(mapsector_t);
+    case LUMP_TEXTURE: return 1; // a maptexheader_t and then the levels
+    default: break;
+    };
+    return 1;
+}
+
+/*
+BMF_ReadHeader: copies the header out of a whole .bmf file and checks that it's one this build understands and that
+every lump is inside of the file
+*/
+bool BMF_ReadHeader(const void *file, uint64_t length, bmf_t *bmf)
+{
+    const byte *data = (const byte *)file;
+
+    if (length < BMF_HEADER_SIZE) {
+        Printf("BMF_ReadHeader: file is too small to be a bmf (%lu bytes)", length);
+        return false;
+    }
+
+    memcpy(&bmf->ident, data, sizeof(bmf->ident));
+    data += sizeof(bmf->ident);
+    memcpy(&bmf->version, data, sizeof(bmf->version));
+    data += sizeof(bmf->version);
+    memcpy(&bmf->tileset, data, sizeof(bmf->tileset));
+    data += sizeof(bmf->tileset);
+    memcpy(&bmf->map, data, sizeof(bmf->map));
+    bmf->tileset.sprites = NULL;
+
+    if (bmf->ident != LEVEL_IDENT || bmf->map.ident != MAP_IDENT) {
+        Printf("BMF_ReadHeader: bad identifier");
+        return false;
+    }
+    if (bmf->version != LEVEL_VERSION || bmf->map.version != MAP_VERSION) {
+        Printf("BMF_ReadHeader: bad version %u.%u, expected %u.%u", bmf->version, bmf->map.version, LEVEL_VERSION, MAP_VERSION);
+        return false;
+    }
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const lump_t *lump = &bmf->map.lumps[i];
+
+        if (lump->fileofs > length || lump->length > length - lump->fileofs) {
+            Printf("BMF_ReadHeader: %s lump is outside of the file", BMF_LumpName(i));
+            return false;
+        }
+        if (lump->compression == COMPRESS_NONE && lump->uncompressedLength != lump->length) {
+            Printf("BMF_ReadHeader: %s lump has a bad length", BMF_LumpName(i));
+            return false;
+        }
+        if (lump->uncompressedLength % BMF_LumpRecordSize(i)) {
+            Printf("BMF_ReadHeader: %s lump isn't a whole number of records (%lu bytes)", BMF_LumpName(i),
+                lump->uncompressedLength);
+            return false;
+        }
+        if (lump->compression > COMPRESS_BZIP2) {
+            Printf("BMF_ReadHeader: %s lump has an unknown compression %u", BMF_LumpName(i), lump->compression);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+BMF_LoadLump: returns a copy of the lump's contents in a buffer from GetMemory, compressed lumps are decompressed into
+it. NULL if the lump is empty or doesn't come out at the size the lump table says.
+*/
+void *BMF_LoadLump(const void *file, uint64_t length, const lump_t *lump, uint64_t *outLength)
+{
+    const byte *data = (const byte *)file + lump->fileofs;
+    const char *error;
+    uint64_t size;
+    char *out;
+
+    *outLength = 0;
+    if (!lump->uncompressedLength || lump->fileofs + lump->length > length) {
+        return NULL;
+    }
+
+    switch (lump->compression) {
+    case COMPRESS_NONE:
+        out = (char *)GetMemory(lump->length);
+        memcpy(out, data, lump->length);
+        size = lump->length;
+        break;
+    case COMPRESS_ZLIB:
+    case COMPRESS_BZIP2:
+        size = lump->uncompressedLength;
+        out = Decompress_Try((void *)data, lump->length, &size, lump->compression, &error);
+        if (!out) {
+            Printf("BMF_LoadLump: failed to decompress %lu bytes (%s)", lump->length, error);
+            return NULL;
+        }
+        break;
+    default:
+        Printf("BMF_LoadLump: unknown compression %u", lump->compression);
+        return NULL;
+    };
+
+    if (size != lump->uncompressedLength) {
+        Printf("BMF_LoadLump: lump came out at %lu bytes instead of %lu", size, lump->uncompressedLength);
+        FreeMemory(out);
+        return NULL;
+    }
+
+    *outLength = size;
+    return out;
+}
+
+/*
+BMF_WriteLump: writes a lump where fp is and fills in its lump_t, padded out so that the next one starts on a whole
+record. Lumps of at least COMPRESSED_LUMP_SIZE bytes are compressed if that makes them any smaller.
+*/
+void BMF_WriteLump(FILE *fp, lump_t *lump, const bmfLumpData_t *data, int compression)
+{
+    static const byte padding[LUMP_ALIGN] = { 0 };
+    char *stored;
+    uint64_t storedSize;
+
+    stored = NULL;
+    storedSize = 0;
+    if (compression != COMPRESS_NONE && data->size >= COMPRESSED_LUMP_SIZE) {
+        stored = Compress((void *)data->data, data->size, &storedSize, compression);
+        if (storedSize >= data->size) {
+            FreeMemory(stored);
+            stored = NULL;
+        }
+    }
+
+    lump->fileofs = ftello64(fp);
+    lump->uncompressedLength = data->size;
+    lump->length = stored ? storedSize : data->size;
+    lump->compression = stored ? compression : COMPRESS_NONE;
+    lump->flags = data->flags;
+
+    if (lump->length) {
+        SafeWrite(stored ? stored : data->data, lump->length, fp);
+        if (PAD(lump->length, LUMP_ALIGN) != lump->length) {
+            SafeWrite(padding, PAD(lump->length, LUMP_ALIGN) - lump->length, fp);
+        }
+    }
+    if (stored) {
+        FreeMemory(stored);
+    }
+}
+
+/*
+BMF_WriteHeader: writes the header over the start of the file, the sprites are in their lump and the pointer would
+only make the same level write out differently
+*/
+void BMF_WriteHeader(FILE *fp, const bmf_t *bmf)
+{
+    tile2d_header_t tileset;
+
+    tileset = bmf->tileset;
+    tileset.sprites = NULL;
+
+    fseeko64(fp, 0, SEEK_SET);
+    SafeWrite(&bmf->ident, sizeof(bmf->ident), fp);
+    SafeWrite(&bmf->version, sizeof(bmf->version), fp);
+    SafeWrite(&tileset, sizeof(tileset), fp);
+    SafeWrite(&bmf->map, sizeof(bmf->map), fp);
+}
+
+/*
+BMF_WriteFile: writes a whole .bmf from lumps that are in memory and fills in bmf's lump table
+*/
+bool BMF_WriteFile(const char *path, bmf_t *bmf, const bmfLumpData_t *lumps, int compression)
+{
+    FILE *fp;
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        Printf("BMF_WriteFile: failed to open '%s' in write mode", path);
+        return false;
+    }
+
+    fseeko64(fp, BMF_HEADER_SIZE, SEEK_SET);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        BMF_WriteLump(fp, &bmf->map.lumps[i], &lumps[i], compression);
+    }
+    BMF_WriteHeader(fp, bmf);
+    fclose(fp);
+
+    return true;
+}
+
+/*
+BMF_Open: maps the file in and checks its header, nothing is loaded until it's asked for
+*/
+bool BMF_Open(const char *path, bmfFile_t *file)
+{
+    memset(file, 0, sizeof(*file));
+
+    file->data = Sys_MapFile(path, &file->length);
+    if (!file->data) {
+        Printf("BMF_Open: failed to open '%s'", path);
+        return false;
+    }
+    if (!BMF_ReadHeader(file->data, file->length, &file->header)) {
+        Printf("BMF_Open: '%s' isn't a bmf this build can read", path);
+        BMF_Close(file);
+        return false;
+    }
+    return true;
+}
+
+void BMF_Close(bmfFile_t *file)
+{
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        if (file->copies[i]) {
+            FreeMemory(file->copies[i]);
+        }
+    }
+    Sys_UnmapFile(file->data, file->length);
+    memset(file, 0, sizeof(*file));
+}
+
+/*
+BMF_GetLump: the lump's contents, straight out of the mapping if it isn't compressed and sits where its records can
+be read from. NULL if it's empty or failed to load.
+*/
+const void *BMF_GetLump(bmfFile_t *file, int lumpnum, uint64_t *length)
+{
+    const lump_t *lump;
+    uint64_t size;
+
+    *length = 0;
+    if (lumpnum < 0 || lumpnum >= NUMLUMPS) {
+        return NULL;
+    }
+    lump = &file->header.map.lumps[lumpnum];
+
+    if (!file->loaded[lumpnum]) {
+        file->loaded[lumpnum] = true;
+
+        if (lump->compression == COMPRESS_NONE && !(lump->fileofs % LUMP_ALIGN)) {
+            file->lumps[lumpnum] = lump->length ? (const byte *)file->data + lump->fileofs : NULL;
+        }
+        else {
+            file->copies[lumpnum] = BMF_LoadLump(file->data, file->length, lump, &size);
+            file->lumps[lumpnum] = file->copies[lumpnum];
+            if (lump->uncompressedLength && !file->copies[lumpnum]) {
+                Printf("BMF_GetLump: failed to load the %s lump", BMF_LumpName(lumpnum));
+            }
+        }
+    }
+
+    if (file->lumps[lumpnum]) {
+        *length = lump->uncompressedLength;
+    }
+    return file->lumps[lumpnum];
+}
+
+/*
+BMF_GetTexture: the embedded tileset texture's levels, ready to be uploaded as they are. False if the level
+references its texture instead or the lump doesn't hold what its header says.
+*/
+bool BMF_GetTexture(bmfFile_t *file, bmfTexture_t *texture)
+{
+    const maptexheader_t *header;
+    const byte *pixels;
+    uint32_t width, height;
+    uint64_t length, size;
+
+    memset(texture, 0, sizeof(*texture));
+    header = (const maptexheader_t *)BMF_GetLump(file, LUMP_TEXTURE, &length);
+    if (!header) {
+        return false;
+    }
+    if (length < sizeof(*header) || header->info.ident != TEX2D_IDENT || header->info.version != TEX2D_VERSION
+        || header->info.channels != 4 || !header->numLevels || header->numLevels > BMF_MAX_TEXTURE_LEVELS) {
+        Printf("BMF_GetTexture: bad texture lump header");
+        return false;
+    }
+
+    pixels = (const byte *)(header + 1);
+    size = 0;
+    width = header->info.width;
+    height = header->info.height;
+    for (uint32_t i = 0; i < header->numLevels; i++) {
+        texture->levels[i] = pixels + size;
+        size += (uint64_t)width * height * 4;
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+    }
+    if (size != header->info.compressedSize || size != length - sizeof(*header)) {
+        Printf("BMF_GetTexture: texture lump is %lu bytes, its levels need %lu", length - sizeof(*header), size);
+        memset(texture, 0, sizeof(*texture));
+        return false;
+    }
+    texture->header = header;
+
+    return true;
+}
+
+/*
+BMF_LoadSector: pages in one sector of a sectored level, info comes from its LUMP_SECTORS records. Lumps that are
+stored as they are point into the mapping, the rest are decompressed into copies that BMF_FreeSector frees. It
+doesn't change the file so sectors can be loaded on any thread.
+*/
+bool BMF_LoadSector(const bmfFile_t *file, const mapsector_t *info, bmfSector_t *sector)
+{
+    const lump_t *lump;
+    uint64_t size;
+
+    memset(sector, 0, sizeof(*sector));
+    sector->info = info;
+    if (info->fileofs > file->length || info->length > file->length - info->fileofs) {
+        Printf("BMF_LoadSector: sector is outside of the file");
+        return false;
+    }
+
+    Sys_AdviseMapping((const byte *)file->data + info->fileofs, info->length, true);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        lump = &info->lumps[i];
+
+        if (!lump->uncompressedLength) {
+            continue;
+        }
+        if (lump->fileofs < info->fileofs || lump->fileofs - info->fileofs > info->length
+            || lump->length > info->length - (lump->fileofs - info->fileofs)) {
+            Printf("BMF_LoadSector: %s lump is outside of its sector", BMF_LumpName(i));
+            BMF_FreeSector(file, sector);
+            return false;
+        }
+        if ((lump->compression == COMPRESS_NONE && lump->uncompressedLength != lump->length)
+            || lump->uncompressedLength % BMF_LumpRecordSize(i)) {
+            Printf("BMF_LoadSector: %s lump has a bad length", BMF_LumpName(i));
+            BMF_FreeSector(file, sector);
+            return false;
+        }
+
+        if (lump->compression == COMPRESS_NONE && !(lump->fileofs % LUMP_ALIGN)) {
+            sector->lumps[i] = (const byte *)file->data + lump->fileofs;
+        }
+        else {
+            sector->copies[i] = BMF_LoadLump(file->data, file->length, lump, &size);
+            sector->lumps[i] = sector->copies[i];
+            if (!sector->copies[i]) {
+                Printf("BMF_LoadSector: failed to load the %s lump", BMF_LumpName(i));
+                BMF_FreeSector(file, sector);
+                return false;
+            }
+        }
+        sector->lengths[i] = lump->uncompressedLength;
+    }
+
+    return true;
+}
+
+/*
+BMF_FreeSector: lets go of a sector, its part of the mapping is handed back to the system until it's loaded again
+*/
+void BMF_FreeSector(const bmfFile_t *file, bmfSector_t *sector)
+{
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        if (sector->copies[i]) {
+            FreeMemory(sector->copies[i]);
+        }
+    }
+    if (sector->info) {
+        Sys_AdviseMapping((const byte *)file->data + sector->info->fileofs, sector->info->length, false);
+    }
+    memset(sector, 0, sizeof(*sector));
+}
@@ -0,0 +1,113 @@
+#ifndef __BMF__
+#define __BMF__
+
+#pragma once
+
+/*
+reading compiled .bmf levels, shared between the compiler and anything that loads them. The header is written as
+ident, version, the tileset header and then the map header with its lump table.
+*/
+
+#define BMF_HEADER_SIZE (sizeof(uint32_t) * 2 + sizeof(tile2d_header_t) + sizeof(mapheader_t))
+
+const char *BMF_LumpName(int lumpnum);
+uint64_t BMF_LumpRecordSize(int lumpnum);
+bool BMF_ReadHeader(const void *file, uint64_t length, bmf_t *bmf);
+void *BMF_LoadLump(const void *file, uint64_t length, const lump_t *lump, uint64_t *outLength);
+
+/*
+bmfFile_t: a .bmf mapped in read-only. Lumps that are stored as they are get read straight out of the mapping, the
+compressed ones are decompressed the first time they're asked for and kept until the file is closed. Loading a lump
+isn't safe from more than one thread at a time, reading one that's already loaded is.
+*/
+typedef struct {
+    const void *data;
+    uint64_t length;
+    bmf_t header;
+    const void *lumps[NUMLUMPS]; // NULL until it's loaded, and for empty lumps
+    void *copies[NUMLUMPS]; // the decompressed ones, owned by the file
+    bool loaded[NUMLUMPS];
+} bmfFile_t;
+
+/*
+bmfSpan_t: the records of a lump without copying them, only valid until the file is closed
+*/
+template<typename T>
+struct bmfSpan_t {
+    const T *data;
+    uint64_t count;
+
+    INLINE const T *begin(void) const { return data; }
+    INLINE const T *end(void) const { return data + count; }
+    INLINE const T& operator[](uint64_t index) const { return data[index]; }
+    INLINE uint64_t size(void) const { return count; }
+    INLINE bool empty(void) const { return !count; }
+};
+
+/*
+bmfLumpData_t: a lump for BMF_WriteFile, flags are LUMPFLAG_*
+*/
+typedef struct {
+    const void *data;
+    uint64_t size;
+    uint32_t flags;
+} bmfLumpData_t;
+
+void BMF_WriteLump(FILE *fp, lump_t *lump, const bmfLumpData_t *data, int compression);
+void BMF_WriteHeader(FILE *fp, const bmf_t *bmf);
+bool BMF_WriteFile(const char *path, bmf_t *bmf, const bmfLumpData_t *lumps, int compression);
+
+bool BMF_Open(const char *path, bmfFile_t *file);
+void BMF_Close(bmfFile_t *file);
+const void *BMF_GetLump(bmfFile_t *file, int lumpnum, uint64_t *length);
+
+#define BMF_MAX_TEXTURE_LEVELS 32
+
+/*
+bmfTexture_t: LUMP_TEXTURE read in place, level i is half the size of the one before it
+*/
+typedef struct {
+    const maptexheader_t *header;
+    const byte *levels[BMF_MAX_TEXTURE_LEVELS];
+} bmfTexture_t;
+
+bool BMF_GetTexture(bmfFile_t *file, bmfTexture_t *texture);
+
+/*
+bmfSector_t: the lumps of one sector of a sectored level, NULL for the empty ones and the ones that aren't split up
+*/
+typedef struct {
+    const mapsector_t *info;
+    const void *lumps[NUMLUMPS];
+    void *copies[NUMLUMPS]; // the decompressed ones
+    uint64_t lengths[NUMLUMPS];
+} bmfSector_t;
+
+bool BMF_LoadSector(const bmfFile_t *file, const mapsector_t *info, bmfSector_t *sector);
+void BMF_FreeSector(const bmfFile_t *file, bmfSector_t *sector);
+
+/*
+BMF_GetRecords: the lump as an array of T, which has to be the lump's record type. Empty if the lump is or if it
+failed to load.
+*/
+template<typename T>
+inline bmfSpan_t<T> BMF_GetRecords(bmfFile_t *file, int lumpnum)
+{
+    bmfSpan_t<T> span = { NULL, 0 };
+    const void *data;
+    uint64_t length;
+
+    if (sizeof(T) != BMF_LumpRecordSize(lumpnum)) {
+        Printf("BMF_GetRecords: %lu byte records asked for from the %s lump, which has %lu byte records", sizeof(T),
+            BMF_LumpName(lumpnum), BMF_LumpRecordSize(lumpnum));
+        return span;
+    }
+    data = BMF_GetLump(file, lumpnum, &length);
+    if (data) {
+        span.data = (const T *)data;
+        span.count = length / sizeof(T);
+    }
+    return span;
+}
+
+#endif
@@ -0,0 +1,203 @@
+// bmfinfo.cpp: prints what's inside of compiled .bmf files
+
+#ifndef BMFC
+    #define BMFC
+#endif // BMFC
+#include "gln.h"
+#include <filesystem>
+inline const std::filesystem::path pwdString = std::filesystem::current_path();
+#include "gln.cpp"
+#include "stream.cpp"
+#include "bmf.cpp"
+
+/*
+PrintSectors: loads every sector of a sectored level once, returns false if any of them didn't
+*/
+static bool PrintSectors(bmfFile_t *file, bool listRecords)
+{
+    const bmfSpan_t<mapsector_t> sectors = BMF_GetRecords<mapsector_t>(file, LUMP_SECTORS);
+    uint64_t time, totalTime, smallest, largest, records[NUMLUMPS];
+    bmfSector_t sector;
+    bool ok;
+
+    ok = true;
+    totalTime = 0;
+    smallest = UINT64_MAX;
+    largest = 0;
+    memset(records, 0, sizeof(records));
+    for (const auto& it : sectors) {
+        time = Sys_Microseconds();
+        if (!BMF_LoadSector(file, &it, &sector)) {
+            Printf("  sector %u %u failed to load", it.mins[0], it.mins[1]);
+            ok = false;
+            continue;
+        }
+        totalTime += Sys_Microseconds() - time;
+        smallest = std::min(smallest, it.length);
+        largest = std::max(largest, it.length);
+        for (uint32_t i = 0; i < NUMLUMPS; i++) {
+            records[i] += sector.lengths[i] / BMF_LumpRecordSize(i);
+        }
+
+        if (listRecords) {
+            Printf("  sector     %u %u to %u %u, bounds ( %g %g ) to ( %g %g ), %lu bytes at %lu, %lu tiles, %lu quads, "
+                "%lu lights", it.mins[0], it.mins[1], it.maxs[0], it.maxs[1], it.boundsMins[0], it.boundsMins[1],
+                it.boundsMaxs[0], it.boundsMaxs[1], it.length, it.fileofs, sector.lengths[LUMP_TILES] / sizeof(maptile_t),
+                sector.lengths[LUMP_INDICES] / (sizeof(uint32_t) * 6), sector.lengths[LUMP_LIGHTS] / sizeof(maplight_t));
+        }
+        BMF_FreeSector(file, &sector);
+    }
+
+    if (!sectors.empty()) {
+        Printf("  %lu sectors of %lu to %lu bytes, %.3f ms average load, %lu tiles, %lu vertices, %lu indices in them",
+            sectors.size(), smallest, largest, totalTime / 1000.0 / sectors.size(), records[LUMP_TILES],
+            records[LUMP_VERTICES], records[LUMP_INDICES]);
+    }
+    return ok;
+}
+
+static const char *CompressionString(uint32_t compression)
+{
+    switch (compression) {
+    case COMPRESS_NONE: return "none";
+    case COMPRESS_ZLIB: return "zlib";
+    case COMPRESS_BZIP2: return "bzip2";
+    default: break;
+    };
+    return "unknown";
+}
+
+/*
+PrintInfo: the header and every lump of a file, the checksum is the HashData of the lump once it's decompressed so
+it can be compared between files that were compressed differently. Returns false if anything didn't load.
+*/
+static bool PrintInfo(const char *path, bool listRecords)
+{
+    const tile2d_info_t *info;
+    const void *data;
+    uint64_t length, time, totalSize, totalStored;
+    bmfFile_t file;
+    bool ok;
+
+    if (!BMF_Open(path, &file)) {
+        return false;
+    }
+    info = &file.header.tileset.info;
+
+    Printf("%s: %lu bytes, level version %u, map version %u", path, file.length, file.header.version,
+        file.header.map.version);
+    Printf("  tileset '%s', %ux%u tiles of %ux%u, %u sprites", info->texture, info->tileCountX, info->tileCountY,
+        info->tileWidth, info->tileHeight, info->numTiles);
+    Printf("  %-12s %10s %10s %12s %12s %7s %6s %9s %16s", "lump", "offset", "records", "bytes", "stored", "ratio",
+        "codec", "load ms", "checksum");
+
+    ok = true;
+    totalSize = totalStored = 0;
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const lump_t *lump = &file.header.map.lumps[i];
+
+        time = Sys_Microseconds();
+        data = BMF_GetLump(&file, i, &length);
+        time = Sys_Microseconds() - time;
+
+        if (lump->uncompressedLength && !data) {
+            Printf("  %-12s failed to load", BMF_LumpName(i));
+            ok = false;
+            continue;
+        }
+
+        Printf("  %-12s %10lu %10lu %12lu %12lu %6.1f%% %6s %9.3f %016lx", BMF_LumpName(i), lump->fileofs,
+            length / BMF_LumpRecordSize(i), lump->uncompressedLength, lump->length,
+            lump->uncompressedLength ? 100.0 * lump->length / lump->uncompressedLength : 100.0,
+            CompressionString(lump->compression), time / 1000.0, HashData(data, length));
+        totalSize += lump->uncompressedLength;
+        totalStored += lump->length;
+    }
+    Printf("  %-12s %10s %10s %12lu %12lu %6.1f%%", "total", "", "", totalSize, totalStored,
+        totalSize ? 100.0 * totalStored / totalSize : 100.0);
+
+    if (file.header.map.lumps[LUMP_TEXTURE].uncompressedLength) {
+        bmfTexture_t texture;
+
+        if (BMF_GetTexture(&file, &texture)) {
+            Printf("  texture '%s' embedded, %ux%u with %u levels, format 0x%x", texture.header->info.name,
+                texture.header->info.width, texture.header->info.height, texture.header->numLevels,
+                texture.header->info.format);
+        }
+        else {
+            ok = false;
+        }
+    }
+
+    if (!PrintSectors(&file, listRecords)) {
+        ok = false;
+    }
+
+    if (listRecords) {
+        const bmfSpan_t<mapspawn_t> spawns = BMF_GetRecords<mapspawn_t>(&file, LUMP_SPAWNS);
+        const bmfSpan_t<mapcheckpoint_t> checkpoints = BMF_GetRecords<mapcheckpoint_t>(&file, LUMP_CHECKPOINTS);
+        const bmfSpan_t<maplight_t> lights = BMF_GetRecords<maplight_t>(&file, LUMP_LIGHTS);
+
+        for (const auto& it : spawns) {
+            Printf("  spawn      %u %u %u, entity type %u, id %u", it.xyz[0], it.xyz[1], it.xyz[2], it.entitytype,
+                it.entityid);
+        }
+        for (const auto& it : checkpoints) {
+            Printf("  checkpoint %u %u %u", it.xyz[0], it.xyz[1], it.xyz[2]);
+        }
+        for (const auto& it : lights) {
+            Printf("  light      %u %u %u, color ( %g %g %g %g ), brightness %g, range %g", it.origin[0], it.origin[1],
+                it.origin[2], it.color[0], it.color[1], it.color[2], it.color[3], it.brightness, it.range);
+        }
+    }
+
+    BMF_Close(&file);
+    return ok;
+}
+
+static void print_help(void)
+{
+    printf(
+        "usage: %s [options...] <files...>\n"
+        "[options]\n"
+        "\t--records        also list the sectors, spawns, checkpoints and lights\n"
+    , myargv[0]);
+}
+
+int main(int argc, char **argv)
+{
+    bool listRecords = false;
+    int numFailed = 0;
+    int numFiles = 0;
+
+    myargc = argc;
+    myargv = argv;
+    if (argc < 2) {
+        print_help();
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (!N_stricmp(argv[i], "--records")) {
+            listRecords = true;
+        }
+        else if (!N_stricmp(argv[i], "--help") || !N_stricmp(argv[i], "-h")) {
+            print_help();
+            return 0;
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            continue;
+        }
+        numFiles++;
+        if (!PrintInfo(argv[i], listRecords)) {
+            numFailed++;
+        }
+    }
+    if (!numFiles) {
+        Error("no bmf files provided");
+    }
+
+    return numFailed ? 1 : 0;
+}
@@ -5,13 +5,226 @@
 #endif // BMFC
 #include "gln.h"
 #include <filesystem>
+#include <atomic>
+#include <sstream>
 inline const std::filesystem::path pwdString = std::filesystem::current_path();
 #include "gln.cpp"
 #include "parse.cpp"
 #include "stream.cpp"
 #include "map.cpp"
+#include "profile.cpp"
+#include "jobs.cpp"
+#include "image.cpp"
+#include "imageio.cpp"
+#include "tile2d.cpp"
+#include "texcache.cpp"
+#include "lightmap.cpp"
+#include "nav.cpp"
+#include "bmf.cpp"
+#include "optimize.cpp"
+#include "sector.cpp"
 
-static tile2d_info_t tilesetInfo;
+#define BMFC_VERSION 7 // bump whenever the same input compiles to something different, batch builds start over
+#define BMFC_BUILD_MANIFEST "bmfc_build.json"
+
+static bool noDedup;
+static int lumpCompression = COMPRESS_NONE;
+static bool compressionReport; // print what every lump was stored as
+static bool optimizeOutput; // run the optimizer over every level once it's written
+static uint32_t sectorSize; // split every level into sectors this many tiles a side, 0 to keep it whole
+static bool embedTexture; // store the tileset's pixels in LUMP_TEXTURE instead of only the texture's path
+
+#define MAP_WINDOW_SIZE (256 * 1024) // map text handed to the parser at a time, grown for a chunk that doesn't fit
+#define SPILL_MEMORY_SIZE (256 * 1024) // bytes of a spill kept in memory before the rest goes to a temporary file
+#define LUMP_STREAM_SIZE (64 * 1024) // lump data moved at a time on its way into the file
+#define COLLISION_STRIP_ROWS 64 // rows of the map that one worker merges colliders in before the strips are stitched
+
+#ifndef GL_NEAREST
+#define GL_NEAREST 0x2600
+#define GL_NEAREST_MIPMAP_NEAREST 0x2700
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+/*
+bmfcSpill_t: records on their way from the parser to the file, the first SPILL_MEMORY_SIZE bytes are kept in memory
+and the rest goes to a temporary file so that a map of any size compiles in the same amount of memory. Written all
+at once and then read back in order, as many times as needed.
+*/
+typedef struct {
+    byte *memory;
+    FILE *fp; // NULL until it's needed
+    uint64_t size;
+    uint64_t readPos;
+    bool failed; // a write didn't make it into the temporary file, what's in it can't be used
+} bmfcSpill_t;
+
+/*
+Spill_Write: adds size bytes to the end, if the temporary file can't be made or written to the spill is marked
+failed and takes nothing more
+*/
+static void Spill_Write(bmfcSpill_t *spill, const void *data, uint64_t size)
+{
+    const byte *in = (const byte *)data;
+    uint64_t count;
+
+    if (spill->failed) {
+        return;
+    }
+    if (spill->size < SPILL_MEMORY_SIZE) {
+        if (!spill->memory) {
+            spill->memory = (byte *)GetMemory(SPILL_MEMORY_SIZE);
+        }
+        count = std::min(size, SPILL_MEMORY_SIZE - spill->size);
+        memcpy(spill->memory + spill->size, in, count);
+        spill->size += count;
+        in += count;
+        size -= count;
+    }
+    if (!size) {
+        return;
+    }
+
+    if (!spill->fp) {
+        spill->fp = tmpfile();
+        if (!spill->fp) {
+            Printf("Spill_Write: failed to create a temporary file, %s", strerror(errno));
+            spill->failed = true;
+            return;
+        }
+    }
+    if (fwrite(in, size, 1, spill->fp) != 1) {
+        Printf("Spill_Write: failed to write %lu bytes to a temporary file, %s", size, strerror(errno));
+        spill->failed = true;
+        return;
+    }
+    spill->size += size;
+}
+
+static void Spill_Rewind(bmfcSpill_t *spill)
+{
+    spill->readPos = 0;
+    if (spill->fp) {
+        fflush(spill->fp);
+        fseeko64(spill->fp, 0, SEEK_SET);
+    }
+}
+
+/*
+Spill_Read: the next size bytes after the last read, returns how many there were
+*/
+static uint64_t Spill_Read(bmfcSpill_t *spill, void *data, uint64_t size)
+{
+    byte *out = (byte *)data;
+    uint64_t count, total;
+
+    size = std::min(size, spill->size - spill->readPos);
+    total = size;
+
+    if (size && spill->readPos < SPILL_MEMORY_SIZE) {
+        count = std::min(size, SPILL_MEMORY_SIZE - spill->readPos);
+        memcpy(out, spill->memory + spill->readPos, count);
+        spill->readPos += count;
+        out += count;
+        size -= count;
+    }
+    if (size) {
+        SafeRead(out, size, spill->fp);
+        spill->readPos += size;
+    }
+
+    return total;
+}
+
+static void Spill_Free(bmfcSpill_t *spill)
+{
+    if (spill->memory) {
+        FreeMemory(spill->memory);
+    }
+    if (spill->fp) {
+        fclose(spill->fp);
+    }
+    memset(spill, 0, sizeof(*spill));
+}
+
+/*
+bmfcMap_t: what the parser streams out of a map file, the records that a map can have any amount of are spilled
+*/
+typedef struct {
+    std::string name;
+    uint32_t width;
+    uint32_t height;
+    bool darkAmbience;
+    float ambientIntensity;
+    vec3_t ambientColor;
+
+    bmfcSpill_t tiles; // in the file's order, which is the map's row-major order
+    bmfcSpill_t checkpoints;
+    bmfcSpill_t spawns;
+    std::vector<maplight_t> lights; // there can't be more than MAX_MAP_LIGHTS anyway
+    bmfcSpill_t vertices; // made by PrepareDrawData
+    bmfcSpill_t indices;
+    bmfcSpill_t colliders; // made by PrepareCollision
+    std::vector<byte> navigation; // made by Nav_Build
+
+    bool started; // found the map's opening brace
+    bool finished; // and its closing one
+} bmfcMap_t;
+
+static bool Spill_AnyFailed(const bmfcMap_t *map)
+{
+    return map->tiles.failed || map->checkpoints.failed || map->spawns.failed || map->vertices.failed
+        || map->indices.failed || map->colliders.failed;
+}
+
+/*
+bmfcTileset_t: what's been worked out from a tileset texture at one tile layout, every map of a batch that uses it
+shares the one copy
+*/
+typedef struct {
+    boost::mutex lock;
+    bool loaded;
+    bool usable; // the texture could be loaded and fits the layout
+    std::string path; // empty if the texture couldn't be found
+    uint32_t sheetWidth;
+    uint32_t sheetHeight;
+    tileRemap_t remap;
+    std::vector<tile2d_sprite_t> sprites; // of every tile in the sheet
+    std::vector<byte> texture; // LUMP_TEXTURE, empty unless it's embedded
+} bmfcTileset_t;
+
+typedef enum {
+    JOB_PENDING,
+    JOB_COMPILED,
+    JOB_SKIPPED, // up to date
+    JOB_FAILED
+} jobStatus_t;
+
+/*
+bmfcJob_t: everything that goes into compiling one map, nothing in here is touched by the other jobs of a batch
+*/
+typedef struct {
+    std::string input;
+    std::string output;
+    std::string texture; // the tileset texture it was found at
+    std::unique_ptr<bmfcMap_t> map; // only while it's being compiled
+    tile2d_info_t tilesetInfo;
+    bmfcTileset_t *tileset;
+
+    uint64_t mapHash; // of the map text
+    uint64_t hash; // of everything the output depends on
+    uint64_t prevHash; // from the last batch build, 0 if there wasn't one
+    std::string prevTexture; // what the tileset texture was found at in the last batch build
+    jobStatus_t status;
+
+    // microseconds
+    uint64_t parseTime;
+    uint64_t tilesetTime;
+    uint64_t lightmapTime;
+    uint64_t collisionTime;
+    uint64_t navigationTime;
+    uint64_t writeTime;
+    uint64_t totalTime;
+} bmfcJob_t;
 
 typedef enum {
     CHUNK_CHECKPOINT,
@@ -23,12 +236,23 @@ typedef enum {
     CHUNK_INVALID
 } chunkType_t;
 
-static bool ParseChunk(const char **text, CMapData *tmpData)
+/*
+ParseChunk: a chunk's record is only spilled once its closing brace is found
+*/
+static bool ParseChunk(const char **text, bmfcMap_t *map, tile2d_info_t *tilesetInfo)
 {
     const char *tok;
     chunkType_t type;
+    maptile_t tile;
+    mapcheckpoint_t checkpoint;
+    mapspawn_t spawn;
+    maplight_t light;
 
     type = CHUNK_INVALID;
+    memset(&tile, 0, sizeof(tile));
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    memset(&spawn, 0, sizeof(spawn));
+    memset(&light, 0, sizeof(light));
 
     while (1) {
         tok = COM_ParseExt(text, qtrue);
@@ -50,19 +274,15 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 return false;
             }
             if (!N_stricmp(tok, "map_checkpoint")) {
-                tmpData->mCheckpoints.emplace_back();
                 type = CHUNK_CHECKPOINT;
             }
             else if (!N_stricmp(tok, "map_spawn")) {
-                tmpData->mSpawns.emplace_back();
                 type = CHUNK_SPAWN;
             }
             else if (!N_stricmp(tok, "map_light")) {
-                tmpData->mLights.emplace_back();
                 type = CHUNK_LIGHT;
             }
             else if (!N_stricmp(tok, "map_tile")) {
-                tmpData->mTiles.emplace_back();
                 type = CHUNK_TILE;
             }
             else if (!N_stricmp(tok, "map_tileset")) {
@@ -86,7 +306,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for spawn entity type");
                 return false;
             }
-            tmpData->mSpawns.back().entitytype = (uint32_t)atoi(tok);
+            spawn.entitytype = (uint32_t)atoi(tok);
         }
         //
         // tileCountX <count>
@@ -97,7 +317,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tileset tileCountX");
                 return false;
             }
-            tilesetInfo.tileCountX = (uint32_t)atoi(tok);
+            tilesetInfo->tileCountX = (uint32_t)atoi(tok);
         }
         //
         // tileCountY <count>
@@ -108,7 +328,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tileset tileCountY");
                 return false;
             }
-            tilesetInfo.tileCountY = (uint32_t)atoi(tok);
+            tilesetInfo->tileCountY = (uint32_t)atoi(tok);
         }
         //
         // numTiles <number>
@@ -119,7 +339,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tileset numTiles");
                 return false;
             }
-            tilesetInfo.numTiles = (uint32_t)atoi(tok);
+            tilesetInfo->numTiles = (uint32_t)atoi(tok);
         }
         //
         // tileWidth <width>
@@ -130,7 +350,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tileset tileWidth");
                 return false;
             }
-            tilesetInfo.tileWidth = (uint32_t)atoi(tok);
+            tilesetInfo->tileWidth = (uint32_t)atoi(tok);
         }
         //
         // texture <path>
@@ -142,9 +362,10 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 return false;
             }
             if (strlen(GetFilename(tok)) >= MAX_GDR_PATH) {
-                Error("Texture path '%s' too long", tok);
+                COM_ParseError("tileset texture path '%s' is too long", tok);
+                return false;
             }
-            N_strncpyz(tilesetInfo.texture, tok, MAX_GDR_PATH);
+            N_strncpyz(tilesetInfo->texture, tok, MAX_GDR_PATH);
         }
         //
         // tileHeight <height>
@@ -155,7 +376,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tileset tileHeight");
                 return false;
             }
-            tilesetInfo.tileHeight = (uint32_t)atoi(tok);
+            tilesetInfo->tileHeight = (uint32_t)atoi(tok);
         }
         //
         // texIndex <index>
@@ -166,7 +387,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for map tile texIndex");
                 return false;
             }
-            tmpData->mTiles.back().index = (int32_t)atoi(tok);
+            tile.index = (int32_t)atoi(tok);
         }
         //
         // id <entityid>
@@ -181,7 +402,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for spawn entity id");
                 return false;
             }
-            tmpData->mSpawns.back().entityid = (uint32_t)atoi(tok);
+            spawn.entityid = (uint32_t)atoi(tok);
         }
         //
         // flags <flags>
@@ -196,22 +417,22 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for tile flags");
                 return false;
             }
-            tmpData->mTiles.back().flags = (uint32_t)ParseHex(tok);
+            tile.flags = (uint32_t)ParseHex(tok);
         }
         //
         // sides <sides...>
         //
         else if (!N_stricmp(tok, "sides")) {
-            int sides[5];
-            if (!Parse1DMatrix(text, 5, (float *)sides)) {
+            float sides[5];
+            if (!Parse1DMatrix(text, 5, sides)) {
                 COM_ParseError("failed to parse sides for map tile");
                 return false;
             }
-            tmpData->mTiles.back().sides[0] = sides[0];
-            tmpData->mTiles.back().sides[1] = sides[1];
-            tmpData->mTiles.back().sides[2] = sides[2];
-            tmpData->mTiles.back().sides[3] = sides[3];
-            tmpData->mTiles.back().sides[4] = sides[4];
+            tile.sides[0] = sides[0];
+            tile.sides[1] = sides[1];
+            tile.sides[2] = sides[2];
+            tile.sides[3] = sides[3];
+            tile.sides[4] = sides[4];
         }
         //
         // texcoords <texcoords...>
@@ -222,7 +443,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("failed to parse texture coordinates for map tile");
                 return false;
             }
-            memcpy(tmpData->mTiles.back().texcoords, coords, sizeof(coords));
+            memcpy(tile.texcoords, coords, sizeof(coords));
         }
         //
         // pos <x y elevation>
@@ -233,9 +454,14 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("chunk type not specified before parameters");
                 return false;
             } else if (type == CHUNK_CHECKPOINT) {
-                xyz = tmpData->mCheckpoints.back().xyz;
+                xyz = checkpoint.xyz;
             } else if (type == CHUNK_SPAWN) {
-                xyz = tmpData->mSpawns.back().xyz;
+                xyz = spawn.xyz;
+            } else if (type == CHUNK_TILE) {
+                xyz = tile.pos;
+            } else {
+                COM_ParseError("found parameter \"pos\" in chunk that doesn't have a position");
+                return false;
             }
 
             tok = COM_ParseExt(text, qfalse);
@@ -243,14 +469,14 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for pos.x");
                 return false;
             }
-            xyz[0] = static_cast<uint32_t>(clamp(atoi(tok), 0, tmpData->mWidth));
+            xyz[0] = static_cast<uint32_t>(clamp(atoi(tok), 0, map->width));
 
             tok = COM_ParseExt(text, qfalse);
             if (!tok[0]) {
                 COM_ParseError("missing parameter for pos.y");
                 return false;
             }
-            xyz[1] = static_cast<uint32_t>(clamp(atoi(tok), 0, tmpData->mHeight));
+            xyz[1] = static_cast<uint32_t>(clamp(atoi(tok), 0, map->height));
             
             tok = COM_ParseExt(text, qfalse);
             if (!tok[0]) {
@@ -273,7 +499,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for brightness");
                 return false;
             }
-            tmpData->mLights.back().brightness = static_cast<float>(atof(tok));
+            light.brightness = static_cast<float>(atof(tok));
         }
         //
         // color <r g b a>
@@ -284,7 +510,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 return false;
             }
 
-            if (!Parse1DMatrix(text, 4, tmpData->mLights.back().color)) {
+            if (!Parse1DMatrix(text, 4, light.color)) {
                 COM_ParseError("failed to parse light color");
                 return false;
             }
@@ -298,7 +524,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("missing parameter for light range");
                 return false;
             }
-            tmpData->mLights.back().range = atof(tok);
+            light.range = atof(tok);
         }
         //
         // origin <x y elevation>
@@ -314,41 +540,63 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 COM_ParseError("failed to parse light origin");
                 return false;
             }
-            VectorCopy(tmpData->mLights.back().origin, origin);
+            VectorCopy(light.origin, origin);
         }
         else {
             COM_ParseWarning("unrecognized token '%s'", tok);
             continue;
         }
     }
+
+    switch (type) {
+    case CHUNK_CHECKPOINT:
+        Spill_Write(&map->checkpoints, &checkpoint, sizeof(checkpoint));
+        break;
+    case CHUNK_SPAWN:
+        Spill_Write(&map->spawns, &spawn, sizeof(spawn));
+        break;
+    case CHUNK_TILE:
+        Spill_Write(&map->tiles, &tile, sizeof(tile));
+        break;
+    case CHUNK_LIGHT:
+        map->lights.emplace_back(light);
+        break;
+    default:
+        break;
+    };
     return true;
 }
 
-static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
+/*
+ParseMapText: parses a piece of the map that ends where a chunk or the map itself does, returns once it runs out
+*/
+static bool ParseMapText(const char **text, bmfcMap_t *map, tile2d_info_t *tilesetInfo)
 {
     const char *tok;
 
-    COM_BeginParseSession(path);
-
-    tok = COM_ParseExt(text, qtrue);
-    if (tok[0] != '{') {
-        COM_ParseWarning("expected '{', got '%s'", tok);
-        return false;
+    if (!map->started) {
+        tok = COM_ParseExt(text, qtrue);
+        if (tok[0] != '{') {
+            COM_ParseWarning("expected '{', got '%s'", tok);
+            return false;
+        }
+        map->started = true;
     }
 
     while (1) {
         tok = COM_ParseComplex(text, qtrue);
+        // the rest is in the next piece
         if (!tok[0]) {
-            COM_ParseWarning("no concluding '}' in map file '%s'", path);
-            return false;
+            break;
         }
         // end of map file
         if (tok[0] == '}') {
+            map->finished = true;
             break;
         }
         // chunk definition
         else if (tok[0] == '{') {
-            if (!ParseChunk(text, tmpData)) {
+            if (!ParseChunk(text, map, tilesetInfo)) {
                 return false;
             }
             continue;
@@ -362,7 +610,7 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
                 COM_ParseError("missing parameter for map name");
                 return false;
             }
-            tmpData->mName = tok;
+            map->name = tok;
         }
         else if (!N_stricmp(tok, "width")) {
             tok = COM_ParseExt(text, qfalse);
@@ -370,7 +618,7 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
                 COM_ParseError("missing parameter for map width");
                 return false;
             }
-            tmpData->mWidth = (uint32_t)atoi(tok);
+            map->width = (uint32_t)atoi(tok);
         }
         else if (!N_stricmp(tok, "height")) {
             tok = COM_ParseExt(text, qfalse);
@@ -378,7 +626,7 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
                 COM_ParseError("missing parameter for map height");
                 return false;
             }
-            tmpData->mHeight = (uint32_t)atoi(tok);
+            map->height = (uint32_t)atoi(tok);
         }
         else if (!N_stricmp(tok, "ambientIntensity")) {
             tok = COM_ParseExt(text, qfalse);
@@ -386,10 +634,10 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
                 COM_ParseError("missing parameter for map ambient light");
                 return false;
             }
-            tmpData->mAmbientIntensity = atof(tok);
+            map->ambientIntensity = atof(tok);
         }
         else if (!N_stricmp(tok, "ambientColor")) {
-            if (!Parse1DMatrix(text, 3, &tmpData->mAmbientColor[0])) {
+            if (!Parse1DMatrix(text, 3, map->ambientColor)) {
                 COM_ParseError("failed to parse map ambient color");
                 return false;
             }
@@ -401,202 +649,1039 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
                 return false;
             }
             if (!N_stricmp(tok, "dark")) {
-                tmpData->mDarkAmbience = true;
+                map->darkAmbience = true;
             }
             else if (!N_stricmp(tok, "light")) {
-                tmpData->mDarkAmbience = false;
+                map->darkAmbience = false;
             }
             else {
                 COM_ParseError("invalid parameter for map ambientType '%s'", tok);
             }
         }
-        else if (!N_stricmp(tok, "numCheckpoints")) {
+        // only hints for the editor's containers, the spills grow as they go
+        else if (!N_stricmp(tok, "numCheckpoints") || !N_stricmp(tok, "numSpawns") || !N_stricmp(tok, "numLights")
+            || !N_stricmp(tok, "numTiles") || !N_stricmp(tok, "numEntities"))
+        {
             tok = COM_ParseExt(text, qfalse);
             if (!tok[0]) {
-                COM_ParseError("missing parameter for map numCheckpoints");
+                COM_ParseError("missing parameter for map count");
                 return false;
             }
-            tmpData->mCheckpoints.reserve((size_t)atoi(tok));
         }
-        else if (!N_stricmp(tok, "numSpawns")) {
-            tok = COM_ParseExt(text, qfalse);
-            if (!tok[0]) {
-                COM_ParseError("missing parameter for map numSpawns");
-                return false;
-            }
-            tmpData->mSpawns.reserve((size_t)atoi(tok));
+        else {
+            COM_ParseWarning("unrecognized token: '%s'", tok);
         }
-        else if (!N_stricmp(tok, "numLights")) {
-            tok = COM_ParseExt(text, qfalse);
-            if (!tok[0]) {
-                COM_ParseError("missing parameter for map numLights");
-                return false;
+    }
+    return true;
+}
+
+/*
+MapText_FindCut: where the last whole chunk in text ends, or the map itself, so that the parser is never handed half
+of one. Tokens are found the same way COM_ParseExt finds them and one that runs into the end of the text is only
+whole at the end of the file. depth is the brace depth at the start of text and becomes the one at the cut, returns 0
+if there isn't a cut yet.
+*/
+static uint64_t MapText_FindCut(const char *text, uint64_t length, bool eof, int *depth)
+{
+    const char *end;
+    uint64_t pos, cut;
+    char first;
+    int d;
+
+    d = *depth;
+    pos = cut = 0;
+    while (pos < length) {
+        if ((byte)text[pos] <= ' ') {
+            pos++;
+            continue;
+        }
+
+        // a '/' at the end might be the start of a comment
+        if (text[pos] == '/' && pos + 1 == length && !eof) {
+            break;
+        }
+        if (text[pos] == '/' && pos + 1 < length && text[pos + 1] == '/') {
+            end = (const char *)memchr(text + pos + 2, '\n', length - pos - 2);
+            if (!end && !eof) {
+                break;
             }
-            tmpData->mLights.reserve((size_t)atoi(tok));
+            pos = end ? end - text : length;
+            continue;
         }
-        else if (!N_stricmp(tok, "numTiles")) {
-            tok = COM_ParseExt(text, qfalse);
-            if (!tok[0]) {
-                COM_ParseError("missing parameter for map numTiles");
-                return false;
+        if (text[pos] == '/' && pos + 1 < length && text[pos + 1] == '*') {
+            end = (const char *)memmem(text + pos + 2, length - pos - 2, "*/", 2);
+            if (!end && !eof) {
+                break;
             }
-            tmpData->mTiles.reserve((size_t)atoi(tok));
+            pos = end ? end - text + 2 : length;
+            continue;
         }
-        else if (!N_stricmp(tok, "numEntities")) {
-            tok = COM_ParseExt(text, qfalse);
-            if (!tok[0]) {
-                COM_ParseError("missing parameter for map numEntities");
-                return false;
+
+        if (text[pos] == '"') {
+            end = (const char *)memchr(text + pos + 1, '"', length - pos - 1);
+            if (!end && !eof) {
+                break;
             }
-            tmpData->mEntities.reserve((size_t)atoi(tok));
+            first = pos + 1 < length ? text[pos + 1] : '\0';
+            pos = end ? end - text + 1 : length;
         }
         else {
-            COM_ParseWarning("unrecognized token: '%s'", tok);
+            first = text[pos];
+            while (pos < length && (byte)text[pos] > ' ') {
+                pos++;
+            }
+            if (pos == length && !eof) {
+                break;
+            }
+        }
+
+        if (first == '{') {
+            d++;
+        }
+        else if (first == '}') {
+            d--;
+            if (d <= 1) {
+                cut = pos;
+                *depth = d;
+            }
+            // nothing after the map is parsed
+            if (d <= 0) {
+                break;
+            }
         }
     }
-    return true;
+
+    return cut;
 }
 
-bool Map_LoadFile(IDataStream *file, const char *ext, const char *rpath)
+/*
+LoadMapFile: streams the job's map file through the parser a window at a time, the records go straight into the
+map's spills so only the window has to fit in memory, it's only made bigger for a chunk that doesn't fit.
+*/
+static bool LoadMapFile(bmfcJob_t *job)
 {
-    uint64_t fileLen;
-    char *buf, *ptr;
-    const char **text;
-    CMapData tmpData;
+    const mapspawn_t player = { .xyz{ 0, 0, 0 }, .entitytype = ET_PLAYR, .entityid = 0 };
+    uint64_t windowSize, length, cut, count;
+    const char *text;
+    bmfcMap_t *map;
+    char *window;
+    bool eof, ok;
+    int depth;
+    FILE *fp;
+    char c;
+
+    Printf("Loading map file '%s'", job->input.c_str());
+    fp = fopen(job->input.c_str(), "rb");
+    if (!fp) {
+        Printf("Failed to load map file '%s', not compiling", job->input.c_str());
+        return false;
+    }
+
+    // the same defaults as CMapData::Clear, which always has a spawn for the player
+    job->map = std::make_unique<bmfcMap_t>();
+    map = job->map.get();
+    map->width = 16;
+    map->height = 16;
+    map->darkAmbience = true;
+    map->ambientIntensity = 0.0f;
+    map->ambientColor[0] = map->ambientColor[1] = map->ambientColor[2] = 1.0f;
+    map->started = map->finished = false;
+    Spill_Write(&map->spawns, &player, sizeof(player));
+    memset(&job->tilesetInfo, 0, sizeof(job->tilesetInfo));
+
+    windowSize = MAP_WINDOW_SIZE;
+    window = (char *)GetMemory(windowSize + 1);
+    length = 0;
+    depth = 0;
+    eof = false;
+    ok = true;
+
+    COM_BeginParseSession(job->input.c_str());
+    while (ok && !map->finished) {
+        if (!eof) {
+            if (length == windowSize) {
+                windowSize *= 2;
+                window = (char *)GetResizedMemory(window, windowSize + 1);
+            }
+            count = fread(window + length, 1, windowSize - length, fp);
+            eof = length + count < windowSize;
+            length += count;
+        }
 
-    fileLen = file->GetLength();
+        cut = MapText_FindCut(window, length, eof, &depth);
+        if (!cut) {
+            if (!eof) {
+                continue;
+            }
+            // whatever is wrong with the rest is reported by the parser
+            cut = length;
+        }
 
-    tmpData.Clear();
-    buf = (char *)GetMemory(fileLen);
-    file->Read(buf, fileLen);
-    file->Close();
+        c = window[cut];
+        window[cut] = '\0';
+        text = window;
+        ok = ParseMapText(&text, map, &job->tilesetInfo);
+        window[cut] = c;
+
+        memmove(window, window + cut, length - cut);
+        length -= cut;
+
+        if (ok && !map->finished && eof && !length) {
+            COM_ParseWarning("no concluding '}' in map file '%s'", job->input.c_str());
+            ok = false;
+        }
+    }
 
-    ptr = buf;
-    text = (const char **)&ptr;
+    fclose(fp);
+    FreeMemory(window);
 
-    if (!ParseMap(text, rpath, &tmpData)) {
-        Printf("Error: failed to load map");
+    if (ok && Spill_AnyFailed(map)) {
+        ok = false;
+    }
+    // everything from the tileset on divides by the tile size
+    if (ok && job->tilesetInfo.tileCountX && job->tilesetInfo.tileCountY
+        && (!job->tilesetInfo.tileWidth || !job->tilesetInfo.tileHeight)) {
+        Printf("map file '%s' has a %ux%u tileset with a tile size of %ux%u", job->input.c_str(),
+            job->tilesetInfo.tileCountX, job->tilesetInfo.tileCountY, job->tilesetInfo.tileWidth, job->tilesetInfo.tileHeight);
+        ok = false;
+    }
+    if (!ok) {
+        Printf("Failed to load map file '%s', not compiling", job->input.c_str());
         return false;
     }
+    return true;
+}
+
+/*
+bmfcLump_t: a lump on its way into the file, either in memory or in one of the map's spills, stored is the
+compressed copy if compressing it was worth it
+*/
+typedef struct {
+    const void *data;
+    bmfcSpill_t *spill;
+    const tileRemap_t *remap; // tiles still point at the sheet and are remapped on the way out
+    uint32_t mapWidth; // and get their position from their place in the map
+    uint64_t size;
+    uint64_t readPos;
+    bmfcSpill_t stored;
+    bool compressed;
+    uint64_t compressTime; // microseconds
+} bmfcLump_t;
+
+static void Lump_Rewind(bmfcLump_t *lump)
+{
+    lump->readPos = 0;
+    if (lump->spill) {
+        Spill_Rewind(lump->spill);
+    }
+}
+
+/*
+Lump_Read: the next piece of the lump as it goes into the file, at most size bytes and whole records for the tiles,
+returns 0 once it's all been read
+*/
+static uint64_t Lump_Read(bmfcLump_t *lump, void *data, uint64_t size)
+{
+    maptile_t *tiles;
+    uint64_t count, first;
+
+    if (lump->data) {
+        count = std::min(size, lump->size - lump->readPos);
+        memcpy(data, (const byte *)lump->data + lump->readPos, count);
+        lump->readPos += count;
+        return count;
+    }
+    if (!lump->spill) {
+        return 0;
+    }
+    if (!lump->remap) {
+        return Spill_Read(lump->spill, data, size);
+    }
+
+    first = lump->spill->readPos / sizeof(maptile_t);
+    count = Spill_Read(lump->spill, data, size - size % sizeof(maptile_t));
+    tiles = (maptile_t *)data;
+    for (uint64_t i = 0; i < count / sizeof(maptile_t); i++) {
+        tiles[i].pos[0] = (first + i) % lump->mapWidth;
+        tiles[i].pos[1] = (first + i) / lump->mapWidth;
+        if (tiles[i].index < 0) {
+            continue;
+        }
+        tiles[i].index = (uint32_t)tiles[i].index < lump->remap->remap.size() ? lump->remap->remap[tiles[i].index] : -1;
+    }
+    return count;
+}
+
+static void AddLump(bmfcLump_t *data, mapheader_t *header, int lumpnum, FILE *fp)
+{
+    static const byte padding[LUMP_ALIGN] = { 0 };
+    lump_t *lump;
+    byte *buf;
+    uint64_t count;
+
+    lump = &header->lumps[lumpnum];
+    lump->fileofs = LittleLong(ftello64(fp));
+    lump->uncompressedLength = data->size;
+    lump->compression = data->compressed ? lumpCompression : COMPRESS_NONE;
+    lump->length = data->compressed ? data->stored.size : data->size;
+
+    // empty lumps (no checkpoints, no lights, etc.) only get an offset
+    if (!lump->length) {
+        return;
+    }
+
+    buf = (byte *)GetMemory(LUMP_STREAM_SIZE);
+    if (data->compressed) {
+        Spill_Rewind(&data->stored);
+        while ((count = Spill_Read(&data->stored, buf, LUMP_STREAM_SIZE))) {
+            SafeWrite(buf, count, fp);
+        }
+    }
     else {
-        *mapData = tmpData;
-        mapData->mPath = rpath;
+        Lump_Rewind(data);
+        while ((count = Lump_Read(data, buf, LUMP_STREAM_SIZE))) {
+            SafeWrite(buf, count, fp);
+        }
+    }
+    FreeMemory(buf);
+
+    if (PAD(lump->length, LUMP_ALIGN) != lump->length) {
+        SafeWrite(padding, PAD(lump->length, LUMP_ALIGN) - lump->length, fp);
+    }
+}
+
+/*
+CompressLumps: every lump that's big enough is compressed on its own and alongside the others, a piece at a time into
+a spill of its own. One that doesn't come out any smaller is stored as it is.
+*/
+static void CompressLumps(bmfcLump_t *lumps)
+{
+    Job_ParallelFor(NUMLUMPS, 1, [lumps](uint32_t start, uint32_t end) {
+        for (uint32_t i = start; i < end; i++) {
+            bmfcLump_t *lump = &lumps[i];
+            compressStream_t *stream;
+            uint64_t time, count;
+            byte *buf;
+
+            if (lumpCompression == COMPRESS_NONE || lump->size < COMPRESSED_LUMP_SIZE) {
+                continue;
+            }
+
+            time = Sys_Microseconds();
+            buf = (byte *)GetMemory(LUMP_STREAM_SIZE);
+            stream = Compress_BeginStream(lumpCompression, [lump](const void *data, uint64_t length) {
+                Spill_Write(&lump->stored, data, length);
+            });
+            Lump_Rewind(lump);
+            while ((count = Lump_Read(lump, buf, LUMP_STREAM_SIZE))) {
+                Compress_StreamData(stream, buf, count);
+            }
+            Compress_EndStream(stream);
+            FreeMemory(buf);
+            lump->compressTime = Sys_Microseconds() - time;
+
+            // a spill that failed only costs the compression
+            lump->compressed = !lump->stored.failed && lump->stored.size < lump->size;
+            if (!lump->compressed) {
+                Spill_Free(&lump->stored);
+            }
+        }
+    });
+}
+
+/*
+ReportLumps: reads the file that was just written back through the loader and prints what every lump was stored as,
+how long it took to compress and how long it takes to load. Compressed lumps are only held one at a time. Returns
+false if the file doesn't read back as what was written.
+*/
+static bool ReportLumps(const char *filename, bmfcLump_t *lumps)
+{
+    static const char *codecs[] = { "none", "zlib", "bzip2" };
+    uint64_t time, size, totalSize, totalStored, pos, count;
+    std::string report;
+    char line[256];
+    bmfFile_t file;
+    const byte *data;
+    byte *buf;
+    bool ok;
+
+    if (!BMF_Open(filename, &file)) {
+        Printf("ReportLumps: failed to read back '%s'", filename);
+        return false;
+    }
+
+    snprintf(line, sizeof(line), "Lumps of '%s':\n  %-12s %12s %12s %7s %6s %11s %11s", filename, "lump", "bytes",
+        "stored", "ratio", "codec", "compress ms", "load ms");
+    report = line;
+
+    buf = (byte *)GetMemory(LUMP_STREAM_SIZE);
+    totalSize = totalStored = 0;
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const lump_t *lump = &file.header.map.lumps[i];
+
+        time = Sys_Microseconds();
+        data = (const byte *)BMF_GetLump(&file, i, &size);
+        time = Sys_Microseconds() - time;
+
+        ok = size == lumps[i].size;
+        Lump_Rewind(&lumps[i]);
+        for (pos = 0; ok && (count = Lump_Read(&lumps[i], buf, LUMP_STREAM_SIZE)); pos += count) {
+            ok = !memcmp(data + pos, buf, count);
+        }
+        if (!ok) {
+            Printf("ReportLumps: %s lump of '%s' didn't load back the same", BMF_LumpName(i), filename);
+            FreeMemory(buf);
+            BMF_Close(&file);
+            return false;
+        }
+        if (file.copies[i]) {
+            FreeMemory(file.copies[i]);
+            file.copies[i] = NULL;
+        }
+
+        snprintf(line, sizeof(line), "\n  %-12s %12lu %12lu %6.1f%% %6s %11.3f %11.3f", BMF_LumpName(i), lump->uncompressedLength,
+            lump->length, lump->uncompressedLength ? 100.0 * lump->length / lump->uncompressedLength : 100.0,
+            codecs[lump->compression], lumps[i].compressTime / 1000.0, time / 1000.0);
+        report += line;
+        totalSize += lump->uncompressedLength;
+        totalStored += lump->length;
     }
+    snprintf(line, sizeof(line), "\n  %-12s %12lu %12lu %6.1f%%", "total", totalSize, totalStored,
+        totalSize ? 100.0 * totalStored / totalSize : 100.0);
+    report += line;
+
     FreeMemory(buf);
+    BMF_Close(&file);
+
+    // in one go so that batch jobs don't interleave their lines
+    Printf("%s", report.c_str());
 
     return true;
 }
 
-void Map_Load(const char *filename)
+/*
+ResolveTexture: the editor saves the path it opened the texture with, which might be relative to the map instead,
+returns an empty string if it's in neither place
+*/
+static std::string ResolveTexture(const char *texture, const char *mapPath)
 {
-    FileStream file;
-    Printf("Loading map file '%s'", filename);
+    std::filesystem::path path;
+    std::error_code err;
 
-    if (file.Open(filename, "r")) {
-        Map_LoadFile(&file, GetExtension(filename), filename);
+    if (!texture[0]) {
+        return "";
     }
-    else {
-        Printf("Failed to load map file '%s'", filename);
+    path = texture;
+    if (std::filesystem::is_regular_file(path, err)) {
+        return path.string();
     }
+    path = std::filesystem::path(mapPath).parent_path() / texture;
+    if (std::filesystem::is_regular_file(path, err)) {
+        return path.string();
+    }
+    return "";
 }
 
-static uint64_t CopyLump(void **dest, uint64_t size, mapheader_t *header, int lumpnum)
+/*
+HashFile: the hash of a file's contents, 0 if it can't be read
+*/
+static uint64_t HashFile(const char *path)
 {
-    uint64_t length, ofs;
+    const void *data;
+    uint64_t length, hash;
 
-    length = header->lumps[lumpnum].length;
-    ofs = header->lumps[lumpnum].fileofs;
+    hash = 0;
+    data = Sys_MapFile(path, &length);
+    if (data) {
+        hash = HashData(data, length);
+        Sys_UnmapFile(data, length);
+    }
+    return hash;
+}
 
-    if (length % size)
-        Error("CopyLump: funny lump size");
-    
-    *dest = GetMemory(length);
-    memcpy(*dest, (byte *)header + ofs, length);
-    
-    return length / size;
+/*
+HashTexture: the hash of a texture file's contents, every file is only read once per run
+*/
+static uint64_t HashTexture(const std::string& path)
+{
+    static boost::mutex lock;
+    static std::unordered_map<std::string, uint64_t> hashes;
+
+    if (path.empty()) {
+        return 0;
+    }
+
+    boost::lock_guard<boost::mutex> guard{ lock };
+    auto it = hashes.find(path);
+    if (it == hashes.end()) {
+        it = hashes.emplace(path, HashFile(path.c_str())).first;
+    }
+    return it->second;
 }
 
-static void AddLump(const void *data, uint64_t size, mapheader_t *header, int lumpnum, FILE *fp)
+/*
+JobHash: what a map's output depends on, the map text, the tileset texture, the options and the compiler itself
+*/
+static uint64_t JobHash(uint64_t mapHash, uint64_t textureHash)
 {
-    lump_t *lump;
+    const uint64_t parts[] = { mapHash, textureHash, BMFC_VERSION, LEVEL_VERSION, MAP_VERSION, noDedup, (uint64_t)lumpCompression,
+        optimizeOutput, sectorSize, embedTexture };
 
-    lump = &header->lumps[lumpnum];
-    lump->length = size;
-    lump->fileofs = LittleLong(ftello64(fp));
+    return HashData(parts, sizeof(parts));
+}
+
+/*
+FindTileset: the shared state of a tileset texture at a tile layout, created empty the first time it's asked for
+*/
+static bmfcTileset_t *FindTileset(const std::string& path, const tile2d_info_t *info)
+{
+    static boost::mutex lock;
+    static std::unordered_map<std::string, std::unique_ptr<bmfcTileset_t>> tilesets;
+    char key[MAX_GDR_PATH + 64];
+
+    snprintf(key, sizeof(key), "%s|%ux%u|%ux%u", path.c_str(), info->tileWidth, info->tileHeight, info->tileCountX,
+        info->tileCountY);
 
-    SafeWrite(data, PAD(size, sizeof(uint32_t)), fp);
+    boost::lock_guard<boost::mutex> guard{ lock };
+    auto& tileset = tilesets[key];
+    if (!tileset) {
+        tileset = std::make_unique<bmfcTileset_t>();
+        tileset->loaded = false;
+        tileset->path = path;
+    }
+    return tileset.get();
 }
 
-static INLINE void GenCoords(const glm::vec2& sheetDims, const glm::vec2& spriteDims, const glm::vec2& coords, float texcoords[4][2])
+/*
+BuildTexture: LUMP_TEXTURE out of the tileset texture's pixels, see maptexheader_t
+*/
+static void BuildTexture(bmfcTileset_t *tileset, const tile2d_info_t *info, const byte *pixels, uint32_t width,
+    uint32_t height, uint32_t channels)
 {
-    const glm::vec2 min = { ((coords.x + 1) * spriteDims.x) / sheetDims.x, ((coords.y + 1) * spriteDims.y) / sheetDims.y };
-    const glm::vec2 max = { (coords.x * spriteDims.x) / sheetDims.x, (coords.y * spriteDims.y) / sheetDims.y };
+    std::vector<imageLevel_t> levels;
+    maptexheader_t header;
+    std::error_code err;
+    uint64_t size;
 
-    texcoords[0][0] = min.x;
-    texcoords[0][1] = max.y;
+    Image_MipSheet(pixels, width, height, channels, info->tileWidth, info->tileHeight, levels);
 
-    texcoords[1][0] = min.x;
-    texcoords[1][1] = min.y;
+    size = 0;
+    for (const auto& it : levels) {
+        size += it.pixels.size();
+    }
 
-    texcoords[2][0] = max.x;
-    texcoords[2][1] = min.y;
-        
-    texcoords[3][0] = max.x;
-    texcoords[3][1] = max.y;
+    memset(&header, 0, sizeof(header));
+    header.info.ident = TEX2D_IDENT;
+    header.info.version = TEX2D_VERSION;
+    N_strncpyz(header.info.name, info->texture, sizeof(header.info.name));
+    header.info.minfilter = GL_NEAREST_MIPMAP_NEAREST;
+    header.info.magfilter = GL_NEAREST;
+    header.info.wrapS = GL_CLAMP_TO_EDGE;
+    header.info.wrapT = GL_CLAMP_TO_EDGE;
+    header.info.width = width;
+    header.info.height = height;
+    header.info.channels = 4;
+    header.info.format = GL_RGBA8;
+    header.info.compression = COMPRESS_NONE;
+    header.info.compressedSize = size;
+    header.info.fileSize = std::filesystem::file_size(tileset->path, err);
+    header.numLevels = levels.size();
+
+    tileset->texture.resize(sizeof(header) + size);
+    memcpy(tileset->texture.data(), &header, sizeof(header));
+    size = sizeof(header);
+    for (const auto& it : levels) {
+        memcpy(tileset->texture.data() + size, it.pixels.data(), it.pixels.size());
+        size += it.pixels.size();
+    }
+
+    Printf("BuildTexture: embedded '%s' as %ux%u RGBA8 with %u levels, %lu bytes", info->texture, width, height,
+        header.numLevels, tileset->texture.size());
 }
 
-tile2d_sprite_t *GenerateSprites(void)
+/*
+LoadTileset: looks at the tileset texture for its size and finds the tiles that are a copy of an earlier one or have
+nothing in them, if the texture can't be looked at every tile is kept. Maps sharing a tileset only do this once.
+*/
+static void LoadTileset(bmfcJob_t *job)
 {
-    tile2d_sprite_t *sprites;
-    uint32_t i;
-    const glm::vec2 sheetDims = { tilesetInfo.tileCountX * tilesetInfo.tileWidth, tilesetInfo.tileCountY * tilesetInfo.tileHeight };
+    const tile2d_info_t *info = &job->tilesetInfo;
+    const uint32_t numTiles = info->tileCountX * info->tileCountY;
+    bmfcTileset_t *tileset;
+    std::vector<uint32_t> indices;
+    uint32_t width, height, channels;
+    const char *error;
+    tile2dFile_t file;
+    byte *pixels;
+
+    tileset = job->tileset = FindTileset(job->texture, info);
+
+    boost::lock_guard<boost::mutex> guard{ tileset->lock };
+    if (tileset->loaded) {
+        return;
+    }
+    tileset->loaded = true;
+
+    Image_IdentityRemap(numTiles, &tileset->remap);
+    tileset->usable = false;
+    tileset->sheetWidth = info->tileCountX * info->tileWidth;
+    tileset->sheetHeight = info->tileCountY * info->tileHeight;
+
+    pixels = NULL;
+    if (!tileset->path.empty() && numTiles) {
+        pixels = Image_LoadFile(tileset->path.c_str(), &width, &height, &channels, &error);
+        if (!pixels) {
+            Printf("LoadTileset: failed to load tileset texture '%s' (%s), keeping every tile", info->texture, error);
+        }
+        else if (width / info->tileWidth != info->tileCountX || height / info->tileHeight != info->tileCountY) {
+            Printf("LoadTileset: tileset texture '%s' is %ux%u, which doesn't fit %ux%u tiles of %ux%u, keeping every tile",
+                info->texture, width, height, info->tileCountX, info->tileCountY, info->tileWidth, info->tileHeight);
+            FreeMemory(pixels);
+            pixels = NULL;
+        }
+    }
+    else if (info->texture[0] && numTiles) {
+        Printf("LoadTileset: failed to find tileset texture '%s', keeping every tile", info->texture);
+    }
+
+    if (pixels) {
+        tileset->usable = true;
+        tileset->sheetWidth = width;
+        tileset->sheetHeight = height;
+
+        if (!noDedup) {
+            Image_DedupTiles(pixels, width, height, channels, info->tileWidth, info->tileHeight, &tileset->remap);
+            Printf("LoadTileset: %u tiles, %u duplicates, %u empty, %lu sprites kept", numTiles, tileset->remap.numDuplicates,
+                tileset->remap.numEmpty, tileset->remap.unique.size());
+        }
+        if (embedTexture) {
+            BuildTexture(tileset, info, pixels, width, height, channels);
+        }
+        FreeMemory(pixels);
+    }
+    else if (embedTexture && info->texture[0]) {
+        Printf("LoadTileset: tileset texture '%s' can't be embedded, it's only referenced", info->texture);
+    }
+
+    // the whole sheet's sprites are shared with the editor through the .tile2d next to the texture
+    tileset->sprites.resize(numTiles);
+    if (tileset->usable && Tile2D_LoadCached(tileset->path.c_str(), tileset->sheetWidth, tileset->sheetHeight,
+        info->tileWidth, info->tileHeight, &file))
+    {
+        memcpy(tileset->sprites.data(), file.header.sprites, sizeof(tile2d_sprite_t) * numTiles);
+        Tile2D_Unmap(&file);
+    }
+    else {
+        indices.resize(numTiles);
+        for (uint32_t i = 0; i < numTiles; i++) {
+            indices[i] = i;
+        }
+        Tile2D_GenerateSprites(tileset->sheetWidth, tileset->sheetHeight, info->tileWidth, info->tileHeight, indices.data(),
+            numTiles, tileset->sprites.data());
+    }
+}
+
+/*
+ScanTiles: reads the spilled tiles back for the sides the lightmap needs and the sprite each one draws, and warns about
+the ones with a texture index outside of the tileset, those are unbound when the tiles are remapped on their way into
+the file. sides and layers hold a cell for every tile of the map.
+*/
+static void ScanTiles(bmfcJob_t *job, byte *sides, int32_t *layers)
+{
+    const tileRemap_t *remap = &job->tileset->remap;
+    const uint64_t numCells = (uint64_t)job->map->width * job->map->height;
+    bmfcSpill_t *spill = &job->map->tiles;
+    maptile_t *tiles;
+    uint64_t count, index;
+    uint32_t numInvalid;
 
-    sprites = (tile2d_sprite_t *)GetClearedMemory(sizeof(*sprites) * tilesetInfo.numTiles);
+    // tiles past the end of the map are still written, tiles missing from it have no sides and draw nothing
+    memset(sides, 0, numCells * NUMSIDES);
+    for (uint64_t i = 0; i < numCells; i++) {
+        layers[i] = TILE_EMPTY;
+    }
+    tiles = (maptile_t *)GetMemory(LUMP_STREAM_SIZE);
 
-    for (uint32_t y = 0; y < sheetDims.y; y++) {
-        for (uint32_t x = 0; x < sheetDims.x; x++) {
-            vec2_t uv[4];
-            GenCoords(sheetDims, { tilesetInfo.tileWidth, tilesetInfo.tileHeight }, { x, y }, uv);
+    numInvalid = 0;
+    index = 0;
+    Spill_Rewind(spill);
+    while ((count = Spill_Read(spill, tiles, LUMP_STREAM_SIZE - LUMP_STREAM_SIZE % sizeof(maptile_t)) / sizeof(maptile_t))) {
+        for (uint64_t i = 0; i < count; i++, index++) {
+            const int32_t sprite = tiles[i].index;
 
-            sprites[i].index = y * tilesetInfo.tileCountX + x;
-            memcpy(sprites[i].uv, uv, sizeof(sprites[i].uv));
+            if (sprite >= 0 && (uint32_t)sprite >= remap->remap.size()) {
+                numInvalid++;
+            }
+            if (index >= numCells) {
+                continue;
+            }
+            memcpy(sides + index * NUMSIDES, tiles[i].sides, NUMSIDES);
+            if (sprite >= 0 && (uint32_t)sprite < remap->remap.size()) {
+                layers[index] = remap->remap[sprite];
+            }
         }
     }
+    FreeMemory(tiles);
+
+    if (numInvalid) {
+        Printf("WARNING: %u map tiles in '%s' had a texture index outside of the tileset, unbound them", numInvalid,
+            job->input.c_str());
+    }
+}
+
+/*
+GenerateSprites: one sprite for every tile that's kept, in the order of the remap's unique list so that a remapped
+map tile index points straight at its sprite, index is still the tile's position in the sheet
+*/
+static tile2d_sprite_t *GenerateSprites(const bmfcJob_t *job)
+{
+    const tileRemap_t *remap = &job->tileset->remap;
+    tile2d_sprite_t *sprites;
+
+    sprites = (tile2d_sprite_t *)GetClearedMemory(sizeof(*sprites) * std::max<size_t>(remap->unique.size(), 1));
+    for (uint32_t i = 0; i < remap->unique.size(); i++) {
+        sprites[i] = job->tileset->sprites[remap->unique[i]];
+    }
 
     return sprites;
 }
 
-// engine-specific draw data
-typedef struct {
-    vec3_t xyz;
-    vec3_t color;
-    vec3_t normal;
-    vec2_t uv;
-} drawVert_t;
+/*
+PrepareDrawData: meshes the map into the vertex and index lumps. Every rectangle of tiles that draw the same sprite
+under the same baked light becomes one quad, grown along the row first and then down for as long as each tile of the
+next row matches. Tiles with nothing to draw don't get a quad, and with --sectors a quad doesn't cross into another
+sector.
+*/
+static void PrepareDrawData(bmfcJob_t *job, const int32_t *layers, const maplightsample_t *samples)
+{
+    bmfcMap_t *map = job->map.get();
+    const uint32_t width = map->width;
+    const uint32_t height = map->height;
+    std::vector<bool> done;
+    mapdrawvert_t verts[4];
+    uint32_t indices[6];
+    uint32_t w, h, numVerts;
+    uint64_t numQuads, numTiles;
+    float light[3];
+
+    done.resize((uint64_t)width * height);
+
+    const auto matches = [&](uint64_t a, uint64_t b) {
+        return !done[b] && layers[b] == layers[a] && !memcmp(samples[b].rgba, samples[a].rgba, sizeof(samples[a].rgba));
+    };
+
+    numVerts = 0;
+    numQuads = numTiles = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint64_t start = (uint64_t)y * width + x;
+
+            if (done[start] || layers[start] == TILE_EMPTY) {
+                continue;
+            }
+            const uint32_t endX = sectorSize ? std::min(x - x % sectorSize + sectorSize, width) : width;
+            const uint32_t endY = sectorSize ? std::min(y - y % sectorSize + sectorSize, height) : height;
+
+            for (w = 1; x + w < endX && matches(start, start + w); w++)
+                ;
+            for (h = 1; y + h < endY; h++) {
+                uint32_t i;
+                for (i = 0; i < w && matches(start, start + (uint64_t)h * width + i); i++)
+                    ;
+                if (i < w) {
+                    break;
+                }
+            }
+            for (uint32_t j = 0; j < h; j++) {
+                for (uint32_t i = 0; i < w; i++) {
+                    done[start + (uint64_t)j * width + i] = true;
+                }
+            }
+
+            // the same corner order as the editor's quads
+            const float corners[4][2] = {
+                { (float)(x + w), (float)y },
+                { (float)(x + w), (float)(y + h) },
+                { (float)x, (float)(y + h) },
+                { (float)x, (float)y },
+            };
+            light[0] = samples[start].rgba[0] / 255.0f;
+            light[1] = samples[start].rgba[1] / 255.0f;
+            light[2] = samples[start].rgba[2] / 255.0f;
+            for (uint32_t i = 0; i < 4; i++) {
+                verts[i].xyz[0] = corners[i][0];
+                verts[i].xyz[1] = corners[i][1];
+                verts[i].xyz[2] = 0.0f;
+                VectorCopy(verts[i].color, light);
+                verts[i].normal[0] = 0.0f;
+                verts[i].normal[1] = 0.0f;
+                verts[i].normal[2] = 1.0f;
+                verts[i].uv[0] = corners[i][0] - x;
+                verts[i].uv[1] = corners[i][1] - y;
+                verts[i].layer = (float)layers[start];
+            }
+            indices[0] = numVerts + 0;
+            indices[1] = numVerts + 1;
+            indices[2] = numVerts + 2;
+            indices[3] = numVerts + 3;
+            indices[4] = numVerts + 2;
+            indices[5] = numVerts + 0;
+
+            Spill_Write(&map->vertices, verts, sizeof(verts));
+            Spill_Write(&map->indices, indices, sizeof(indices));
+            numVerts += 4;
+            numQuads++;
+            numTiles += (uint64_t)w * h;
+        }
+    }
+
+    Printf("PrepareDrawData: %lu tiles drawn with %lu quads, %u vertices", numTiles, numQuads, numVerts);
+}
+
+static bool Collision_Solid(const lightSides_t *grid, uint32_t x, uint32_t y)
+{
+    return grid->sides[((uint64_t)y * grid->width + x) * grid->stride + SIDE_INSIDE] != 0;
+}
+
+/*
+Collision_Edge: true if the tile's side is a wall that needs an edge, a side of a solid tile or one against a solid
+tile is already covered by a box
+*/
+static bool Collision_Edge(const lightSides_t *grid, uint32_t x, uint32_t y, uint32_t side)
+{
+    int64_t nx = x, ny = y;
+
+    if (Collision_Solid(grid, x, y) || !grid->sides[((uint64_t)y * grid->width + x) * grid->stride + side]) {
+        return false;
+    }
+
+    switch (side) {
+    case SIDE_NORTH: ny--; break;
+    case SIDE_EAST: nx++; break;
+    case SIDE_SOUTH: ny++; break;
+    case SIDE_WEST: nx--; break;
+    default: break;
+    };
+    if (nx < 0 || ny < 0 || nx >= grid->width || ny >= grid->height) {
+        return true;
+    }
+    return !Collision_Solid(grid, nx, ny);
+}
 
-void PrepareDrawData(void)
+static void Collision_Add(std::vector<mapcollider_t>& out, uint32_t type, uint32_t side, uint32_t x0, uint32_t y0,
+    uint32_t x1, uint32_t y1)
 {
-    drawVert_t *vertices;
-    uint32_t *indices;
+    mapcollider_t& c = out.emplace_back();
 
-    vertices = (drawVert_t *)GetMemory(sizeof(drawVert_t) * MAX_MAP_VERTICES);
-    indices = (uint32_t *)GetMemory(sizeof(uint32_t) * MAX_MAP_INDICES);
+    c.type = type;
+    c.side = side;
+    c.mins[0] = x0;
+    c.mins[1] = y0;
+    c.maxs[0] = x1;
+    c.maxs[1] = y1;
+}
+
+/*
+Collision_MergeStrip: the colliders of rows y0 to y1 on their own. Solid tiles are grown into boxes the same way
+PrepareDrawData grows quads, north and south sides are merged along their row and east and west sides down their
+column, nothing reaches past y1 yet.
+*/
+static void Collision_MergeStrip(const lightSides_t *grid, uint32_t y0, uint32_t y1, std::vector<mapcollider_t>& out)
+{
+    const uint32_t width = grid->width;
+    std::vector<bool> done;
+    uint32_t w, h, start;
+
+    done.resize((uint64_t)width * (y1 - y0));
+
+    const auto matches = [&](uint32_t x, uint32_t y) {
+        return !done[(uint64_t)(y - y0) * width + x] && Collision_Solid(grid, x, y);
+    };
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            if (!matches(x, y)) {
+                continue;
+            }
+
+            for (w = 1; x + w < width && matches(x + w, y); w++)
+                ;
+            for (h = 1; y + h < y1; h++) {
+                uint32_t i;
+                for (i = 0; i < w && matches(x + i, y + h); i++)
+                    ;
+                if (i < w) {
+                    break;
+                }
+            }
+            for (uint32_t j = 0; j < h; j++) {
+                for (uint32_t i = 0; i < w; i++) {
+                    done[(uint64_t)(y + j - y0) * width + x + i] = true;
+                }
+            }
+            Collision_Add(out, COLLIDER_BOX, SIDE_INSIDE, x, y, x + w, y + h);
+        }
+    }
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t side : { SIDE_NORTH, SIDE_SOUTH }) {
+            const uint32_t line = side == SIDE_NORTH ? y : y + 1;
+
+            for (uint32_t x = 0; x < width; x++) {
+                if (!Collision_Edge(grid, x, y, side)) {
+                    continue;
+                }
+                for (start = x; x < width && Collision_Edge(grid, x, y, side); x++)
+                    ;
+                Collision_Add(out, COLLIDER_EDGE, side, start, line, x, line);
+            }
+        }
+    }
 
-    for (uint32_t y = 0; y < mapData->mHeight; y++) {
-        for (uint32_t x = 0; x < mapData->mWidth; x++) {
+    for (uint32_t x = 0; x < width; x++) {
+        for (uint32_t side : { SIDE_EAST, SIDE_WEST }) {
+            const uint32_t line = side == SIDE_EAST ? x + 1 : x;
 
+            for (uint32_t y = y0; y < y1; y++) {
+                if (!Collision_Edge(grid, x, y, side)) {
+                    continue;
+                }
+                for (start = y; y < y1 && Collision_Edge(grid, x, y, side); y++)
+                    ;
+                Collision_Add(out, COLLIDER_EDGE, side, line, start, line, y);
+            }
         }
     }
 }
 
-void WriteBMF(const char *filename, bmf_t *data)
+/*
+PrepareCollision: merges the tiles' sides into the collision lump. The map is split into strips of
+COLLISION_STRIP_ROWS that are merged in parallel, then a box or a column edge that ends on the last row of a strip is
+joined with the one that starts right under it with the same columns. The strips don't depend on the amount of
+workers so the same map always comes out the same.
+*/
+static void PrepareCollision(bmfcJob_t *job, const lightSides_t *grid)
 {
+    const uint32_t numStrips = (grid->height + COLLISION_STRIP_ROWS - 1) / COLLISION_STRIP_ROWS;
+    std::vector<std::vector<mapcollider_t>> strips;
+    std::vector<mapcollider_t> colliders;
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, uint64_t> open, next;
+    uint64_t numBoxes, numSolid, numEdges, numSides;
+
+    strips.resize(numStrips);
+    Job_ParallelFor(numStrips, 1, [&](uint32_t start, uint32_t end) {
+        for (uint32_t i = start; i < end; i++) {
+            Collision_MergeStrip(grid, i * COLLISION_STRIP_ROWS, std::min((i + 1) * COLLISION_STRIP_ROWS, grid->height),
+                strips[i]);
+        }
+    });
+
+    for (uint32_t i = 0; i < numStrips; i++) {
+        const uint32_t y0 = i * COLLISION_STRIP_ROWS;
+        const uint32_t y1 = std::min(y0 + COLLISION_STRIP_ROWS, grid->height);
+
+        next.clear();
+        for (const auto& it : strips[i]) {
+            // row edges never cross into another strip
+            if (it.mins[1] == it.maxs[1]) {
+                colliders.emplace_back(it);
+                continue;
+            }
+
+            const auto key = std::make_tuple(it.type, it.side, it.mins[0], it.maxs[0]);
+            const auto prev = it.mins[1] == y0 ? open.find(key) : open.end();
+            uint64_t index;
+
+            if (prev != open.end()) {
+                index = prev->second;
+                colliders[index].maxs[1] = it.maxs[1];
+            }
+            else {
+                index = colliders.size();
+                colliders.emplace_back(it);
+            }
+            if (it.maxs[1] == y1) {
+                next[key] = index;
+            }
+        }
+        open.swap(next);
+        strips[i].clear();
+        strips[i].shrink_to_fit();
+    }
+
+    numBoxes = numSolid = numEdges = numSides = 0;
+    for (const auto& it : colliders) {
+        if (it.type == COLLIDER_BOX) {
+            numBoxes++;
+            numSolid += (uint64_t)(it.maxs[0] - it.mins[0]) * (it.maxs[1] - it.mins[1]);
+        }
+        else {
+            numEdges++;
+            numSides += (it.maxs[0] - it.mins[0]) + (it.maxs[1] - it.mins[1]);
+        }
+    }
+    if (!colliders.empty()) {
+        Spill_Write(&job->map->colliders, colliders.data(), sizeof(mapcollider_t) * colliders.size());
+    }
+
+    Printf("PrepareCollision: %lu solid tiles in %lu boxes, %lu sides in %lu edges", numSolid, numBoxes, numSides,
+        numEdges);
+}
+
+/*
+WriteBMF: writes the level out, returns false if it couldn't be and what was written of it shouldn't be kept
+*/
+static bool WriteBMF(const char *filename, bmf_t *data, bmfcJob_t *job, const maplightsample_t *samples)
+{
+    bmfcMap_t *map = job->map.get();
     FILE *fp;
+    bmfcLump_t lumps[NUMLUMPS];
+    bool ok;
 
     if (strlen(GetFilename(filename)) >= MAX_GDR_PATH) {
-        Error("Map name '%s' is too long", filename);
+        Printf("WriteBMF: map name '%s' is too long", filename);
+        return false;
+    }
+    if (Spill_AnyFailed(map)) {
+        Printf("WriteBMF: lost some of the records of '%s' on their way to the file", filename);
+        return false;
+    }
+
+    memset(lumps, 0, sizeof(lumps));
+    lumps[LUMP_TILES].spill = &map->tiles;
+    lumps[LUMP_TILES].remap = &job->tileset->remap;
+    lumps[LUMP_TILES].mapWidth = std::max(map->width, 1u);
+    lumps[LUMP_TILES].size = map->tiles.size;
+    lumps[LUMP_CHECKPOINTS].spill = &map->checkpoints;
+    lumps[LUMP_CHECKPOINTS].size = map->checkpoints.size;
+    lumps[LUMP_SPAWNS].spill = &map->spawns;
+    lumps[LUMP_SPAWNS].size = map->spawns.size;
+    lumps[LUMP_LIGHTS].data = map->lights.data();
+    lumps[LUMP_LIGHTS].size = sizeof(maplight_t) * map->lights.size();
+    lumps[LUMP_VERTICES].spill = &map->vertices;
+    lumps[LUMP_VERTICES].size = map->vertices.size;
+    lumps[LUMP_INDICES].spill = &map->indices;
+    lumps[LUMP_INDICES].size = map->indices.size;
+    lumps[LUMP_SPRITES].data = data->tileset.sprites;
+    lumps[LUMP_SPRITES].size = sizeof(tile2d_sprite_t) * data->tileset.info.numTiles;
+    lumps[LUMP_LIGHTMAP].data = samples;
+    lumps[LUMP_LIGHTMAP].size = sizeof(*samples) * map->width * map->height;
+    lumps[LUMP_COLLISION].spill = &map->colliders;
+    lumps[LUMP_COLLISION].size = map->colliders.size;
+    lumps[LUMP_NAVIGATION].data = map->navigation.data();
+    lumps[LUMP_NAVIGATION].size = map->navigation.size();
+    lumps[LUMP_TEXTURE].data = job->tileset->texture.data();
+    lumps[LUMP_TEXTURE].size = job->tileset->texture.size();
+    CompressLumps(lumps);
+
+    fp = fopen(filename, "wb");
+    if (!fp) {
+        Printf("WriteBMF: failed to open '%s' in write mode, %s", filename, strerror(errno));
+        for (uint32_t i = 0; i < NUMLUMPS; i++) {
+            Spill_Free(&lumps[i].stored);
+        }
+        return false;
     }
-    fp = SafeOpenWrite(filename);
 
     //
     // write everything
@@ -608,42 +1693,132 @@ void WriteBMF(const char *filename, bmf_t *data)
     SafeWrite(&data->tileset, sizeof(data->tileset), fp);
     SafeWrite(&data->map, sizeof(data->map), fp);
 
-    AddLump(mapData->mTiles.data(), sizeof(maptile_t) * mapData->mTiles.size(), &data->map, LUMP_TILES, fp);
-    AddLump(mapData->mCheckpoints.data(), sizeof(mapcheckpoint_t) * mapData->mCheckpoints.size(), &data->map, LUMP_CHECKPOINTS, fp);
-    AddLump(mapData->mSpawns.data(), sizeof(mapspawn_t) * mapData->mSpawns.size(), &data->map, LUMP_SPAWNS, fp);
-    AddLump(mapData->mLights.data(), sizeof(maplight_t) * mapData->mLights.size(), &data->map, LUMP_LIGHTS, fp);
-    AddLump(data->tileset.sprites, sizeof(tile2d_sprite_t) * data->tileset.info.numTiles, &data->map, LUMP_SPRITES, fp);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        AddLump(&lumps[i], &data->map, i, fp);
+    }
 
-    fseek(fp, 0L, SEEK_SET);
+    BMF_WriteHeader(fp, data);
+    fclose(fp);
 
-    SafeWrite(&data->ident, sizeof(data->ident), fp);
-    SafeWrite(&data->version, sizeof(data->version), fp);
-    SafeWrite(&data->tileset, sizeof(data->tileset), fp);
-    SafeWrite(&data->map, sizeof(data->map), fp);
+    ok = !compressionReport || ReportLumps(filename, lumps);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        Spill_Free(&lumps[i].stored);
+    }
+    return ok;
+}
 
-    fclose(fp);
+/*
+FreeMap: drops what was streamed out of the job's map file along with its temporary files
+*/
+static void FreeMap(bmfcJob_t *job)
+{
+    if (!job->map) {
+        return;
+    }
+    Spill_Free(&job->map->tiles);
+    Spill_Free(&job->map->checkpoints);
+    Spill_Free(&job->map->spawns);
+    Spill_Free(&job->map->vertices);
+    Spill_Free(&job->map->indices);
+    Spill_Free(&job->map->colliders);
+    job->map.reset();
+}
+
+/*
+FailJob: a map that couldn't be compiled, the rest of a batch carries on without it
+*/
+static void FailJob(bmfcJob_t *job, uint64_t start)
+{
+    Printf("Failed to compile '%s'", job->input.c_str());
+    job->status = JOB_FAILED;
+    FreeMap(job);
+    job->totalTime = Sys_Microseconds() - start;
 }
 
-void CompileBMF(const char *output, const char *input)
+/*
+CompileBMF: compiles one job's map, it's skipped if nothing it depends on changed since the build in prevHash
+and the output is still there. Where the texture is found only depends on the map text, so an unchanged map is
+checked against the last build's texture before it's parsed.
+*/
+static void CompileBMF(bmfcJob_t *job)
 {
+    const uint64_t start = Sys_Microseconds();
+    uint64_t time;
+    std::error_code err;
+    lightSides_t grid;
+    CLightmap lightmap;
+    maplightsample_t *samples;
+    float ambient[3];
+    uint64_t numCells;
+    int32_t *layers;
+    byte *sides;
     bmf_t bmf;
-    char *compressed;
-    FileStream file;
-    const char *filename = input;
+    bool ok;
 
-    Printf("Loading map file '%s'", filename);
+    // lumps that aren't written yet stay zeroed
+    memset(&bmf, 0, sizeof(bmf));
+    time = start;
+    job->mapHash = HashFile(job->input.c_str());
+    if (job->prevHash && !job->prevTexture.empty() && std::filesystem::is_regular_file(job->output, err)
+        && JobHash(job->mapHash, HashTexture(job->prevTexture)) == job->prevHash) {
+        Printf("'%s' is up to date", job->output.c_str());
+        job->texture = job->prevTexture;
+        job->hash = job->prevHash;
+        job->status = JOB_SKIPPED;
+        job->totalTime = Sys_Microseconds() - start;
+        return;
+    }
 
-    if (file.Open(filename, "r")) {
-        if (!Map_LoadFile(&file, GetExtension(filename), filename)) {
-            Printf("Failed to load map file '%s', not compiling", filename);
-            return;
-        }
+    if (!LoadMapFile(job)) {
+        FailJob(job, start);
+        return;
     }
-    else {
-        Printf("Failed to load map file '%s', not compiling", filename);
+    job->texture = ResolveTexture(job->tilesetInfo.texture, job->input.c_str());
+    job->hash = JobHash(job->mapHash, HashTexture(job->texture));
+    job->parseTime = Sys_Microseconds() - time;
+
+    if (job->prevHash && job->prevHash == job->hash && std::filesystem::is_regular_file(job->output, err)) {
+        Printf("'%s' is up to date", job->output.c_str());
+        job->status = JOB_SKIPPED;
+        FreeMap(job);
+        job->totalTime = Sys_Microseconds() - start;
         return;
     }
-    bmf.tileset.sprites = GenerateSprites();
+
+    time = Sys_Microseconds();
+    numCells = std::max<uint64_t>((uint64_t)job->map->width * job->map->height, 1);
+    sides = (byte *)GetMemory(numCells * NUMSIDES);
+    layers = (int32_t *)GetMemory(numCells * sizeof(*layers));
+    LoadTileset(job);
+    ScanTiles(job, sides, layers);
+    bmf.tileset.sprites = GenerateSprites(job);
+    job->tilesetTime = Sys_Microseconds() - time;
+
+    Printf("Baking lightmap for '%s'...", job->input.c_str());
+    time = Sys_Microseconds();
+    grid.sides = sides;
+    grid.stride = NUMSIDES;
+    grid.width = job->map->width;
+    grid.height = job->map->height;
+    ambient[0] = job->map->ambientColor[0] + job->map->ambientIntensity;
+    ambient[1] = job->map->ambientColor[1] + job->map->ambientIntensity;
+    ambient[2] = job->map->ambientColor[2] + job->map->ambientIntensity;
+    Lightmap_BakeSides(&grid, job->map->lights.data(), job->map->lights.size(), ambient, &lightmap);
+    job->lightmapTime = Sys_Microseconds() - time;
+
+    time = Sys_Microseconds();
+    PrepareCollision(job, &grid);
+    job->collisionTime = Sys_Microseconds() - time;
+
+    time = Sys_Microseconds();
+    Nav_Build(&grid, job->map->navigation);
+    FreeMemory(sides);
+    job->navigationTime = Sys_Microseconds() - time;
+
+    samples = (maplightsample_t *)GetMemory(sizeof(*samples) * numCells);
+    lightmap.Quantize(samples);
+    PrepareDrawData(job, layers, samples);
+    FreeMemory(layers);
 
     bmf.ident = LEVEL_IDENT;
     bmf.version = LEVEL_VERSION;
@@ -652,15 +1827,225 @@ void CompileBMF(const char *output, const char *input)
     bmf.tileset.magic = TILE2D_MAGIC;
     bmf.tileset.version = TILE2D_VERSION;
 
-//    Printf("Compressing sprite buffer...");
-    memcpy(&bmf.tileset.info, &tilesetInfo, sizeof(tilesetInfo));
-//    compressed = Compress(bmf.tileset.sprites, sizeof(tile2d_sprite_t) * bmf.tileset.info.numTiles, &bmf.tileset.info.compressedSize);
-//    FreeMemory(bmf.tileset.sprites);
-//    bmf.tileset.sprites = (tile2d_sprite_t *)compressed;
+    // the sprites are compressed along with the other lumps, not through the tileset header
+    memcpy(&bmf.tileset.info, &job->tilesetInfo, sizeof(job->tilesetInfo));
+    bmf.tileset.info.numTiles = job->tileset->remap.unique.size();
+
+    time = Sys_Microseconds();
+    std::filesystem::create_directories(std::filesystem::path(job->output).parent_path(), err);
+    ok = WriteBMF(job->output.c_str(), &bmf, job, samples);
+    FreeMemory(bmf.tileset.sprites);
+    FreeMemory(samples);
+    if (!ok || (optimizeOutput && !Optimize_File(job->output.c_str(), job->output.c_str(), lumpCompression))
+        || (sectorSize && !Sector_WriteFile(job->output.c_str(), job->output.c_str(), sectorSize, lumpCompression))) {
+        // a half done level isn't left around to be picked up as up to date
+        if (std::filesystem::is_regular_file(job->output, err)) {
+            std::filesystem::remove(job->output, err);
+        }
+        FailJob(job, start);
+        return;
+    }
+    job->writeTime = Sys_Microseconds() - time;
+
+    job->status = JOB_COMPILED;
+    FreeMap(job);
+    job->totalTime = Sys_Microseconds() - start;
+    Printf("Finished write bmf file '%s' in %.3f ms", job->output.c_str(), job->totalTime / 1000.0);
+}
+
+static void AddJob(std::vector<bmfcJob_t>& jobs, const std::filesystem::path& input, const std::filesystem::path& output)
+{
+    bmfcJob_t& job = jobs.emplace_back();
+
+    job.input = input.lexically_normal().string();
+    job.output = output.lexically_normal().string();
+    job.hash = job.prevHash = job.mapHash = 0;
+    job.tileset = NULL;
+    job.status = JOB_PENDING;
+    job.parseTime = job.tilesetTime = job.lightmapTime = job.collisionTime = job.navigationTime = job.writeTime = job.totalTime = 0;
+}
+
+/*
+Batch_FindMaps: every .map under a directory, or the maps listed in a text file with one "<map> [output]" per line.
+Outputs go to outDir, keeping the layout of the directory or under the output given in the list.
+*/
+static void Batch_FindMaps(const char *source, const char *outDir, std::vector<bmfcJob_t>& jobs)
+{
+    const std::filesystem::path root = source;
+    std::error_code err;
+
+    if (std::filesystem::is_directory(root, err)) {
+        for (const auto& it : std::filesystem::recursive_directory_iterator{ root, err }) {
+            if (!it.is_regular_file() || N_stricmp(it.path().extension().string().c_str(), ".map")) {
+                continue;
+            }
+            AddJob(jobs, it.path(), std::filesystem::path(outDir) / it.path().lexically_relative(root).replace_extension(".bmf"));
+        }
+        // the directory's order isn't the same from one machine to the next
+        std::sort(jobs.begin(), jobs.end(), [](const bmfcJob_t& a, const bmfcJob_t& b) { return a.input < b.input; });
+        return;
+    }
+
+    std::ifstream file(source);
+    std::string line;
+    if (!file.is_open()) {
+        Error("Batch_FindMaps: '%s' isn't a directory or a list of maps", source);
+    }
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string input, output;
+
+        if (!(words >> input) || input[0] == '#') {
+            continue;
+        }
+        words >> output;
+        AddJob(jobs, root.parent_path() / input,
+            std::filesystem::path(outDir) / (output.size() ? std::filesystem::path(output)
+                : std::filesystem::path(input).filename().replace_extension(".bmf")));
+    }
+}
+
+/*
+Batch_LoadManifest: picks up the hashes of the last build from its manifest so that whatever hasn't changed since
+can be skipped, maps that failed last time are always tried again
+*/
+static void Batch_LoadManifest(const std::string& path, std::vector<bmfcJob_t>& jobs)
+{
+    std::unordered_map<std::string, std::pair<uint64_t, std::string>> builds;
+    std::error_code err;
+    json data;
+
+    if (!std::filesystem::is_regular_file(path, err) || !LoadJSON(data, path)) {
+        return;
+    }
+    if (!data.contains("maps") || !data["maps"].is_array() || data.value("version", 0) != BMFC_VERSION) {
+        return;
+    }
+
+    for (const auto& it : data["maps"]) {
+        if (it.value("status", "") == "failed") {
+            continue;
+        }
+        builds[it.value("output", "")] = { strtoull(it.value("hash", "0").c_str(), NULL, 16), it.value("texture", "") };
+    }
+    for (auto& it : jobs) {
+        auto build = builds.find(it.output);
+        if (build != builds.end()) {
+            it.prevHash = build->second.first;
+            it.prevTexture = build->second.second;
+        }
+    }
+}
+
+static const char *JobStatusString(jobStatus_t status)
+{
+    switch (status) {
+    case JOB_COMPILED: return "compiled";
+    case JOB_SKIPPED: return "skipped";
+    case JOB_FAILED: return "failed";
+    default: break;
+    };
+    return "pending";
+}
+
+static void Batch_WriteManifest(const std::string& path, const std::vector<bmfcJob_t>& jobs, uint32_t numWorkers, uint64_t time)
+{
+    char hash[32];
+    json data, map;
+
+    data["version"] = BMFC_VERSION;
+    data["workers"] = numWorkers;
+    data["totalMs"] = time / 1000.0;
+    data["maps"] = json::array();
 
-    Printf("Writing file...");
-    WriteBMF(output, &bmf);
-    Printf("Finished write bmf file '%s'", output);
+    for (const auto& it : jobs) {
+        map["input"] = it.input;
+        map["output"] = it.output;
+        map["status"] = JobStatusString(it.status);
+        snprintf(hash, sizeof(hash), "%016lx", it.hash);
+        map["hash"] = hash;
+        map["texture"] = it.texture;
+        map["parseMs"] = it.parseTime / 1000.0;
+        map["tilesetMs"] = it.tilesetTime / 1000.0;
+        map["lightmapMs"] = it.lightmapTime / 1000.0;
+        map["collisionMs"] = it.collisionTime / 1000.0;
+        map["navigationMs"] = it.navigationTime / 1000.0;
+        map["writeMs"] = it.writeTime / 1000.0;
+        map["totalMs"] = it.totalTime / 1000.0;
+        data["maps"].push_back(map);
+    }
+
+    std::ofstream file(path, std::ios::out);
+    if (!file.is_open()) {
+        Error("Batch_WriteManifest: failed to open '%s' in write mode", path.c_str());
+    }
+    file << data.dump(4);
+    file.close();
+}
+
+/*
+Batch_Compile: compiles every map from source into outDir on a pool of workers, each one picks up the next map as
+soon as it's done with the last so that one huge map doesn't hold up a whole share of the list. With more than one
+worker the maps are what's run in parallel, the passes inside of each one run on its worker alone. Returns the
+amount of maps that failed.
+*/
+static uint32_t Batch_Compile(const char *source, const char *outDir, uint32_t numWorkers, bool force)
+{
+    const std::string manifestPath = (std::filesystem::path(outDir) / BMFC_BUILD_MANIFEST).string();
+    const uint64_t start = Sys_Microseconds();
+    std::vector<bmfcJob_t> jobs;
+    std::atomic<uint32_t> next;
+    uint32_t numCompiled, numSkipped, numFailed;
+    std::error_code err;
+    uint64_t time;
+
+    Batch_FindMaps(source, outDir, jobs);
+    if (jobs.empty()) {
+        Printf("Batch_Compile: no maps found in '%s'", source);
+        return 0;
+    }
+    if (!force) {
+        Batch_LoadManifest(manifestPath, jobs);
+    }
+    std::filesystem::create_directories(outDir, err);
+
+    numWorkers = std::min(numWorkers ? numWorkers : Job_NumWorkers(), (uint32_t)jobs.size());
+    Printf("Batch_Compile: %lu maps from '%s' on %u workers", jobs.size(), source, numWorkers);
+
+    next = 0;
+    {
+        boost::thread_group group;
+
+        for (uint32_t i = 0; i < numWorkers; i++) {
+            group.create_thread([&, i](void) {
+                char name[64];
+                uint32_t index;
+
+                snprintf(name, sizeof(name), "Batch Worker %u", i);
+                Profile_SetThreadName(name);
+                Job_SetSerial(numWorkers > 1);
+
+                while ((index = next++) < jobs.size()) {
+                    CompileBMF(&jobs[index]);
+                }
+            });
+        }
+        group.join_all();
+    }
+    time = Sys_Microseconds() - start;
+
+    numCompiled = numSkipped = numFailed = 0;
+    for (const auto& it : jobs) {
+        numCompiled += it.status == JOB_COMPILED;
+        numSkipped += it.status == JOB_SKIPPED;
+        numFailed += it.status == JOB_FAILED;
+    }
+    Batch_WriteManifest(manifestPath, jobs, numWorkers, time);
+
+    Printf("Batch_Compile: %u compiled, %u up to date, %u failed in %.3f ms, manifest written to '%s'", numCompiled, numSkipped,
+        numFailed, time / 1000.0, manifestPath.c_str());
+
+    return numFailed;
 }
 
 static void print_help(void)
@@ -669,7 +2054,21 @@ static void print_help(void)
         "usage: %s [options...] -o <out>\n"
         "[options]\n"
         "\t--map <file>     provide a map file (ext = .map)\n"
-    , myargv[0]);
+        "\t--batch <dir|list>  compile every .map in a directory or listed in a file, -o is the output directory\n"
+        "\t--jobs <count>   maps compiled at once in batch mode, defaults to the amount of cores\n"
+        "\t--force          rebuild every map in batch mode even if it's up to date\n"
+        "\t--bakebench      time a lightmap bake of a maximum-size map with the maximum amount of lights\n"
+        "\t--nodedup        keep duplicate and empty tiles in the sprite list\n"
+        "\t--embed-texture  store the tileset texture in the level, mipped and ready for GL, instead of its path\n"
+        "\t--compression <none|zlib|bzip2>  compress every lump over %u bytes and report what each one came out at\n"
+        "\t--optimize       drop the empty tiles and reorder the tiles and draw data of every level that's written\n"
+        "\t--optimize-bmf <file>  optimize a level that's already compiled, into -o if it's given or else in place\n"
+        "\t--sectors <tiles>  split every level into sectors of this many tiles a side that can be streamed in\n"
+        "\t--sectorize-bmf <file>  split a level that's already compiled, into -o if it's given or else in place\n"
+        "\t--navbench <file> [queries]  time path searches on a compiled level with and without its navigation graph\n"
+        "\t--imagebench <files...>  compare how fast images decode as they are and as qoi\n"
+        "\t--imagecheck     split and mip a generated tile sheet without GL and check every texel\n"
+    , myargv[0], COMPRESSED_LUMP_SIZE);
 }
 
 int main(int argc, char **argv)
@@ -681,24 +2080,99 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    mapData = std::make_unique<CMapData>();
-    const char *output;
-    const char *map, *tileset, *texture;
+    const char *output = NULL;
+    const char *map = NULL;
+    const char *batch = NULL;
+    const char *optimize = NULL;
+    const char *sectorize = NULL;
+    uint32_t numWorkers = 0;
+    bool force = false;
 
-    for (int i = 0; i < argc; i++) {
-        if (!N_stricmp(argv[i], "-o")) {
-            output = argv[i + 1];
-            break;
+    for (int i = 1; i < argc; i++) {
+        if (!N_stricmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--map") && i + 1 < argc) {
+            map = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--batch") && i + 1 < argc) {
+            batch = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--jobs") && i + 1 < argc) {
+            numWorkers = (uint32_t)atoi(argv[++i]);
         }
-        else if (!N_stricmp(argv[i], "--map")) {
-            map = argv[i + 1];
+        else if (!N_stricmp(argv[i], "--force")) {
+            force = true;
         }
+        else if (!N_stricmp(argv[i], "--optimize")) {
+            optimizeOutput = true;
+        }
+        else if (!N_stricmp(argv[i], "--optimize-bmf") && i + 1 < argc) {
+            optimize = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--sectors") && i + 1 < argc) {
+            sectorSize = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!N_stricmp(argv[i], "--sectorize-bmf") && i + 1 < argc) {
+            sectorize = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--embed-texture")) {
+            embedTexture = true;
+        }
+        else if (!N_stricmp(argv[i], "--nodedup")) {
+            noDedup = true;
+        }
+        else if (!N_stricmp(argv[i], "--compression") && i + 1 < argc) {
+            i++;
+            if (!N_stricmp(argv[i], "zlib")) {
+                lumpCompression = COMPRESS_ZLIB;
+            }
+            else if (!N_stricmp(argv[i], "bzip2")) {
+                lumpCompression = COMPRESS_BZIP2;
+            }
+            else if (!N_stricmp(argv[i], "none")) {
+                lumpCompression = COMPRESS_NONE;
+            }
+            else {
+                Error("unknown compression '%s', expected none, zlib or bzip2", argv[i]);
+            }
+            compressionReport = true;
+        }
+        else if (!N_stricmp(argv[i], "--imagebench")) {
+            Image_Benchmark((const char **)argv + i + 1, argc - i - 1);
+            return 0;
+        }
+        else if (!N_stricmp(argv[i], "--imagecheck")) {
+            return Image_Check() ? 0 : 1;
+        }
+        else if (!N_stricmp(argv[i], "--navbench") && i + 1 < argc) {
+            Nav_Benchmark(argv[i + 1], i + 2 < argc ? (uint32_t)atoi(argv[i + 2]) : 1000);
+            return 0;
+        }
+        else if (!N_stricmp(argv[i], "--bakebench")) {
+            Lightmap_Benchmark();
+            return 0;
+        }
+    }
+    if (optimize) {
+        return Optimize_File(optimize, output ? output : optimize, lumpCompression) ? 0 : 1;
+    }
+    if (sectorize) {
+        return Sector_WriteFile(sectorize, output ? output : sectorize, sectorSize ? sectorSize : 64, lumpCompression) ? 0 : 1;
     }
     if (!output) {
         Error("output file not provided");
     }
+    if (batch) {
+        return Batch_Compile(batch, output, numWorkers, force) ? 1 : 0;
+    }
+    if (!map) {
+        Error("map file not provided");
+    }
 
-    CompileBMF(output, map);
+    std::vector<bmfcJob_t> jobs;
+    AddJob(jobs, map, output);
+    CompileBMF(&jobs[0]);
 
-    return 0;
+    return jobs[0].status == JOB_FAILED ? 1 : 0;
 }
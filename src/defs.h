@@ -43,8 +43,9 @@ inline const char *WtoA( const LPWSTR s )
     #endif
 #endif
 
-#ifndef BMFC
 using json = nlohmann::json;
+
+#ifndef BMFC
 using string_t = eastl::basic_string<char, heap_allocator>;
 template<typename T>
 using vector_t = eastl::vector<T, heap_allocator>;
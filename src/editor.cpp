@@ -55,6 +55,78 @@ static void MapInfo_f(void)
     }
 }
 
+static void BakeLighting_f(void)
+{
+    Lightmap_Bake(mapData.get(), &mapData->mLightmap);
+}
+
+static void FindFile_f(void)
+{
+    if (Argc() != 2) {
+        Printf("usage: findFile <name|.ext>");
+        return;
+    }
+
+    const std::vector<CFileEntry *>& files = Argv(1)[0] == '.' ? editor->mFileTree.FindByExtension(Argv(1))
+        : editor->mFileTree.FindByName(Argv(1));
+    for (const auto& it : files) {
+        Printf("%s", it->mPath.c_str());
+    }
+    Printf("%lu matches out of %lu indexed entries%s", files.size(), editor->mFileTree.NumEntries(),
+        editor->mFileTree.IsScanning() ? " (still indexing)" : "");
+}
+
+static void LightBench_f(void)
+{
+    Lightmap_Benchmark();
+}
+
+static void ImageBench_f(void)
+{
+    std::vector<const char *> paths;
+
+    for (uint32_t i = 1; i < Argc(); i++) {
+        paths.emplace_back(Argv(i));
+    }
+    // the project's own sheets if none are given
+    if (paths.empty()) {
+        if (project->tileset->texData->IsLoaded()) {
+            paths.emplace_back(project->tileset->texData->mName.c_str());
+        }
+        if (project->tileset->normalData->IsLoaded()) {
+            paths.emplace_back(project->tileset->normalData->mName.c_str());
+        }
+    }
+    if (paths.empty()) {
+        Printf("usage: imageBench [files...]");
+        return;
+    }
+
+    Image_Benchmark(paths.data(), paths.size());
+}
+
+static void ImageConvert_f(void)
+{
+    uint32_t width, height, channels;
+    const char *error;
+    byte *pixels;
+
+    if (Argc() != 3) {
+        Printf("usage: imageConvert <input> <output>");
+        return;
+    }
+
+    pixels = Image_LoadFile(Argv(1), &width, &height, &channels, &error);
+    if (!pixels) {
+        Printf("imageConvert: failed to load '%s', %s", Argv(1), error);
+        return;
+    }
+    if (Image_SaveFile(Argv(2), pixels, width, height, channels)) {
+        Printf("imageConvert: wrote '%s'", Argv(2));
+    }
+    FreeMemory(pixels);
+}
+
 CEditor::CEditor(void)
     : mConsoleActive{ false }
 {
@@ -65,6 +137,11 @@ CEditor::CEditor(void)
     Cmd_AddCommand("save", Save_f);
     Cmd_AddCommand("saveAll", SaveAll_f);
     Cmd_AddCommand("mapinfo", MapInfo_f);
+    Cmd_AddCommand("bakeLighting", BakeLighting_f);
+    Cmd_AddCommand("lightBench", LightBench_f);
+    Cmd_AddCommand("imageBench", ImageBench_f);
+    Cmd_AddCommand("imageConvert", ImageConvert_f);
+    Cmd_AddCommand("findFile", FindFile_f);
 }
 
 bool CEditor::ValidateEntityId(uint32_t id) const
@@ -78,38 +155,12 @@ bool CEditor::ValidateEntityId(uint32_t id) const
 }
 
 /*
-RecursiveDirectoryIterator: iterates through the given and all the subdirectories
-*/
-static void RecursiveDirectoryIterator(const std::filesystem::path& path, std::vector<CFileEntry>& fileList)
-{
-    if (!std::filesystem::directory_entry{ path }.is_directory()) {
-        return;
-    }
-    for (const auto& it : std::filesystem::directory_iterator{ path }) {
-        fileList.emplace_back(it.path(), it.is_directory());
-        if (it.is_directory()) {
-            RecursiveDirectoryIterator(it.path(), fileList);
-        }
-    }
-}
-
-/*
-DirectoryIterator: iterates through the given path, does not recurse into subdirectories
+CEditor::ReloadFileCache: starts the file tree over, the contents are listed lazily and indexed in the background
 */
-static void DirectoryIterator(const std::filesystem::path& path, std::vector<CFileEntry>& fileList)
-{
-    if (!std::filesystem::directory_entry{ path }.is_directory()) {
-        return;
-    }
-    for (const auto& it : std::filesystem::directory_iterator{ path }) {
-        fileList.emplace_back(it.path(), it.is_directory());
-    }
-}
-
 void CEditor::ReloadFileCache(void)
 {
     Printf("[CEditor::ReloadFileCache] reloading file cache...");
-    RecursiveDirectoryIterator(gameConfig->mEditorPath.c_str(), mFileCache);
+    mFileTree.Reload(gameConfig->mEditorPath);
 }
 
 static void Draw_Popups(void)
@@ -137,18 +188,44 @@ static void Draw_Popups(void)
     }
 }
 
-CFileEntry *Draw_FileList(std::vector<CFileEntry>& fileList)
+/*
+Draw_FileList: a menu of the directory's contents, subdirectories are listed as they're opened and only the
+visible rows are submitted, returns the file that was clicked on if there was one
+*/
+CFileEntry *Draw_FileList(CFileEntry *dir)
 {
-    for (auto& it : fileList) {
-        if (it.mIsDir && ImGui::BeginMenu(it.mPath.c_str())) {
-            Draw_FileList(it.mDirList);
-            ImGui::EndMenu();
-        }
-        else if (ImGui::MenuItem(it.mPath.c_str())) {
-            return std::addressof(it);
+    CFileEntry *selected, *entry;
+    ImGuiListClipper clipper;
+
+    selected = NULL;
+    editor->mFileTree.Expand(dir);
+
+    if (dir->mDirList.empty()) {
+        ImGui::TextDisabled("(empty)");
+        return NULL;
+    }
+
+    clipper.Begin(dir->mDirList.size());
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            CFileEntry *it = dir->mDirList[i];
+
+            ImGui::PushID(it);
+            if (it->mIsDir) {
+                if (ImGui::BeginMenu(it->mName.c_str())) {
+                    if ((entry = Draw_FileList(it)) != NULL) {
+                        selected = entry;
+                    }
+                    ImGui::EndMenu();
+                }
+            }
+            else if (ImGui::MenuItem(it->mName.c_str())) {
+                selected = it;
+            }
+            ImGui::PopID();
         }
     }
-    return NULL;
+    return selected;
 }
 
 void CEditor::AddPopup(const CPopup& popup)
@@ -157,6 +234,7 @@ void CEditor::AddPopup(const CPopup& popup)
 
 void CEditor::Draw(void)
 {
+    PROFILE_SCOPE("CEditor::Draw");
     if (Key_IsDown(KEY_LCTRL)) {
         // change editor mode
         if (Key_IsDown(KEY_M)) {
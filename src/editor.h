@@ -4,19 +4,7 @@
 #pragma once
 
 #include "gui.h"
-
-class CFileEntry
-{
-public:
-	std::string mPath;
-	std::vector<CFileEntry> mDirList;
-	bool mIsDir;
-	CFileEntry *mParentDir;
-
-	CFileEntry(const std::filesystem::path& path, bool isDir)
-		: mPath{ path.c_str() }, mDirList{}, mIsDir{ isDir } { }
-	~CFileEntry() { }
-};
+#include "filetree.h"
 
 class CPopup
 {
@@ -51,14 +39,14 @@ public:
 
 	editorMode_t mode;
 
-	std::vector<CFileEntry> mFileCache;
+	CFileTree mFileTree;
 	std::list<CPopup> mPopups;
 	bool mConsoleActive;
 };
 
 inline const std::filesystem::path pwdString = std::filesystem::current_path();
 
-CFileEntry *Draw_FileList(std::list<CFileEntry>& fileList);
+CFileEntry *Draw_FileList(CFileEntry *dir);
 extern std::unique_ptr<CEditor> editor;
 
 inline bool __attribute__((format(printf, 2, 3))) ItemWithTooltip(const char *item_name, const char *fmt, ...)
@@ -0,0 +1,248 @@
+#include "gln.h"
+#include <filesystem>
+
+static const std::vector<CFileEntry *> emptyList;
+
+static std::string FileTree_Lower(const char *str)
+{
+    std::string out{ str };
+
+    for (auto& it : out) {
+        it = tolower(it);
+    }
+    return out;
+}
+
+static std::string FileTree_Normalize(const std::string& path)
+{
+    std::error_code err;
+    std::string out;
+
+    out = std::filesystem::weakly_canonical(std::filesystem::absolute(path, err), err).string();
+    if (out.size() > 1 && out.back() == PATH_SEP) {
+        out.pop_back();
+    }
+    return out;
+}
+
+static bool FileTree_Compare(const CFileEntry *a, const CFileEntry *b)
+{
+    if (a->mIsDir != b->mIsDir) {
+        return a->mIsDir;
+    }
+    return a->mName < b->mName;
+}
+
+void CFileTree::Index(CFileEntry *entry)
+{
+    const char *ext;
+
+    mNameIndex[FileTree_Lower(entry->mName.c_str())].emplace_back(entry);
+    if (!entry->mIsDir && (ext = strrchr(entry->mName.c_str(), '.')) != NULL) {
+        mExtIndex[FileTree_Lower(ext + 1)].emplace_back(entry);
+    }
+}
+
+void CFileTree::Unindex(CFileEntry *entry)
+{
+    const auto erase = [entry](std::unordered_map<std::string, std::vector<CFileEntry *>>& index, const std::string& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second.erase(std::remove(it->second.begin(), it->second.end(), entry), it->second.end());
+            if (it->second.empty()) {
+                index.erase(it);
+            }
+        }
+    };
+    const char *ext;
+
+    erase(mNameIndex, FileTree_Lower(entry->mName.c_str()));
+    if (!entry->mIsDir && (ext = strrchr(entry->mName.c_str(), '.')) != NULL) {
+        erase(mExtIndex, FileTree_Lower(ext + 1));
+    }
+}
+
+/*
+CFileTree::Insert: adds a single entry under its parent, which has to be in the tree already
+*/
+CFileEntry *CFileTree::Insert(const std::string& path, bool isDir)
+{
+    CFileEntry *parent, *entry;
+
+    auto it = mEntries.find(path);
+    if (it != mEntries.end()) {
+        return it->second.get();
+    }
+
+    parent = Find(std::filesystem::path{ path }.parent_path().string());
+    if (!parent) {
+        return NULL;
+    }
+
+    entry = new CFileEntry(path, isDir, parent);
+    mEntries.emplace(path, entry);
+    parent->mDirList.insert(std::lower_bound(parent->mDirList.begin(), parent->mDirList.end(), entry, FileTree_Compare), entry);
+    Index(entry);
+
+    return entry;
+}
+
+void CFileTree::Remove(CFileEntry *entry)
+{
+    // children first, they point back up
+    while (!entry->mDirList.empty()) {
+        Remove(entry->mDirList.back());
+    }
+
+    Unindex(entry);
+    if (entry->mParentDir) {
+        std::vector<CFileEntry *>& siblings = entry->mParentDir->mDirList;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), entry), siblings.end());
+    }
+    else {
+        mRoot = NULL;
+    }
+
+    const std::string path = entry->mPath;
+    mEntries.erase(path);
+}
+
+CFileEntry *CFileTree::Find(const std::string& path) const
+{
+    auto it = mEntries.find(path);
+    return it != mEntries.end() ? it->second.get() : NULL;
+}
+
+const std::vector<CFileEntry *>& CFileTree::FindByExtension(const char *ext) const
+{
+    auto it = mExtIndex.find(FileTree_Lower(*ext == '.' ? ext + 1 : ext));
+    return it != mExtIndex.end() ? it->second : emptyList;
+}
+
+const std::vector<CFileEntry *>& CFileTree::FindByName(const char *name) const
+{
+    auto it = mNameIndex.find(FileTree_Lower(name));
+    return it != mNameIndex.end() ? it->second : emptyList;
+}
+
+/*
+CFileTree::Expand: lists a single directory the first time it's opened, nothing below it is touched
+*/
+void CFileTree::Expand(CFileEntry *dir)
+{
+    std::error_code err;
+
+    if (!dir->mIsDir || dir->mListed) {
+        return;
+    }
+
+    PROFILE_SCOPE("CFileTree::Expand");
+    for (const auto& it : std::filesystem::directory_iterator{ dir->mPath, err }) {
+        Insert(it.path().string(), it.is_directory(err));
+    }
+    dir->mListed = true;
+}
+
+/*
+CFileTree::FileChanged: applies a change reported by the file watcher, only directories that have been listed are
+updated, the rest are picked up when they're opened
+*/
+void CFileTree::FileChanged(const std::string& path, uint32_t flags)
+{
+    std::error_code err;
+    CFileEntry *entry, *parent;
+
+    if (!mRoot || path.compare(0, mRoot->mPath.size(), mRoot->mPath) != 0 || !(flags & (WATCH_CREATED | WATCH_DELETED))) {
+        return;
+    }
+
+    entry = Find(path);
+    if (!std::filesystem::exists(path, err)) {
+        if (entry) {
+            Remove(entry);
+        }
+        return;
+    }
+    if (entry) {
+        return;
+    }
+
+    parent = Find(std::filesystem::path{ path }.parent_path().string());
+    if (parent && parent->mListed) {
+        Insert(path, std::filesystem::is_directory(path, err));
+    }
+}
+
+/*
+CFileTree::MergeScan: adds what the background scan found a batch at a time so that a huge tree doesn't stall a
+single frame, entries the tree already has from being expanded or watched are skipped
+*/
+void CFileTree::MergeScan(uint32_t generation, std::shared_ptr<std::vector<std::pair<std::string, bool>>> found, uint64_t start,
+    uint64_t scanTime)
+{
+    uint64_t end;
+
+    if (generation != mGeneration) {
+        return; // reloaded since
+    }
+
+    PROFILE_SCOPE("CFileTree::MergeScan");
+    end = std::min(start + FILETREE_MERGE_BATCH, (uint64_t)found->size());
+    for (uint64_t i = start; i < end; i++) {
+        Insert((*found)[i].first, (*found)[i].second);
+    }
+
+    if (end < found->size()) {
+        Job_QueueMain([this, generation, found, end, scanTime](void) { MergeScan(generation, found, end, scanTime); });
+        return;
+    }
+
+    // every directory has been seen now
+    for (auto& it : mEntries) {
+        if (it.second->mIsDir) {
+            it.second->mListed = true;
+        }
+    }
+    mScanning = false;
+
+    Printf("[CFileTree::Reload] indexed %lu entries under '%s', scan took %.3f ms", mEntries.size(), mRoot->mPath.c_str(),
+        scanTime / 1000.0);
+}
+
+/*
+CFileTree::Reload: throws away the tree and starts over from rootPath, only the root itself is listed right away
+*/
+void CFileTree::Reload(const std::string& rootPath)
+{
+    const std::string path = FileTree_Normalize(rootPath);
+    const uint32_t generation = ++mGeneration;
+    CFileEntry *root;
+
+    mEntries.clear();
+    mExtIndex.clear();
+    mNameIndex.clear();
+
+    root = new CFileEntry(path, true, NULL);
+    mEntries.emplace(path, root);
+    mRoot = root;
+    mScanning = true;
+
+    Job_Async([this, path, generation](void) {
+        auto found = std::make_shared<std::vector<std::pair<std::string, bool>>>();
+        const uint64_t start = Sys_Microseconds();
+        std::error_code err;
+
+        // parents always come before their contents
+        for (auto it = std::filesystem::recursive_directory_iterator{ path, std::filesystem::directory_options::skip_permission_denied, err };
+            it != std::filesystem::recursive_directory_iterator{}; it.increment(err))
+        {
+            if (err) {
+                break;
+            }
+            found->emplace_back(it->path().string(), it->is_directory(err));
+        }
+
+        const uint64_t scanTime = Sys_Microseconds() - start;
+        Job_QueueMain([this, generation, found, scanTime](void) { MergeScan(generation, found, 0, scanTime); });
+    });
+}
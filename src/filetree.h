@@ -0,0 +1,66 @@
+#ifndef __FILETREE__
+#define __FILETREE__
+
+#pragma once
+
+// how many scanned entries get merged into the tree per frame
+#define FILETREE_MERGE_BATCH 4096
+
+class CFileEntry
+{
+public:
+    std::string mPath; // absolute
+    std::string mName;
+    std::vector<CFileEntry *> mDirList; // directories first, then by name
+    CFileEntry *mParentDir;
+    bool mIsDir;
+    bool mListed; // mDirList has been filled in
+
+    CFileEntry(const std::string& path, bool isDir, CFileEntry *parent)
+        : mPath{ path }, mName{ GetFilename(path.c_str()) }, mDirList{}, mParentDir{ parent }, mIsDir{ isDir }, mListed{ false } { }
+    ~CFileEntry() { }
+};
+
+/*
+CFileTree: the files under the editor path. Directories are listed the first time they're opened, a scan on an
+async worker fills in the rest along with the extension and name indices, and the file watcher keeps it current
+without ever rescanning.
+*/
+class CFileTree
+{
+public:
+    CFileTree(void)
+        : mRoot{ NULL }, mGeneration{ 0 }, mScanning{ false } { }
+    ~CFileTree() { }
+
+    void Reload(const std::string& rootPath);
+    void Expand(CFileEntry *dir);
+    void FileChanged(const std::string& path, uint32_t flags);
+
+    CFileEntry *Find(const std::string& path) const;
+    const std::vector<CFileEntry *>& FindByExtension(const char *ext) const;
+    const std::vector<CFileEntry *>& FindByName(const char *name) const;
+
+    INLINE CFileEntry *Root(void) const
+    { return mRoot; }
+    INLINE uint64_t NumEntries(void) const
+    { return mEntries.size(); }
+    INLINE bool IsScanning(void) const
+    { return mScanning; }
+private:
+    std::unordered_map<std::string, std::unique_ptr<CFileEntry>> mEntries; // by path
+    std::unordered_map<std::string, std::vector<CFileEntry *>> mExtIndex; // lowercase extension without the dot
+    std::unordered_map<std::string, std::vector<CFileEntry *>> mNameIndex; // lowercase file name
+    CFileEntry *mRoot;
+    uint32_t mGeneration;
+    bool mScanning;
+
+    CFileEntry *Insert(const std::string& path, bool isDir);
+    void Remove(CFileEntry *entry);
+    void Index(CFileEntry *entry);
+    void Unindex(CFileEntry *entry);
+    void MergeScan(uint32_t generation, std::shared_ptr<std::vector<std::pair<std::string, bool>>> found, uint64_t start,
+        uint64_t scanTime);
+};
+
+#endif
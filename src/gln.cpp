@@ -3,6 +3,7 @@
 #include <zlib.h>
 #include <backtrace.h>
 #include <cxxabi.h> // for demangling C++ symbols
+#include <chrono>
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_MALLOC(size) GetMemory(size)
 #define STBI_REALLOC(p,nsize) GetResizedMemory(p,nsize)
@@ -11,6 +12,10 @@
 
 #ifdef __unix__
 #include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 int parm_compression;
@@ -141,6 +146,180 @@ uint64_t LoadFile(const char *filename, void **buffer)
 	return length;
 }
 
+uint64_t Sys_Microseconds(void)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+Sys_MapFile: maps a whole file in read-only, returns NULL if it can't be opened or is empty. Unlike LoadFile it's
+safe to call from any thread and doesn't error out.
+*/
+const void *Sys_MapFile(const char *path, uint64_t *length)
+{
+#ifdef __unix__
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	*length = st.st_size;
+	return data;
+#else
+	void *data;
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (!fp) {
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	*length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (!*length) {
+		fclose(fp);
+		return NULL;
+	}
+	data = GetMemory(*length);
+	if (fread(data, 1, *length, fp) != *length) {
+		FreeMemory(data);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	return data;
+#endif
+}
+
+void Sys_UnmapFile(const void *data, uint64_t length)
+{
+	if (!data) {
+		return;
+	}
+#ifdef __unix__
+	munmap((void *)data, length);
+#else
+	FreeMemory((void *)data);
+#endif
+}
+
+/*
+Sys_AdviseMapping: tells the system that part of a file from Sys_MapFile is about to be read, or that it won't be
+for a while and its pages can be dropped. Only a hint, it does nothing where files are read in instead.
+*/
+void Sys_AdviseMapping(const void *data, uint64_t length, bool willNeed)
+{
+#ifdef __unix__
+	const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	const uintptr_t start = (uintptr_t)data & ~(page - 1);
+
+	if (!data || !length) {
+		return;
+	}
+	madvise((void *)start, (uintptr_t)data + length - start, willNeed ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+}
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
+
+static INLINE uint64_t Hash_Rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static INLINE uint64_t Hash_Round(uint64_t acc, uint64_t input)
+{
+	acc += input * HASH_PRIME2;
+	acc = Hash_Rotl(acc, 31);
+	return acc * HASH_PRIME1;
+}
+
+static INLINE uint64_t Hash_Merge(uint64_t acc, uint64_t val)
+{
+	acc ^= Hash_Round(0, val);
+	return acc * HASH_PRIME1 + HASH_PRIME4;
+}
+
+/*
+HashData: 64-bit XXH64 of a buffer, four independent lanes over 32 bytes at a time so it runs at memory speed,
+meant for content keys and dedup, not for anything security related
+*/
+uint64_t HashData(const void *data, uint64_t length, uint64_t seed)
+{
+	const byte *p = (const byte *)data;
+	const byte *end = p + length;
+	uint64_t h, k;
+	uint32_t k32;
+
+	if (length >= 32) {
+		uint64_t v1 = seed + HASH_PRIME1 + HASH_PRIME2;
+		uint64_t v2 = seed + HASH_PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - HASH_PRIME1;
+		uint64_t lanes[4];
+
+		do {
+			memcpy(lanes, p, sizeof(lanes));
+			v1 = Hash_Round(v1, lanes[0]);
+			v2 = Hash_Round(v2, lanes[1]);
+			v3 = Hash_Round(v3, lanes[2]);
+			v4 = Hash_Round(v4, lanes[3]);
+			p += 32;
+		} while (p + 32 <= end);
+
+		h = Hash_Rotl(v1, 1) + Hash_Rotl(v2, 7) + Hash_Rotl(v3, 12) + Hash_Rotl(v4, 18);
+		h = Hash_Merge(h, v1);
+		h = Hash_Merge(h, v2);
+		h = Hash_Merge(h, v3);
+		h = Hash_Merge(h, v4);
+	}
+	else {
+		h = seed + HASH_PRIME5;
+	}
+
+	h += length;
+	for (; p + 8 <= end; p += 8) {
+		memcpy(&k, p, sizeof(k));
+		h ^= Hash_Round(0, k);
+		h = Hash_Rotl(h, 27) * HASH_PRIME1 + HASH_PRIME4;
+	}
+	if (p + 4 <= end) {
+		memcpy(&k32, p, sizeof(k32));
+		h ^= (uint64_t)k32 * HASH_PRIME1;
+		h = Hash_Rotl(h, 23) * HASH_PRIME2 + HASH_PRIME3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (*p) * HASH_PRIME5;
+		h = Hash_Rotl(h, 11) * HASH_PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= HASH_PRIME2;
+	h ^= h >> 29;
+	h *= HASH_PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
 uint64_t LittleLong(uint64_t l)
 {
 #ifdef __BIG_ENDIAN__
@@ -192,7 +371,6 @@ float LittleFloat(float f)
 	return out.f;
 }
 
-#ifndef BMFC
 bool LoadJSON(json& data, const std::string& path)
 {
 	FileStream file;
@@ -213,7 +391,6 @@ bool LoadJSON(json& data, const std::string& path)
 	file.Close();
 	return true;
 }
-#endif
 
 void Exit(void)
 {
@@ -356,14 +533,12 @@ static char *Compress_BZIP2(void *buf, uint64_t buflen, uint64_t *outlen)
 	unsigned int len;
 	int ret;
 
-	Printf("Compressing %lu bytes with bzip2...", buflen);
-
-	len = buflen;
-	out = (char *)GetMemory(buflen);
-	ret = BZ2_bzBuffToBuffCompress(out, &len, (char *)buf, buflen, 9, 4, 50);
+	// bzip2's worst case for data that doesn't compress
+	len = buflen + buflen / 100 + 600;
+	out = (char *)GetMemory(len);
+	ret = BZ2_bzBuffToBuffCompress(out, &len, (char *)buf, buflen, 9, 0, 50);
 	CheckBZIP2(ret, buflen, "compression");
 
-	Printf("Successful compression of %lu to %u bytes with zlib", buflen, len);
 	newbuf = (char *)GetMemory(len);
 	memcpy(newbuf, out, len);
 	FreeMemory(out);
@@ -401,10 +576,11 @@ static void zfreeMemory(voidpf opaque, voidpf address)
 static char *Compress_ZLIB(void *buf, uint64_t buflen, uint64_t *outlen)
 {
 	char *out, *newbuf;
-	const uint64_t expectedLen = buflen / 2;
+	uLongf len;
 	int ret;
 
-	out = (char *)GetMemory(buflen);
+	len = compressBound(buflen);
+	out = (char *)GetMemory(len);
 
 #if 0
 	stream.zalloc = zalloc;
@@ -449,13 +625,11 @@ static char *Compress_ZLIB(void *buf, uint64_t buflen, uint64_t *outlen)
 		}
 	} while (ret != Z_STREAM_END);
 #endif
-	Printf("Compressing %lu bytes with zlib", buflen);
-
-	ret = compress2((Bytef *)out, (uLongf *)outlen, (const Bytef *)buf, buflen, Z_BEST_COMPRESSION);
+	ret = compress2((Bytef *)out, &len, (const Bytef *)buf, buflen, Z_BEST_COMPRESSION);
 	if (ret != Z_OK)
 		Error("Failure on compression of %lu bytes. ZLIB error reason:\n\t%s", buflen, zError(ret));
 	
-	Printf("Successful compression of %lu to %lu bytes with zlib", buflen, *outlen);
+	*outlen = len;
 	newbuf = (char *)GetMemory(*outlen);
 	memcpy(newbuf, out, *outlen);
 	FreeMemory(out);
@@ -463,6 +637,138 @@ static char *Compress_ZLIB(void *buf, uint64_t buflen, uint64_t *outlen)
 	return newbuf;
 }
 
+#define COMPRESS_STREAM_CHUNK (64 * 1024)
+
+struct compressStream_s {
+	int compression;
+	compressWrite_t write;
+	uint64_t length; // written so far
+	z_stream zstream;
+	bz_stream bzstream;
+	char out[COMPRESS_STREAM_CHUNK];
+};
+
+/*
+Compress_Run: pushes whatever the compressor has for the input it was given through to the writer, finish ends the
+stream
+*/
+static void Compress_Run(compressStream_t *stream, bool finish)
+{
+	uint64_t length;
+	int ret;
+
+	while (1) {
+		if (stream->compression == COMPRESS_ZLIB) {
+			stream->zstream.next_out = (Bytef *)stream->out;
+			stream->zstream.avail_out = sizeof(stream->out);
+			ret = deflate(&stream->zstream, finish ? Z_FINISH : Z_NO_FLUSH);
+			if (ret == Z_STREAM_ERROR) {
+				Error("Failure on compression stream. ZLIB error reason:\n\t%s", zlib_strerror(ret));
+			}
+			length = sizeof(stream->out) - stream->zstream.avail_out;
+		}
+		else {
+			stream->bzstream.next_out = stream->out;
+			stream->bzstream.avail_out = sizeof(stream->out);
+			ret = BZ2_bzCompress(&stream->bzstream, finish ? BZ_FINISH : BZ_RUN);
+			if (ret < 0) {
+				CheckBZIP2(ret, stream->length, "compression");
+			}
+			length = sizeof(stream->out) - stream->bzstream.avail_out;
+		}
+
+		if (length) {
+			stream->write(stream->out, length);
+			stream->length += length;
+		}
+		if (finish) {
+			if (ret == Z_STREAM_END || (stream->compression == COMPRESS_BZIP2 && ret == BZ_STREAM_END)) {
+				break;
+			}
+		}
+		// done with the input once there's room left over
+		else if (length < sizeof(stream->out)) {
+			break;
+		}
+	}
+}
+
+/*
+Compress_BeginStream: the same settings Compress uses so that the output matches
+*/
+compressStream_t *Compress_BeginStream(int compression, const compressWrite_t& write)
+{
+	compressStream_t *stream;
+	int ret;
+
+	if (compression != COMPRESS_ZLIB && compression != COMPRESS_BZIP2) {
+		Error("Compress_BeginStream: bad compression %i", compression);
+	}
+
+	stream = new compressStream_t;
+	memset(&stream->zstream, 0, sizeof(stream->zstream));
+	memset(&stream->bzstream, 0, sizeof(stream->bzstream));
+	stream->compression = compression;
+	stream->write = write;
+	stream->length = 0;
+
+	if (compression == COMPRESS_ZLIB) {
+		ret = deflateInit(&stream->zstream, Z_BEST_COMPRESSION);
+		if (ret != Z_OK) {
+			Error("Failure on compression stream. ZLIB error reason:\n\t%s", zlib_strerror(ret));
+		}
+	}
+	else {
+		ret = BZ2_bzCompressInit(&stream->bzstream, 9, 0, 50);
+		CheckBZIP2(ret, 0, "compression");
+	}
+
+	return stream;
+}
+
+void Compress_StreamData(compressStream_t *stream, const void *data, uint64_t length)
+{
+	const char *in = (const char *)data;
+	uint32_t chunk;
+
+	// the length fields are 32 bits
+	while (length) {
+		chunk = (uint32_t)std::min<uint64_t>(length, UINT32_MAX);
+		if (stream->compression == COMPRESS_ZLIB) {
+			stream->zstream.next_in = (Bytef *)in;
+			stream->zstream.avail_in = chunk;
+		}
+		else {
+			stream->bzstream.next_in = (char *)in;
+			stream->bzstream.avail_in = chunk;
+		}
+		Compress_Run(stream, false);
+		in += chunk;
+		length -= chunk;
+	}
+}
+
+/*
+Compress_EndStream: flushes the rest of the output and frees the stream, returns how many bytes were written in all
+*/
+uint64_t Compress_EndStream(compressStream_t *stream)
+{
+	uint64_t length;
+
+	Compress_Run(stream, true);
+	if (stream->compression == COMPRESS_ZLIB) {
+		deflateEnd(&stream->zstream);
+	}
+	else {
+		BZ2_bzCompressEnd(&stream->bzstream);
+	}
+
+	length = stream->length;
+	delete stream;
+
+	return length;
+}
+
 char *Compress(void *buf, uint64_t buflen, uint64_t *outlen, int compression)
 {
 	switch (compression) {
@@ -476,19 +782,39 @@ char *Compress(void *buf, uint64_t buflen, uint64_t *outlen, int compression)
 	return (char *)buf;
 }
 
-static char *Decompress_BZIP2(void *buf, uint64_t buflen, uint64_t *outlen)
+/*
+the Decompress functions are given the size the data inflates to in *outlen if it's known, otherwise the output
+buffer is grown until everything fits. They return NULL with the reason in *error if the data is broken or
+doesn't fit in the size it's supposed to inflate to.
+*/
+static char *Decompress_BZIP2(void *buf, uint64_t buflen, uint64_t *outlen, const char **error)
 {
 	char *out, *newbuf;
+	uint64_t size;
 	unsigned int len;
 	int ret;
 
-	Printf("Decompressing %lu bytes with bzip2", buflen);
-	len = buflen * 2;
-	out = (char *)GetMemory(buflen * 2);
-	ret = BZ2_bzBuffToBuffDecompress(out, &len, (char *)buf, buflen, 0, 4);
-	CheckBZIP2(ret, buflen, "decompression");
+	size = *outlen ? *outlen : buflen * 4;
+	while (1) {
+		len = size;
+		out = (char *)GetMemory(size);
+		ret = BZ2_bzBuffToBuffDecompress(out, &len, (char *)buf, buflen, 0, 0);
+		if (ret != BZ_OUTBUFF_FULL || *outlen) {
+			break;
+		}
+		FreeMemory(out);
+		size *= 2;
+	}
+	if (ret != BZ_OK) {
+		FreeMemory(out);
+		*error = bzip2_strerror(ret);
+		return NULL;
+	}
 
-	Printf("Successful decompression of %lu to %u bytes with bzip2", buflen, len);
+	if (len == size) {
+		*outlen = len;
+		return out;
+	}
 	newbuf = (char *)GetMemory(len);
 	memcpy(newbuf, out, len);
 	FreeMemory(out);
@@ -497,39 +823,71 @@ static char *Decompress_BZIP2(void *buf, uint64_t buflen, uint64_t *outlen)
 	return newbuf;
 }
 
-static char *Decompress_ZLIB(void *buf, uint64_t buflen, uint64_t *outlen)
+static char *Decompress_ZLIB(void *buf, uint64_t buflen, uint64_t *outlen, const char **error)
 {
 	char *out, *newbuf;
+	uint64_t size;
+	uLongf len;
 	int ret;
 
-	Printf("Decompressing %lu bytes with zlib...", buflen);
-	out = (char *)GetMemory(buflen * 2);
-	*outlen = buflen * 2;
-	ret = uncompress((Bytef *)out, outlen, (const Bytef *)buf, buflen);
-	if (ret != Z_OK)
-		Error("Failure on decompression of %lu bytes. ZLIB error reason:\n\t:%s", buflen * 2, zError(ret));
-	
-	Printf("Successful decompression of %lu bytes to %lu bytes with zlib", buflen, *outlen);
-	newbuf = (char *)GetMemory(*outlen);
-	memcpy(newbuf, out, *outlen);
+	size = *outlen ? *outlen : buflen * 4;
+	while (1) {
+		len = size;
+		out = (char *)GetMemory(size);
+		ret = uncompress((Bytef *)out, &len, (const Bytef *)buf, buflen);
+		if (ret != Z_BUF_ERROR || *outlen) {
+			break;
+		}
+		FreeMemory(out);
+		size *= 2;
+	}
+	if (ret != Z_OK) {
+		FreeMemory(out);
+		*error = zError(ret);
+		return NULL;
+	}
+
+	if (len == size) {
+		*outlen = len;
+		return out;
+	}
+	newbuf = (char *)GetMemory(len);
+	memcpy(newbuf, out, len);
 	FreeMemory(out);
+	*outlen = len;
 
 	return newbuf;
 }
 
-char *Decompress(void *buf, uint64_t buflen, uint64_t *outlen, int compression)
+/*
+Decompress_Try: Decompress for data that might be broken, NULL with the reason in *error instead of an Error
+*/
+char *Decompress_Try(void *buf, uint64_t buflen, uint64_t *outlen, int compression, const char **error)
 {
 	switch (compression) {
 	case COMPRESS_BZIP2:
-		return Decompress_BZIP2(buf, buflen, outlen);
+		return Decompress_BZIP2(buf, buflen, outlen, error);
 	case COMPRESS_ZLIB:
-		return Decompress_ZLIB(buf, buflen, outlen);
+		return Decompress_ZLIB(buf, buflen, outlen, error);
 	default:
 		break;
 	};
 	return (char *)buf;
 }
 
+char *Decompress(void *buf, uint64_t buflen, uint64_t *outlen, int compression)
+{
+	const char *error;
+	char *out;
+
+	out = Decompress_Try(buf, buflen, outlen, compression, &error);
+	if (!out) {
+		Error("Failure on decompression of %lu bytes. %s error reason:\n\t%s", buflen,
+			compression == COMPRESS_BZIP2 ? "BZIP2" : "ZLIB", error);
+	}
+	return out;
+}
+
 bool IsAbsolutePath(const char *path)
 {
 	return strrchr(path, PATH_SEP) == NULL;
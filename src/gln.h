@@ -85,9 +85,7 @@ public:
     { FreeMemory(p); }
 };
 
-#ifndef BMFC
 #include <nlohmann/json.hpp>
-#endif
 #include "defs.h"
 
 #define PAD(base, alignment) (((base)+(alignment)-1) & ~((alignment)-1))
@@ -100,9 +98,12 @@ void Printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 const char *CurrentDirName(void);
 const char *va(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 uint64_t LoadFile(const char *filename, void **buffer);
-#ifndef BMFC
+uint64_t Sys_Microseconds(void);
+const void *Sys_MapFile(const char *path, uint64_t *length);
+void Sys_UnmapFile(const void *data, uint64_t length);
+void Sys_AdviseMapping(const void *data, uint64_t length, bool willNeed);
+uint64_t HashData(const void *data, uint64_t length, uint64_t seed = 0);
 bool LoadJSON(json& data, const std::string& path);
-#endif
 void Exit(void);
 int GetParm(const char *parm);
 bool N_strcat(char *dest, size_t size, const char *src);
@@ -229,8 +230,20 @@ Editor-specific stuff
 #include "Texture.h"
 #include "tileset.h"
 #include "project.h"
+#include "bench.h"
+#include "watch.h"
+#include "texmem.h"
 #endif
 #include "entity.h"
+#include "profile.h"
+#include "jobs.h"
+#include "image.h"
+#include "imageio.h"
+#include "tile2d.h"
+#include "texcache.h"
+#include "bmf.h"
+#include "lightmap.h"
+#include "nav.h"
 #include "map.h"
 #include "parse.h"
 
@@ -375,6 +388,19 @@ typedef enum {
 } bufferType_t;
 
 char *Compress(void *buf, uint64_t buflen, uint64_t *outlen, int compression = parm_compression);
+// *outlen is the size it decompresses to if that's known and 0 if it isn't
 char *Decompress(void *buf, uint64_t buflen, uint64_t *outlen, int compression = parm_compression);
+char *Decompress_Try(void *buf, uint64_t buflen, uint64_t *outlen, int compression, const char **error);
+
+/*
+compressStream_t: Compress fed a piece at a time for data that isn't in memory all at once, the output goes to
+write as it's made and comes out the same as a Compress of the whole thing
+*/
+typedef struct compressStream_s compressStream_t;
+typedef std::function<void(const void *data, uint64_t length)> compressWrite_t;
+
+compressStream_t *Compress_BeginStream(int compression, const compressWrite_t& write);
+void Compress_StreamData(compressStream_t *stream, const void *data, uint64_t length);
+uint64_t Compress_EndStream(compressStream_t *stream);
 
 #endif
\ No newline at end of file
@@ -15,6 +15,9 @@ GLN_FILES: these definitions must not change in any glnomad extension or project
 // the minimum size in bytes a lump should be before compressing it
 #define COMPRESSED_LUMP_SIZE 2048
 
+// every lump starts on a multiple of this, so that records with 64-bit fields can be read straight out of the file
+#define LUMP_ALIGN 8
+
 #define COMPRESS_NONE 0
 #define COMPRESS_ZLIB 1
 #define COMPRESS_BZIP2 2
@@ -32,9 +35,16 @@ GLN_FILES: these definitions must not change in any glnomad extension or project
 
 typedef struct {
     uint64_t fileofs;
-    uint64_t length;
+    uint64_t length; // bytes stored in the file
+    uint64_t uncompressedLength; // bytes once it's decompressed, the same as length for COMPRESS_NONE
+    uint32_t compression; // each lump is compressed on its own
+    uint32_t flags; // LUMPFLAG_*
 } lump_t;
 
+// LUMP_TILES only holds the tiles that draw or block something, each one is placed by its pos and they're sorted
+// along a Z-order curve of it. A tile that isn't there is empty.
+#define LUMPFLAG_SPARSE 0x0001
+
 #define TEX2D_IDENT (('D'<<16)+('2'<<8)+'T')
 #define TEX2D_VERSION 1
 
@@ -66,7 +76,7 @@ typedef struct {
 } tile2d_sprite_t;
 
 typedef struct {
-    uint32_t numTiles;
+    uint32_t numTiles; // sprites in the list, duplicate and empty tiles of the sheet don't get one
     uint32_t tileWidth;
     uint32_t tileHeight;
     uint32_t tileCountX;
@@ -99,7 +109,7 @@ typedef struct {
 } anim2d_header_t;
 
 #define MAP_IDENT (('#'<<24)+('P'<<16)+('A'<<8)+'M')
-#define MAP_VERSION 1
+#define MAP_VERSION 7
 
 #define MAX_MAP_SPAWNS 1024
 #define MAX_MAP_CHECKPOINTS 256
@@ -118,7 +128,12 @@ typedef struct {
 #define LUMP_VERTICES 4
 #define LUMP_INDICES 5
 #define LUMP_SPRITES 6
-#define NUMLUMPS 7
+#define LUMP_LIGHTMAP 7
+#define LUMP_COLLISION 8
+#define LUMP_NAVIGATION 9
+#define LUMP_SECTORS 10
+#define LUMP_TEXTURE 11
+#define NUMLUMPS 12
 
 typedef enum {
     light_point = 0,
@@ -137,11 +152,19 @@ typedef struct {
     lighttype_t type;
 } maplight_t;
 
+// maptile_t::sides, a non-zero side blocks movement and light, north is towards y - 1
+#define SIDE_NORTH 0
+#define SIDE_EAST 1
+#define SIDE_SOUTH 2
+#define SIDE_WEST 3
+#define SIDE_INSIDE 4 // the whole tile is solid
+#define NUMSIDES 5
+
 typedef struct {
     float texcoords[4][2];
-    byte sides[5]; // for physics
+    byte sides[NUMSIDES]; // for physics
     vec4_t color;
-    uvec3_t pos;
+    uvec3_t pos; // x and y are filled in from the tile's place in the map by the compiler
     int32_t index; // tileset texture index, -1 if not bound
     uint32_t flags;
 } maptile_t;
@@ -152,6 +175,111 @@ typedef struct {
     vec4_t color;
 } mapvert_t;
 
+/*
+mapdrawvert_t: LUMP_VERTICES, the corners of the map's quads in tiles where tile (x, y) covers x to x + 1 and y to
+y + 1. A quad is a rectangle of tiles that draw the same sprite under the same light, uv counts tiles across it so a
+repeating sampler draws the sprite once per tile. LUMP_INDICES has six per quad.
+*/
+typedef struct {
+    vec3_t xyz;
+    vec3_t color; // baked light
+    vec3_t normal;
+    vec2_t uv;
+    float layer; // the sprite's index in LUMP_SPRITES
+} mapdrawvert_t;
+
+/*
+mapcollider_t: LUMP_COLLISION, what the tiles' sides block merged into as few shapes as possible, in the same tile
+space as mapdrawvert_t. A box is a rectangle of tiles that are solid all the way through, an edge is a wall along
+the grid line from mins to maxs left by a row or column of the same side. Edges that a box already covers are left
+out.
+*/
+#define COLLIDER_BOX 0
+#define COLLIDER_EDGE 1
+
+typedef struct {
+    uint32_t type;
+    uint32_t side; // the SIDE_* an edge came from, SIDE_INSIDE for a box
+    uvec2_t mins;
+    uvec2_t maxs;
+} mapcollider_t;
+
+/*
+LUMP_NAVIGATION: an HPA* graph of where things can walk, next to the spawns they start out on. The map is cut into
+clusters of NAV_CLUSTER_SIZE tiles a side and every stretch of a cluster's border that can be crossed gets a node on
+both sides of it. Nodes are joined to the ones across the border and to the ones in their own cluster they can walk
+to, costs are in steps between tiles. Going from one tile to the next is blocked by a solid tile or by a side on
+either of them, the same as light.
+
+Laid out as a mapnavheader_t, clustersX * clustersY + 1 uint32_t offsets of each cluster's first node, the nodes
+sorted by cluster, the edges of every node in the same order and a byte of NAVMOVE_* for every tile, row-major.
+*/
+#define NAV_CLUSTER_SIZE 16
+
+#define NAVMOVE_NORTH 0x01 // one bit per SIDE_* that can be walked through
+#define NAVMOVE_EAST 0x02
+#define NAVMOVE_SOUTH 0x04
+#define NAVMOVE_WEST 0x08
+
+typedef struct {
+    uint32_t clusterSize;
+    uint32_t width; // tiles
+    uint32_t height;
+    uint32_t numNodes;
+    uint32_t numEdges;
+} mapnavheader_t;
+
+typedef struct {
+    uvec2_t pos;
+    uint32_t cluster; // y * clustersX + x of the cluster
+    uint32_t firstEdge;
+    uint32_t numEdges;
+} mapnavnode_t;
+
+typedef struct {
+    uint32_t node;
+    uint32_t cost;
+} mapnavedge_t;
+
+/*
+mapsector_t: LUMP_SECTORS, only there if the level was split into sectors so that it can be streamed in. Each
+sector owns a square of the map and has its own tiles, checkpoints, spawns, lights, vertices and indices lumps,
+those lumps are empty in the main lump table. A sector's tiles are always placed by their pos and its indices count
+from its own first vertex. The other lumps are the same for every sector and stay in the main lump table.
+
+Every sector starts on a BMF_SECTOR_ALIGN boundary of the file and is padded out to one, so it can be paged in and
+dropped on its own.
+*/
+#define BMF_SECTOR_ALIGN 4096
+
+typedef struct {
+    uvec2_t mins; // the tiles it owns
+    uvec2_t maxs;
+    vec2_t boundsMins; // what's in it can reach past them, quads that cross the edge and the range of its lights
+    vec2_t boundsMaxs;
+    uint64_t fileofs;
+    uint64_t length;
+    lump_t lumps[NUMLUMPS]; // the fileofs of each is from the start of the file, not the sector
+} mapsector_t;
+
+/*
+maptexheader_t: LUMP_TEXTURE, only there if the tileset texture was embedded instead of referenced through
+tileset.info.texture. The pixels are already what gets handed to GL, numLevels RGBA8 levels one after another where
+each one is half the size of the last (never below 1) and info describes level 0. Every tile is mipped on its own so
+that the lower levels don't bleed between neighbouring tiles. info.compression is COMPRESS_NONE, the lump is
+compressed as a whole like any other.
+*/
+typedef struct {
+    tex2d_t info;
+    uint32_t numLevels;
+    uint32_t padding;
+} maptexheader_t;
+
+// one per tile, row-major, baked from the static lights
+typedef struct {
+    byte rgba[4];
+} maplightsample_t;
+
 typedef struct {
     char name[MAX_GDR_PATH];
     uint32_t minfilter;
@@ -223,6 +223,9 @@ void InitGLObjects(void)
     glEnableVertexAttribArray(5);
     glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, normal));
 
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, layerCoords));
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
@@ -280,10 +283,19 @@ static void TileModeInfo_f(void)
     Printf("Tile Current Y: %i", tileMode.curY);
 }
 
-Window::Window(void)
+Window::Window(bool headless)
 {
     uint32_t offset, i;
     int width, height, channels;
+    uint32_t windowFlags;
+
+    mHeadless = headless;
+    if (mHeadless) {
+        // SDL's offscreen driver gets its context through EGL, Mesa's software rasterizer
+        // can run that without a display or a gpu
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+    }
 
     if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO) < 0) {
         Error("[Window::Init] SDL_Init failed, reason: %s", SDL_GetError());
@@ -291,10 +303,24 @@ Window::Window(void)
 
     Printf("[Window::Init] Setting up GUI");
 
+    // these only apply to contexts created after they're set
+    SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, !mHeadless);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+
+    windowFlags = SDL_WINDOW_OPENGL;
+    if (mHeadless) {
+        windowFlags |= SDL_WINDOW_HIDDEN;
+    }
+    else {
+        windowFlags |= SDL_WINDOW_MOUSE_CAPTURE;
+    }
+
     mWindowWidth = WINDOW_WIDTH;
     mWindowHeight = WINDOW_HEIGHT;
     mWindow = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_MOUSE_CAPTURE);
+        windowFlags);
     if (!mWindow) {
         Error("[Window::Init] Failed to create SDL2 window, reason: %s", SDL_GetError());
     }
@@ -304,18 +330,17 @@ Window::Window(void)
     }
     SDL_GL_MakeCurrent(mWindow, mContext);
 
-    SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
-    SDL_GL_SetSwapInterval(-1);
+    // don't let vsync throttle the benchmark
+    SDL_GL_SetSwapInterval(mHeadless ? 0 : -1);
 
     // load and set the icon
-    SDL_RWops *rw = SDL_RWFromFile("icon.png", "rb");
-    SDL_Surface *icon = IMG_LoadPNG_RW(rw);
-    SDL_SetWindowIcon(mWindow, icon);
-    SDL_RWclose(rw);
-    SDL_FreeSurface(icon);
+    if (!mHeadless) {
+        SDL_RWops *rw = SDL_RWFromFile("icon.png", "rb");
+        SDL_Surface *icon = IMG_LoadPNG_RW(rw);
+        SDL_SetWindowIcon(mWindow, icon);
+        SDL_RWclose(rw);
+        SDL_FreeSurface(icon);
+    }
 
     Printf("[Window::Init] loading gl procs");
 
@@ -564,14 +589,30 @@ static GLint GetUniform(const std::string& name)
 
 static void DrawMap(void)
 {
+    PROFILE_FUNC();
     uint32_t numVertices, numIndices;
     Vertex *v;
     mapspawn_t *s;
     mapcheckpoint_t *c;
+    bool useLightmap, useTextureArray;
+    vec3_t light;
+    float layerScaleU, layerScaleV;
+    uint32_t layerCountX;
+    const CTileset *tileset;
 
     numVertices = 0;
     numIndices = 0;
 
+    tileset = project->tileset.get();
+    project->tileset->UpdateTextureArray();
+    useTextureArray = tileset->arrayId != 0;
+    if (useTextureArray) {
+        // atlas coordinates to the tile's own [0, 1] range
+        layerScaleU = (float)tileset->texData->mWidth / tileset->arrayTileWidth;
+        layerScaleV = (float)tileset->texData->mHeight / tileset->arrayTileHeight;
+        layerCountX = tileset->texData->mWidth / tileset->arrayTileWidth;
+    }
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -579,7 +620,11 @@ static void DrawMap(void)
     glBindBuffer(GL_ARRAY_BUFFER, vboId);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
 
+    // a baked lightmap replaces the per-pixel lighting
+    useLightmap = mapData->mLightmap.Matches(mapData->mWidth, mapData->mHeight);
+
     glUseProgram(shaderId);
+    glUniform1i(GetUniform("u_UseLightMap"), useLightmap);
     glUniform1i(GetUniform("u_numLights"), mapData->mLights.size());
 
     for (uint32_t i = 0; i < mapData->mLights.size(); ++i) {
@@ -594,14 +639,20 @@ static void DrawMap(void)
     glUniformMatrix4fv(GetUniform("u_ViewProjection"), 1, GL_FALSE, glm::value_ptr(gui->mViewProjection));
     glUniform3f(GetUniform("u_AmbientColor"), mapData->mAmbientColor.r, mapData->mAmbientColor.g, mapData->mAmbientColor.b);
     glUniform1f(GetUniform("u_AmbientIntensity"), mapData->mAmbientIntensity);
-    glUniform1i(GetUniform("u_DiffuseMap"), project->texData->mId);
+    glUniform1i(GetUniform("u_DiffuseMap"), 0);
+    glUniform1i(GetUniform("u_NormalMap"), 1);
+    glUniform1i(GetUniform("u_DiffuseArray"), 2);
+    glUniform1i(GetUniform("u_UseTextureArray"), useTextureArray);
     glUniform1f(GetUniform("u_CameraZoom"), gui->mCameraZoom);
     
     if (project->tileset->normalData->mId != 0) {
-        glUniform1i(GetUniform("u_NormalMap"), project->tileset->normalData->mId);
         glActiveTexture(GL_TEXTURE1);
         project->tileset->normalData->Bind();
     }
+    if (useTextureArray) {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tileset->arrayId);
+    }
 
     glActiveTexture(GL_TEXTURE0);
     project->texData->Bind();
@@ -619,10 +670,25 @@ static void DrawMap(void)
                 numVertices = 0;
                 numIndices = 0;
             }
-   
+
+            const maptile_t *tile = &mapData->mTiles[y * mapData->mWidth + x];
+            if (useLightmap) {
+                mapData->mLightmap.Sample(x, y, light);
+            }
+            // empty tiles have no layer, the sheet is just as transparent there
+            const int32_t layer = useTextureArray && tile->index >= 0 && (uint32_t)tile->index < tileset->arrayRemap.remap.size()
+                ? tileset->arrayRemap.remap[tile->index] : TILE_EMPTY;
             for (uint32_t i = 0; i < 4; i++) {
-                v[i].uv[0] = mapData->mTiles[y * mapData->mWidth + x].texcoords[i][0];
-                v[i].uv[1] = mapData->mTiles[y * mapData->mWidth + x].texcoords[i][1];
+                v[i].uv[0] = tile->texcoords[i][0];
+                v[i].uv[1] = tile->texcoords[i][1];
+                if (layer != TILE_EMPTY) {
+                    v[i].layerCoords.x = v[i].uv[0] * layerScaleU - (tile->index % layerCountX);
+                    v[i].layerCoords.y = v[i].uv[1] * layerScaleV - (tile->index / layerCountX);
+                    v[i].layerCoords.z = layer;
+                }
+                else {
+                    v[i].layerCoords = glm::vec3( 0.0f, 0.0f, -1.0f );
+                }
                 if (mapData->mTiles[y * mapData->mWidth + x].flags & TILE_CHECKPOINT) {
                     v[i].color[0] = 0.0f;
                     v[i].color[1] = 1.0f;
@@ -642,6 +708,12 @@ static void DrawMap(void)
                     v[i].color[3] = 1.0f;
                 }
 
+                if (useLightmap) {
+                    v[i].color[0] *= light[0];
+                    v[i].color[1] *= light[1];
+                    v[i].color[2] *= light[2];
+                }
+
                 if (editor->mode == MODE_TILE && tileMode.curX == x && tileMode.curY == y) {
                     v[i].color[3] = 0.0f;
                 }
@@ -670,6 +742,11 @@ static void DrawMap(void)
         project->tileset->normalData->Unbind();
         glActiveTexture(GL_TEXTURE0);
     }
+    if (useTextureArray) {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -679,6 +756,7 @@ static void DrawMap(void)
 
 void Window::BeginFrame(void)
 {
+    PROFILE_SCOPE("Window::BeginFrame");
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -725,6 +803,7 @@ static void PollCommands(const char *input)
 
 void Window::EndFrame(void)
 {
+    PROFILE_SCOPE("Window::EndFrame");
     if (editor->mConsoleActive) {
         const ImVec2 windowSize = ImGui::GetWindowSize();
         const ImVec2 windowPos = ImGui::GetWindowPos();
@@ -746,12 +825,19 @@ void Window::EndFrame(void)
         ImGui::SetWindowSize(windowSize);
         ImGui::SetWindowPos(windowPos);
     }
-    PollEvents();
-
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-    SDL_GL_SwapWindow(mWindow);
+    {
+        PROFILE_SCOPE("PollEvents");
+        PollEvents();
+    }
+    {
+        PROFILE_SCOPE("ImGui::Render");
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+    {
+        PROFILE_SCOPE("SDL_GL_SwapWindow");
+        SDL_GL_SwapWindow(mWindow);
+    }
 }
 
 void VertexCache::ClearAttribs(void)
@@ -17,12 +17,13 @@ struct Vertex
     glm::vec3 normal;
     glm::vec2 uv;
     glm::vec2 worldPos;
+    glm::vec3 layerCoords; // uv inside the tile and its layer in the tileset array, negative layer if it has no texture
 };
 
 class Window
 {
 public:
-    Window(void);
+    Window(bool headless = false);
     ~Window();
 
     static void Print(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
@@ -33,6 +34,7 @@ public:
 
     SDL_Window *mWindow;
     SDL_GLContext mContext;
+    bool mHeadless; // rendering offscreen for the benchmark, nothing is shown
     void *iconBuf;
 
     Vertex *mVertices;
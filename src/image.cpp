@@ -0,0 +1,500 @@
+#include "gln.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+Image_NumMips: the amount of levels in a full mip chain down to 1x1
+*/
+uint32_t Image_NumMips(uint32_t width, uint32_t height)
+{
+    uint32_t numMips;
+
+    numMips = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+        numMips++;
+    }
+    return numMips;
+}
+
+/*
+Image_DownsampleGeneric: 2x2 box filter for any size, an odd last row or column gets reused by the texel past it
+*/
+static void Image_DownsampleGeneric(const byte *in, uint32_t width, uint32_t height, byte *out)
+{
+    const uint32_t outWidth = width > 1 ? width >> 1 : 1;
+    const uint32_t outHeight = height > 1 ? height >> 1 : 1;
+
+    for (uint32_t y = 0; y < outHeight; y++) {
+        const byte *row0 = in + (uint64_t)std::min(y * 2, height - 1) * width * 4;
+        const byte *row1 = in + (uint64_t)std::min(y * 2 + 1, height - 1) * width * 4;
+
+        for (uint32_t x = 0; x < outWidth; x++) {
+            const uint32_t x0 = std::min(x * 2, width - 1) * 4;
+            const uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+
+            for (uint32_t c = 0; c < 4; c++) {
+                *out++ = (byte)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+/*
+Image_Downsample: halves an RGBA8 image with a 2x2 box filter, even sized images go through SSE2 two
+output texels at a time
+*/
+void Image_Downsample(const byte *in, uint32_t width, uint32_t height, byte *out)
+{
+#if defined(__SSE2__)
+    if ((width & 1) || (height & 1)) {
+        Image_DownsampleGeneric(in, width, height, out);
+        return;
+    }
+
+    const uint32_t outWidth = width >> 1;
+    const uint32_t outHeight = height >> 1;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+
+    for (uint32_t y = 0; y < outHeight; y++) {
+        const byte *row0 = in + (uint64_t)y * 2 * width * 4;
+        const byte *row1 = row0 + (uint64_t)width * 4;
+        byte *dst = out + (uint64_t)y * outWidth * 4;
+        uint32_t x;
+
+        for (x = 0; x + 2 <= outWidth; x += 2) {
+            // 4 source texels from each row make 2 output texels
+            const __m128i a = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+            const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            const __m128i sumLo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            const __m128i sumHi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            const __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sumLo, sumHi), round), 2);
+
+            _mm_storel_epi64((__m128i *)(dst + x * 4), _mm_packus_epi16(sum, zero));
+        }
+        for (; x < outWidth; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                dst[x * 4 + c] = (byte)((row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c] + 2) >> 2);
+            }
+        }
+    }
+#else
+    Image_DownsampleGeneric(in, width, height, out);
+#endif
+}
+
+/*
+Image_SplitTiles: cuts a sheet into tileWidth x tileHeight layers, row by row starting from the top left,
+RGB sheets are expanded to RGBA. Leftover pixels on the right and bottom that don't make up a tile are dropped.
+*/
+void Image_SplitTiles(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, CImageArray *out)
+{
+    const uint32_t tileCountX = tileWidth ? sheetWidth / tileWidth : 0;
+    const uint32_t tileCountY = tileHeight ? sheetHeight / tileHeight : 0;
+
+    if (channels != 3 && channels != 4) {
+        Error("Image_SplitTiles: unsupported channel count %u", channels);
+    }
+
+    out->mLayers = tileCountX * tileCountY;
+    out->mLevels.resize(1);
+    out->mLevels[0].width = tileWidth;
+    out->mLevels[0].height = tileHeight;
+    out->mLevels[0].pixels.resize((uint64_t)tileWidth * tileHeight * 4 * out->mLayers);
+
+    Job_ParallelFor(out->mLayers, JOB_MIN_GRAIN, [&](uint32_t start, uint32_t end) {
+        for (uint32_t i = start; i < end; i++) {
+            const uint32_t originX = (i % tileCountX) * tileWidth;
+            const uint32_t originY = (i / tileCountX) * tileHeight;
+            byte *dst = out->Layer(0, i);
+
+            for (uint32_t y = 0; y < tileHeight; y++) {
+                const byte *src = sheet + ((uint64_t)(originY + y) * sheetWidth + originX) * channels;
+
+                if (channels == 4) {
+                    memcpy(dst, src, tileWidth * 4);
+                    dst += tileWidth * 4;
+                    continue;
+                }
+                for (uint32_t x = 0; x < tileWidth; x++) {
+                    *dst++ = *src++;
+                    *dst++ = *src++;
+                    *dst++ = *src++;
+                    *dst++ = 255;
+                }
+            }
+        }
+    });
+}
+
+/*
+Image_GenerateMips: fills in every level below the first, each layer's chain is built on its own by the job system
+*/
+void Image_GenerateMips(CImageArray *array)
+{
+    PROFILE_FUNC();
+    const uint32_t numMips = Image_NumMips(array->mLevels[0].width, array->mLevels[0].height);
+
+    array->mLevels.resize(numMips);
+    for (uint32_t i = 1; i < numMips; i++) {
+        const imageLevel_t *prev = &array->mLevels[i - 1];
+
+        array->mLevels[i].width = prev->width > 1 ? prev->width >> 1 : 1;
+        array->mLevels[i].height = prev->height > 1 ? prev->height >> 1 : 1;
+        array->mLevels[i].pixels.resize(array->LayerSize(i) * array->mLayers);
+    }
+
+    Job_ParallelFor(array->mLayers, JOB_MIN_GRAIN, [array, numMips](uint32_t start, uint32_t end) {
+        for (uint32_t layer = start; layer < end; layer++) {
+            for (uint32_t i = 1; i < numMips; i++) {
+                Image_Downsample(array->Layer(i - 1, layer), array->mLevels[i - 1].width, array->mLevels[i - 1].height,
+                    array->Layer(i, layer));
+            }
+        }
+    });
+}
+
+/*
+Image_MipSheet: a mip chain of a whole tile sheet where every tile is mipped on its own, so the lower levels don't
+bleed between neighbouring tiles. Level 0 is the sheet as RGBA8 and each level after it is half the size of the last
+with every tile's own mip placed where the tile is, the chain stops once the tiles are 1x1. The leftover pixels that
+don't make up a tile are only kept in level 0.
+*/
+void Image_MipSheet(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, std::vector<imageLevel_t>& out)
+{
+    PROFILE_FUNC();
+    const uint32_t tileCountX = tileWidth ? sheetWidth / tileWidth : 0;
+    const uint64_t numPixels = (uint64_t)sheetWidth * sheetHeight;
+    CImageArray tiles;
+
+    if (!tileCountX || !tileHeight || tileHeight > sheetHeight) {
+        Error("Image_MipSheet: %ux%u tiles don't fit in a %ux%u sheet", tileWidth, tileHeight, sheetWidth, sheetHeight);
+    }
+    Image_SplitTiles(sheet, sheetWidth, sheetHeight, channels, tileWidth, tileHeight, &tiles);
+    Image_GenerateMips(&tiles);
+
+    out.resize(tiles.mLevels.size());
+    out[0].width = sheetWidth;
+    out[0].height = sheetHeight;
+    out[0].pixels.resize(numPixels * 4);
+    if (channels == 4) {
+        memcpy(out[0].pixels.data(), sheet, numPixels * 4);
+    }
+    else {
+        for (uint64_t i = 0; i < numPixels; i++) {
+            out[0].pixels[i * 4 + 0] = sheet[i * 3 + 0];
+            out[0].pixels[i * 4 + 1] = sheet[i * 3 + 1];
+            out[0].pixels[i * 4 + 2] = sheet[i * 3 + 2];
+            out[0].pixels[i * 4 + 3] = 255;
+        }
+    }
+
+    for (uint32_t i = 1; i < out.size(); i++) {
+        const uint32_t width = tiles.mLevels[i].width;
+        const uint32_t height = tiles.mLevels[i].height;
+        imageLevel_t *level = &out[i];
+
+        level->width = out[i - 1].width > 1 ? out[i - 1].width >> 1 : 1;
+        level->height = out[i - 1].height > 1 ? out[i - 1].height >> 1 : 1;
+        level->pixels.assign((uint64_t)level->width * level->height * 4, 0);
+
+        // once one side of the tiles is down to a texel the sheet can get narrower than a row of them
+        for (uint32_t tile = 0; tile < tiles.mLayers; tile++) {
+            const uint32_t x = (tile % tileCountX) * width;
+            const uint32_t y = (tile / tileCountX) * height;
+            const byte *src = tiles.Layer(i, tile);
+
+            if (x >= level->width || y >= level->height) {
+                continue;
+            }
+            for (uint32_t row = 0; row < std::min(height, level->height - y); row++) {
+                memcpy(level->pixels.data() + ((uint64_t)(y + row) * level->width + x) * 4, src + (uint64_t)row * width * 4,
+                    std::min(width, level->width - x) * 4);
+            }
+        }
+    }
+}
+
+void Image_IdentityRemap(uint32_t numTiles, tileRemap_t *out)
+{
+    out->unique.resize(numTiles);
+    out->remap.resize(numTiles);
+    for (uint32_t i = 0; i < numTiles; i++) {
+        out->unique[i] = i;
+        out->remap[i] = i;
+    }
+    out->numDuplicates = 0;
+    out->numEmpty = 0;
+}
+
+#define TILEHASH_PRIME1 0x9E3779B1U
+#define TILEHASH_PRIME2 0x85EBCA77U
+
+#if defined(__SSE2__)
+// SSE2 doesn't have a 32-bit low multiply, the even and odd lanes are done separately and put back together
+static INLINE __m128i Image_Mul32(__m128i a, __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+/*
+Image_HashTile: hashes a tile's rows 16 bytes at a time into four 32-bit lanes, it only has to spread tiles out
+well enough that the exact compare rarely runs for nothing. Also reports whether every pixel has zero alpha.
+*/
+static uint64_t Image_HashTile(const byte *tile, uint64_t stride, uint32_t rowBytes, uint32_t numRows, uint32_t channels,
+    bool *empty)
+{
+    uint32_t lanes[4];
+    uint32_t alpha, x;
+    uint64_t h;
+
+    alpha = 0;
+#if defined(__SSE2__)
+    const __m128i prime1 = _mm_set1_epi32(TILEHASH_PRIME1);
+    const __m128i prime2 = _mm_set1_epi32(TILEHASH_PRIME2);
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    __m128i acc = _mm_set_epi32(0, TILEHASH_PRIME2, TILEHASH_PRIME1, rowBytes * numRows);
+    __m128i alphaBits = _mm_setzero_si128();
+
+    for (uint32_t y = 0; y < numRows; y++) {
+        const byte *row = tile + y * stride;
+
+        for (x = 0; x + 16 <= rowBytes; x += 16) {
+            const __m128i data = _mm_loadu_si128((const __m128i *)(row + x));
+
+            acc = Image_Mul32(_mm_add_epi32(acc, Image_Mul32(data, prime2)), prime1);
+            acc = _mm_or_si128(_mm_slli_epi32(acc, 13), _mm_srli_epi32(acc, 19));
+            alphaBits = _mm_or_si128(alphaBits, _mm_and_si128(data, alphaMask));
+        }
+        for (; x < rowBytes; x++) {
+            acc = _mm_xor_si128(acc, _mm_cvtsi32_si128(row[x]));
+            acc = Image_Mul32(acc, prime1);
+            if (channels == 4 && (x & 3) == 3) {
+                alpha |= row[x];
+            }
+        }
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    {
+        uint32_t bits[4];
+
+        _mm_storeu_si128((__m128i *)bits, alphaBits);
+        alpha |= bits[0] | bits[1] | bits[2] | bits[3];
+    }
+#else
+    lanes[0] = rowBytes * numRows;
+    lanes[1] = TILEHASH_PRIME1;
+    lanes[2] = TILEHASH_PRIME2;
+    lanes[3] = 0;
+    for (uint32_t y = 0; y < numRows; y++) {
+        const byte *row = tile + y * stride;
+
+        for (x = 0; x < rowBytes; x++) {
+            uint32_t *lane = &lanes[(x >> 2) & 3];
+
+            *lane = (*lane ^ row[x]) * TILEHASH_PRIME1;
+            *lane = (*lane << 13) | (*lane >> 19);
+            if (channels == 4 && (x & 3) == 3) {
+                alpha |= row[x];
+            }
+        }
+    }
+#endif
+
+    *empty = channels == 4 && !alpha;
+
+    h = ((uint64_t)lanes[0] << 32 | lanes[1]) ^ (((uint64_t)lanes[2] << 32 | lanes[3]) * 0xC2B2AE3D27D4EB4FULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+Image_DedupTiles: hashes every tile of the sheet on the job system, then goes through them in order and compares
+the ones that hash the same byte for byte, so a hash collision can never merge two different tiles
+*/
+void Image_DedupTiles(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, tileRemap_t *out)
+{
+    PROFILE_FUNC();
+    const uint32_t tileCountX = tileWidth ? sheetWidth / tileWidth : 0;
+    const uint32_t tileCountY = tileHeight ? sheetHeight / tileHeight : 0;
+    const uint32_t numTiles = tileCountX * tileCountY;
+    const uint64_t stride = (uint64_t)sheetWidth * channels;
+    const uint32_t rowBytes = tileWidth * channels;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+    std::vector<uint64_t> hashes(numTiles);
+    std::vector<byte> empty(numTiles);
+
+    const auto tileData = [=](uint32_t index) {
+        return sheet + (uint64_t)(index / tileCountX) * tileHeight * stride + (uint64_t)(index % tileCountX) * rowBytes;
+    };
+    const auto tilesEqual = [&](uint32_t a, uint32_t b) {
+        const byte *pa = tileData(a), *pb = tileData(b);
+
+        for (uint32_t y = 0; y < tileHeight; y++) {
+            if (memcmp(pa + y * stride, pb + y * stride, rowBytes)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    Job_ParallelFor(numTiles, JOB_MIN_GRAIN, [&](uint32_t start, uint32_t end) {
+        for (uint32_t i = start; i < end; i++) {
+            bool isEmpty;
+
+            hashes[i] = Image_HashTile(tileData(i), stride, rowBytes, tileHeight, channels, &isEmpty);
+            empty[i] = isEmpty;
+        }
+    });
+
+    out->unique.clear();
+    out->remap.resize(numTiles);
+    out->numDuplicates = 0;
+    out->numEmpty = 0;
+    for (uint32_t i = 0; i < numTiles; i++) {
+        if (empty[i]) {
+            out->remap[i] = TILE_EMPTY;
+            out->numEmpty++;
+            continue;
+        }
+
+        std::vector<uint32_t>& bucket = buckets[hashes[i]];
+        out->remap[i] = -2;
+        for (const auto& it : bucket) {
+            if (tilesEqual(it, i)) {
+                out->remap[i] = out->remap[it];
+                out->numDuplicates++;
+                break;
+            }
+        }
+        if (out->remap[i] == -2) {
+            out->remap[i] = out->unique.size();
+            out->unique.emplace_back(i);
+            bucket.emplace_back(i);
+        }
+    }
+}
+
+/*
+Image_CheckTexel: what the generated sheet holds at (x, y) of tile, hashed so that the 2x2 sums land on every
+remainder and a wrong rounding shows up
+*/
+static INLINE byte Image_CheckTexel(uint32_t tile, uint32_t x, uint32_t y, uint32_t c)
+{
+    uint32_t h = x * 0x9e3779b1 + y * 0x85ebca77 + tile * 0xc2b2ae3d + c * 0x27d4eb2f;
+
+    h ^= h >> 15;
+    return (byte)((h * 0x2c1b3c6d) >> 24);
+}
+
+/*
+Image_Check: splits and mips generated sheets, as RGB and RGBA and with an even and an odd tile size so that both
+downsample paths run, then compares every texel against a plain 2x2 box filter of the level above. Doesn't need GL,
+bmfc runs it with --imagecheck.
+*/
+bool Image_Check(void)
+{
+    const uint32_t tileSizes[][2] = { { 16, 16 }, { 6, 5 } };
+    const uint32_t tileCountX = 3, tileCountY = 2;
+    std::vector<byte> sheet, expected, next;
+    CImageArray array;
+
+    for (const auto& size : tileSizes) {
+        const uint32_t tileWidth = size[0], tileHeight = size[1];
+        const uint32_t sheetWidth = tileCountX * tileWidth + 5; // leftovers that have to be dropped
+        const uint32_t sheetHeight = tileCountY * tileHeight + 3;
+
+        for (uint32_t channels = 3; channels <= 4; channels++) {
+            uint64_t numChecked = 0;
+
+            sheet.assign((uint64_t)sheetWidth * sheetHeight * channels, 0xee);
+            for (uint32_t y = 0; y < tileCountY * tileHeight; y++) {
+                for (uint32_t x = 0; x < tileCountX * tileWidth; x++) {
+                    const uint32_t tile = (y / tileHeight) * tileCountX + x / tileWidth;
+
+                    for (uint32_t c = 0; c < channels; c++) {
+                        sheet[((uint64_t)y * sheetWidth + x) * channels + c] = Image_CheckTexel(tile, x % tileWidth,
+                            y % tileHeight, c);
+                    }
+                }
+            }
+
+            Image_SplitTiles(sheet.data(), sheetWidth, sheetHeight, channels, tileWidth, tileHeight, &array);
+            Image_GenerateMips(&array);
+            if (array.mLayers != tileCountX * tileCountY || array.mLevels.size() != Image_NumMips(tileWidth, tileHeight)) {
+                Printf("Image_Check: %ux%u tiles with %u channels came out as %u layers and %lu levels", tileWidth,
+                    tileHeight, channels, array.mLayers, array.mLevels.size());
+                return false;
+            }
+
+            for (uint32_t layer = 0; layer < array.mLayers; layer++) {
+                uint32_t width = tileWidth, height = tileHeight;
+
+                expected.resize((uint64_t)width * height * 4);
+                for (uint32_t y = 0; y < height; y++) {
+                    for (uint32_t x = 0; x < width; x++) {
+                        for (uint32_t c = 0; c < 4; c++) {
+                            expected[((uint64_t)y * width + x) * 4 + c] = c < channels ? Image_CheckTexel(layer, x, y, c) : 255;
+                        }
+                    }
+                }
+
+                for (uint32_t level = 0; level < array.mLevels.size(); level++) {
+                    if (array.mLevels[level].width != width || array.mLevels[level].height != height) {
+                        Printf("Image_Check: level %u is %ux%u, expected %ux%u", level, array.mLevels[level].width,
+                            array.mLevels[level].height, width, height);
+                        return false;
+                    }
+                    for (uint64_t i = 0; i < expected.size(); i++) {
+                        if (array.Layer(level, layer)[i] != expected[i]) {
+                            Printf("Image_Check: %ux%u tiles with %u channels, level %u layer %u texel (%lu, %lu) channel %lu "
+                                "is %u, expected %u", tileWidth, tileHeight, channels, level, layer, (i / 4) % width,
+                                (i / 4) / width, i % 4, array.Layer(level, layer)[i], expected[i]);
+                            return false;
+                        }
+                    }
+                    numChecked += expected.size() / 4;
+
+                    // the level below, an odd last row or column is paired with itself
+                    const uint32_t nextWidth = width > 1 ? width >> 1 : 1;
+                    const uint32_t nextHeight = height > 1 ? height >> 1 : 1;
+
+                    next.resize((uint64_t)nextWidth * nextHeight * 4);
+                    for (uint32_t y = 0; y < nextHeight; y++) {
+                        for (uint32_t x = 0; x < nextWidth; x++) {
+                            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                            const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+                            for (uint32_t c = 0; c < 4; c++) {
+                                next[((uint64_t)y * nextWidth + x) * 4 + c] = (byte)((expected[((uint64_t)y0 * width + x0) * 4 + c]
+                                    + expected[((uint64_t)y0 * width + x1) * 4 + c] + expected[((uint64_t)y1 * width + x0) * 4 + c]
+                                    + expected[((uint64_t)y1 * width + x1) * 4 + c] + 2) >> 2);
+                            }
+                        }
+                    }
+                    expected.swap(next);
+                    width = nextWidth;
+                    height = nextHeight;
+                }
+            }
+            Printf("Image_Check: %ux%u tiles with %u channels, %u layers, %lu levels, %lu texels match", tileWidth,
+                tileHeight, channels, array.mLayers, array.mLevels.size(), numChecked);
+        }
+    }
+
+    return true;
+}
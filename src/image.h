@@ -0,0 +1,63 @@
+#ifndef __IMAGE__
+#define __IMAGE__
+
+#pragma once
+
+/*
+image processing that doesn't touch GL, so that it can be shared with the compiler and run without a context
+*/
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    std::vector<byte> pixels; // RGBA8, every layer at this size one after another
+} imageLevel_t;
+
+/*
+CImageArray: a stack of equally sized RGBA8 images along with their mip chains, level 0 is full size
+*/
+class CImageArray
+{
+public:
+    std::vector<imageLevel_t> mLevels;
+    uint32_t mLayers;
+
+    CImageArray(void)
+        : mLayers{ 0 }
+    { }
+    ~CImageArray() { }
+
+    INLINE uint64_t LayerSize(uint32_t level) const
+    { return (uint64_t)mLevels[level].width * mLevels[level].height * 4; }
+    INLINE byte *Layer(uint32_t level, uint32_t layer)
+    { return mLevels[level].pixels.data() + LayerSize(level) * layer; }
+    INLINE const byte *Layer(uint32_t level, uint32_t layer) const
+    { return mLevels[level].pixels.data() + LayerSize(level) * layer; }
+};
+
+#define TILE_EMPTY -1
+
+/*
+tileRemap_t: which tiles of a sheet are worth keeping. Copies of an earlier tile and fully transparent tiles are
+dropped, remap takes a sheet index to its position in unique.
+*/
+typedef struct {
+    std::vector<uint32_t> unique; // sheet index of every kept tile, in sheet order
+    std::vector<int32_t> remap; // sheet index -> index into unique, TILE_EMPTY if there's nothing to draw
+    uint32_t numDuplicates;
+    uint32_t numEmpty;
+} tileRemap_t;
+
+uint32_t Image_NumMips(uint32_t width, uint32_t height);
+void Image_Downsample(const byte *in, uint32_t width, uint32_t height, byte *out);
+void Image_SplitTiles(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, CImageArray *out);
+void Image_GenerateMips(CImageArray *array);
+void Image_MipSheet(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, std::vector<imageLevel_t>& out);
+void Image_IdentityRemap(uint32_t numTiles, tileRemap_t *out);
+void Image_DedupTiles(const byte *sheet, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t channels,
+    uint32_t tileWidth, uint32_t tileHeight, tileRemap_t *out);
+bool Image_Check(void);
+
+#endif
@@ -0,0 +1,537 @@
+#include "gln.h"
+#include "stb_image.h"
+
+/*
+QOI, the "Quite OK Image" format: a byte oriented run/index/delta coding of RGB(A) pixels that decodes an order of
+magnitude faster than png while staying close to it in size, see https://qoiformat.org/qoi-specification.pdf
+*/
+
+#define QOI_MAGIC (('q'<<24)|('o'<<16)|('i'<<8)|'f')
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_PIXELS 400000000U
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK_2 0xc0
+
+typedef union {
+    struct {
+        byte r, g, b, a;
+    } rgba;
+    uint32_t v;
+} qoiPixel_t;
+
+static const byte qoiPadding[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static INLINE uint32_t QOI_Hash(qoiPixel_t px)
+{
+    return (px.rgba.r * 3 + px.rgba.g * 5 + px.rgba.b * 7 + px.rgba.a * 11) & 63;
+}
+
+static INLINE void QOI_Write32(byte *out, uint64_t *p, uint32_t v)
+{
+    out[(*p)++] = (v >> 24) & 0xff;
+    out[(*p)++] = (v >> 16) & 0xff;
+    out[(*p)++] = (v >> 8) & 0xff;
+    out[(*p)++] = v & 0xff;
+}
+
+static INLINE uint32_t QOI_Read32(const byte *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+/*
+QOI_Encode: returns the encoded file in a buffer allocated with GetMemory, the pixels are stored as sRGB
+*/
+byte *QOI_Encode(const byte *pixels, uint32_t width, uint32_t height, uint32_t channels, uint64_t *length)
+{
+    PROFILE_FUNC();
+    qoiPixel_t index[64];
+    qoiPixel_t px, prev;
+    uint64_t p, numPixels;
+    uint32_t run;
+    byte *out;
+
+    if (!width || !height || (channels != 3 && channels != 4) || (uint64_t)width * height >= QOI_MAX_PIXELS) {
+        return NULL;
+    }
+
+    numPixels = (uint64_t)width * height;
+    out = (byte *)GetMemory(QOI_HEADER_SIZE + numPixels * (channels + 1) + QOI_PADDING_SIZE);
+
+    p = 0;
+    QOI_Write32(out, &p, QOI_MAGIC);
+    QOI_Write32(out, &p, width);
+    QOI_Write32(out, &p, height);
+    out[p++] = channels;
+    out[p++] = 0; // sRGB with linear alpha
+
+    memset(index, 0, sizeof(index));
+    run = 0;
+    prev.v = 0;
+    prev.rgba.a = 255;
+    px = prev;
+
+    for (uint64_t i = 0; i < numPixels; i++) {
+        const byte *src = pixels + i * channels;
+
+        px.rgba.r = src[0];
+        px.rgba.g = src[1];
+        px.rgba.b = src[2];
+        if (channels == 4) {
+            px.rgba.a = src[3];
+        }
+
+        if (px.v == prev.v) {
+            run++;
+            if (run == 62 || i == numPixels - 1) {
+                out[p++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run) {
+            out[p++] = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        const uint32_t hash = QOI_Hash(px);
+        if (index[hash].v == px.v) {
+            out[p++] = QOI_OP_INDEX | hash;
+        }
+        else {
+            index[hash] = px;
+
+            if (px.rgba.a == prev.rgba.a) {
+                const int8_t vr = px.rgba.r - prev.rgba.r;
+                const int8_t vg = px.rgba.g - prev.rgba.g;
+                const int8_t vb = px.rgba.b - prev.rgba.b;
+                const int8_t vgr = vr - vg;
+                const int8_t vgb = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                }
+                else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    out[p++] = QOI_OP_LUMA | (vg + 32);
+                    out[p++] = (vgr + 8) << 4 | (vgb + 8);
+                }
+                else {
+                    out[p++] = QOI_OP_RGB;
+                    out[p++] = px.rgba.r;
+                    out[p++] = px.rgba.g;
+                    out[p++] = px.rgba.b;
+                }
+            }
+            else {
+                out[p++] = QOI_OP_RGBA;
+                out[p++] = px.rgba.r;
+                out[p++] = px.rgba.g;
+                out[p++] = px.rgba.b;
+                out[p++] = px.rgba.a;
+            }
+        }
+        prev = px;
+    }
+
+    memcpy(out + p, qoiPadding, sizeof(qoiPadding));
+    p += sizeof(qoiPadding);
+
+    *length = p;
+    return out;
+}
+
+/*
+QOI_Decode: the pixels come out with the channel count the file was written with
+*/
+byte *QOI_Decode(const byte *buf, uint64_t length, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error)
+{
+    PROFILE_FUNC();
+    qoiPixel_t index[64];
+    qoiPixel_t px;
+    uint64_t p, chunksEnd, size;
+    uint32_t w, h, c, run;
+    byte *pixels, *dst;
+
+    if (length < QOI_HEADER_SIZE + QOI_PADDING_SIZE || QOI_Read32(buf) != QOI_MAGIC) {
+        *error = "not a qoi file";
+        return NULL;
+    }
+    w = QOI_Read32(buf + 4);
+    h = QOI_Read32(buf + 8);
+    c = buf[12];
+    if (!w || !h || (c != 3 && c != 4) || buf[13] > 1 || (uint64_t)w * h >= QOI_MAX_PIXELS) {
+        *error = "corrupt qoi header";
+        return NULL;
+    }
+
+    size = (uint64_t)w * h * c;
+    pixels = (byte *)GetMemory(size);
+
+    memset(index, 0, sizeof(index));
+    px.v = 0;
+    px.rgba.a = 255;
+    run = 0;
+    p = QOI_HEADER_SIZE;
+    chunksEnd = length - QOI_PADDING_SIZE;
+
+    for (dst = pixels; dst < pixels + size; dst += c) {
+        if (run) {
+            run--;
+        }
+        else if (p < chunksEnd) {
+            const uint32_t b1 = buf[p++];
+
+            if (b1 == QOI_OP_RGB) {
+                px.rgba.r = buf[p++];
+                px.rgba.g = buf[p++];
+                px.rgba.b = buf[p++];
+            }
+            else if (b1 == QOI_OP_RGBA) {
+                px.rgba.r = buf[p++];
+                px.rgba.g = buf[p++];
+                px.rgba.b = buf[p++];
+                px.rgba.a = buf[p++];
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = index[b1];
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                px.rgba.r += ((b1 >> 4) & 3) - 2;
+                px.rgba.g += ((b1 >> 2) & 3) - 2;
+                px.rgba.b += (b1 & 3) - 2;
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                const uint32_t b2 = buf[p++];
+                const int vg = (b1 & 0x3f) - 32;
+
+                px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.rgba.g += vg;
+                px.rgba.b += vg - 8 + (b2 & 0x0f);
+            }
+            else {
+                run = b1 & 0x3f;
+            }
+
+            index[QOI_Hash(px)] = px;
+        }
+
+        // a truncated file just repeats the last pixel, the padding is always there to read past
+        dst[0] = px.rgba.r;
+        dst[1] = px.rgba.g;
+        dst[2] = px.rgba.b;
+        if (c == 4) {
+            dst[3] = px.rgba.a;
+        }
+    }
+
+    *width = w;
+    *height = h;
+    *channels = c;
+    return pixels;
+}
+
+static bool QOI_Match(const byte *buf, uint64_t length)
+{
+    return length >= QOI_HEADER_SIZE && QOI_Read32(buf) == QOI_MAGIC;
+}
+
+/*
+stb_image takes everything else it knows, greyscale images are expanded so that everything is RGB(A)
+*/
+static bool STB_Match(const byte *buf, uint64_t length)
+{
+    int width, height, channels;
+
+    return length <= INT32_MAX && stbi_info_from_memory(buf, length, &width, &height, &channels);
+}
+
+static byte *STB_Decode(const byte *buf, uint64_t length, uint32_t *width, uint32_t *height, uint32_t *channels,
+    const char **error)
+{
+    PROFILE_FUNC();
+    int w, h, c;
+    byte *pixels;
+
+    if (length > INT32_MAX || !stbi_info_from_memory(buf, length, &w, &h, &c)) {
+        *error = length > INT32_MAX ? "file too large" : stbi_failure_reason();
+        return NULL;
+    }
+
+    // GL_RED/GL_RG would sample differently than the editor expects
+    pixels = stbi_load_from_memory(buf, length, &w, &h, &c, c == 3 || c == 4 ? 0 : 4);
+    if (!pixels) {
+        *error = stbi_failure_reason();
+        return NULL;
+    }
+
+    *width = w;
+    *height = h;
+    *channels = c == 3 || c == 4 ? c : 4;
+    return pixels;
+}
+
+/*
+Image_LoadRGBA: the old path based entry point of the plugin table, always RGBA
+*/
+static void Image_LoadRGBA(const char *name, byte **pic, uint32_t *width, uint32_t *height)
+{
+    uint32_t channels;
+    const char *error;
+    byte *pixels, *out;
+
+    *pic = NULL;
+    pixels = Image_LoadFile(name, width, height, &channels, &error);
+    if (!pixels || channels == 4) {
+        *pic = pixels;
+        return;
+    }
+
+    out = (byte *)GetMemory((uint64_t)*width * *height * 4);
+    for (uint64_t i = 0; i < (uint64_t)*width * *height; i++) {
+        out[i * 4 + 0] = pixels[i * 3 + 0];
+        out[i * 4 + 1] = pixels[i * 3 + 1];
+        out[i * 4 + 2] = pixels[i * 3 + 2];
+        out[i * 4 + 3] = 255;
+    }
+    FreeMemory(pixels);
+    *pic = out;
+}
+
+static const _ERPlugImageTable qoiTable = {
+    sizeof(_ERPlugImageTable),
+    Image_LoadRGBA,
+    "qoi",
+    ".qoi",
+    QOI_Match,
+    QOI_Decode,
+    QOI_Encode
+};
+
+static const _ERPlugImageTable stbTable = {
+    sizeof(_ERPlugImageTable),
+    Image_LoadRGBA,
+    "stb_image",
+    ".png .bmp .jpg .jpeg .tga .psd .gif .hdr .pic .pnm .ppm .pgm",
+    STB_Match,
+    STB_Decode,
+    NULL
+};
+
+/*
+registered codecs are only added at startup, before anything is loaded on the workers, so lookups don't lock
+*/
+static const _ERPlugImageTable *imageCodecs[IMAGE_MAX_CODECS] = { &qoiTable, &stbTable };
+static uint32_t numImageCodecs = 2;
+
+#define IMAGE_TABLE_HAS(table, field) ((table)->m_nSize >= offsetof(_ERPlugImageTable, field) + sizeof((table)->field) \
+    && (table)->field)
+
+/*
+Image_RegisterCodec: adds a decoder ahead of stb_image, which would otherwise claim its files
+*/
+bool Image_RegisterCodec(const _ERPlugImageTable *table)
+{
+    if (numImageCodecs >= IMAGE_MAX_CODECS) {
+        Printf("Image_RegisterCodec: too many image codecs, '%s' not registered", table->m_pszName);
+        return false;
+    }
+    if (!IMAGE_TABLE_HAS(table, m_pfnMatchImage) || !IMAGE_TABLE_HAS(table, m_pfnDecodeImage)) {
+        Printf("Image_RegisterCodec: image plugin table is missing its decoder");
+        return false;
+    }
+
+    imageCodecs[numImageCodecs] = imageCodecs[numImageCodecs - 1];
+    imageCodecs[numImageCodecs - 1] = table;
+    numImageCodecs++;
+
+    return true;
+}
+
+const _ERPlugImageTable *Image_FindCodec(const byte *buf, uint64_t length)
+{
+    for (uint32_t i = 0; i < numImageCodecs; i++) {
+        if (imageCodecs[i]->m_pfnMatchImage(buf, length)) {
+            return imageCodecs[i];
+        }
+    }
+    return NULL;
+}
+
+const _ERPlugImageTable *Image_CodecForExtension(const char *ext)
+{
+    const char *tok;
+    uint64_t len;
+
+    if (*ext == '.') {
+        ext++;
+    }
+    len = strlen(ext);
+    if (!len) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < numImageCodecs; i++) {
+        const _ERPlugImageTable *table = imageCodecs[i];
+
+        if (!IMAGE_TABLE_HAS(table, m_pszExtensions)) {
+            continue;
+        }
+        for (tok = table->m_pszExtensions; (tok = strchr(tok, '.')) != NULL; tok++) {
+            if (!N_stricmpn(tok + 1, ext, len) && (tok[len + 1] == ' ' || !tok[len + 1])) {
+                return table;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+Image_Decode: picks the decoder by the file's signature rather than its name
+*/
+byte *Image_Decode(const byte *buf, uint64_t length, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error)
+{
+    const _ERPlugImageTable *table;
+
+    table = Image_FindCodec(buf, length);
+    if (!table) {
+        *error = "unknown image format";
+        return NULL;
+    }
+    return table->m_pfnDecodeImage(buf, length, width, height, channels, error);
+}
+
+byte *Image_LoadFile(const char *path, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error)
+{
+    const byte *buf;
+    uint64_t length;
+    byte *pixels;
+
+    buf = (const byte *)Sys_MapFile(path, &length);
+    if (!buf) {
+        *error = "failed to open file";
+        return NULL;
+    }
+    pixels = Image_Decode(buf, length, width, height, channels, error);
+    Sys_UnmapFile(buf, length);
+
+    return pixels;
+}
+
+/*
+Image_SaveFile: writes the pixels in the format the path's extension names
+*/
+bool Image_SaveFile(const char *path, const byte *pixels, uint32_t width, uint32_t height, uint32_t channels)
+{
+    const _ERPlugImageTable *table;
+    uint64_t length;
+    byte *out;
+    FILE *fp;
+    bool ok;
+
+    table = Image_CodecForExtension(GetExtension(path));
+    if (!table || !IMAGE_TABLE_HAS(table, m_pfnEncodeImage)) {
+        Printf("Image_SaveFile: no encoder for '%s'", path);
+        return false;
+    }
+
+    out = table->m_pfnEncodeImage(pixels, width, height, channels, &length);
+    if (!out) {
+        Printf("Image_SaveFile: %s can't encode a %ux%u image with %u channels", table->m_pszName, width, height, channels);
+        return false;
+    }
+
+    fp = fopen(path, "wb");
+    ok = fp && fwrite(out, length, 1, fp) == 1;
+    ok = fp && !fclose(fp) && ok;
+    FreeMemory(out);
+
+    if (!ok) {
+        Printf("Image_SaveFile: failed to write '%s'", path);
+    }
+    return ok;
+}
+
+static double Image_BenchDecode(const _ERPlugImageTable *table, const byte *buf, uint64_t length, uint32_t iterations)
+{
+    uint32_t width, height, channels;
+    const char *error;
+    uint64_t start, best;
+    byte *pixels;
+
+    best = UINT64_MAX;
+    for (uint32_t i = 0; i < iterations; i++) {
+        start = Sys_Microseconds();
+        pixels = table->m_pfnDecodeImage(buf, length, &width, &height, &channels, &error);
+        best = std::min(best, Sys_Microseconds() - start);
+        if (!pixels) {
+            return 0.0;
+        }
+        FreeMemory(pixels);
+    }
+    return best / 1000.0;
+}
+
+/*
+Image_Benchmark: decodes every file with the codec that claims it, then reencodes it as QOI and decodes that, the
+best of iterations runs is reported for both
+*/
+void Image_Benchmark(const char **paths, uint32_t numPaths, uint32_t iterations)
+{
+    uint32_t width, height, channels;
+    const _ERPlugImageTable *table;
+    double sourceTime, qoiTime, totalSource, totalQOI, megapixels;
+    uint64_t length, qoiLength;
+    const char *error;
+    const byte *buf;
+    byte *pixels, *qoi;
+
+    totalSource = totalQOI = megapixels = 0.0;
+    for (uint32_t i = 0; i < numPaths; i++) {
+        buf = (const byte *)Sys_MapFile(paths[i], &length);
+        if (!buf) {
+            Printf("Image_Benchmark: failed to open '%s'", paths[i]);
+            continue;
+        }
+        table = Image_FindCodec(buf, length);
+        pixels = table ? table->m_pfnDecodeImage(buf, length, &width, &height, &channels, &error) : NULL;
+        if (!pixels) {
+            Printf("Image_Benchmark: failed to decode '%s', %s", paths[i], table ? error : "unknown image format");
+            Sys_UnmapFile(buf, length);
+            continue;
+        }
+
+        qoiLength = 0;
+        qoi = QOI_Encode(pixels, width, height, channels, &qoiLength);
+        FreeMemory(pixels);
+
+        sourceTime = Image_BenchDecode(table, buf, length, iterations);
+        qoiTime = qoi ? Image_BenchDecode(&qoiTable, qoi, qoiLength, iterations) : 0.0;
+        Sys_UnmapFile(buf, length);
+        if (qoi) {
+            FreeMemory(qoi);
+        }
+
+        Printf("Image_Benchmark: '%s' %ux%ux%u", paths[i], width, height, channels);
+        Printf("  %-10s %10lu bytes, %8.3f ms, %8.1f MP/s", table->m_pszName, length, sourceTime,
+            sourceTime > 0.0 ? width * height / 1000.0 / sourceTime : 0.0);
+        Printf("  %-10s %10lu bytes, %8.3f ms, %8.1f MP/s", "qoi", qoiLength, qoiTime,
+            qoiTime > 0.0 ? width * height / 1000.0 / qoiTime : 0.0);
+
+        totalSource += sourceTime;
+        totalQOI += qoiTime;
+        megapixels += width * height / 1000000.0;
+    }
+
+    if (totalSource > 0.0 && totalQOI > 0.0) {
+        Printf("Image_Benchmark: %.2f MP in %.3f ms as they are, %.3f ms as qoi (%.1fx)", megapixels, totalSource, totalQOI,
+            totalSource / totalQOI);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef __IMAGEIO__
+#define __IMAGEIO__
+
+#pragma once
+
+#include "iimage.h"
+
+/*
+image file formats, every decoder is an _ERPlugImageTable and files are handed to the first one that recognizes
+their signature. QOI and stb_image are built in, stb_image goes last since it takes anything it can read.
+*/
+
+#define IMAGE_MAX_CODECS 16
+#define IMAGE_BENCH_ITERATIONS 8
+
+bool Image_RegisterCodec(const _ERPlugImageTable *table);
+const _ERPlugImageTable *Image_FindCodec(const byte *buf, uint64_t length);
+const _ERPlugImageTable *Image_CodecForExtension(const char *ext);
+byte *Image_Decode(const byte *buf, uint64_t length, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error);
+byte *Image_LoadFile(const char *path, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error);
+bool Image_SaveFile(const char *path, const byte *pixels, uint32_t width, uint32_t height, uint32_t channels);
+void Image_Benchmark(const char **paths, uint32_t numPaths, uint32_t iterations = IMAGE_BENCH_ITERATIONS);
+
+byte *QOI_Encode(const byte *pixels, uint32_t width, uint32_t height, uint32_t channels, uint64_t *length);
+byte *QOI_Decode(const byte *buf, uint64_t length, uint32_t *width, uint32_t *height, uint32_t *channels, const char **error);
+
+#endif
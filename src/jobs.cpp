@@ -0,0 +1,201 @@
+#include "gln.h"
+
+/*
+Job_NumWorkers: returns the amount of threads the job system will split work between
+*/
+uint32_t Job_NumWorkers(void)
+{
+    static uint32_t numWorkers;
+
+    if (!numWorkers) {
+        numWorkers = boost::thread::hardware_concurrency();
+        if (!numWorkers) {
+            numWorkers = 1;
+        }
+    }
+    return numWorkers;
+}
+
+// set on threads that are already one of a group doing the same work, see Job_SetSerial
+static thread_local bool jobSerial;
+
+/*
+Job_SetSerial: while it's set Job_ParallelFor runs everything on the calling thread, for threads that are already
+one of a pool so that each of them doesn't start a group of its own on top
+*/
+void Job_SetSerial(bool serial)
+{
+    jobSerial = serial;
+}
+
+/*
+Job_ParallelFor: splits [0, count) into contiguous ranges and runs func over them on a group of worker threads,
+returns once every range has been processed. Small workloads are run on the calling thread.
+*/
+void Job_ParallelFor(uint32_t count, uint32_t grain, const jobrange_t& func)
+{
+    uint32_t numJobs, perJob;
+
+    if (!count) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    numJobs = (count + grain - 1) / grain;
+    if (numJobs > Job_NumWorkers()) {
+        numJobs = Job_NumWorkers();
+    }
+    if (numJobs <= 1 || jobSerial) {
+        PROFILE_SCOPE("Job");
+        func(0, count);
+        return;
+    }
+
+    perJob = (count + numJobs - 1) / numJobs;
+
+    {
+        boost::thread_group group;
+
+        for (uint32_t start = perJob; start < count; start += perJob) {
+            const uint32_t end = start + perJob < count ? start + perJob : count;
+            group.create_thread([&func, start, end, perJob](void) {
+                char name[64];
+
+                snprintf(name, sizeof(name), "Job Worker %u", start / perJob);
+                Profile_SetThreadName(name);
+
+                PROFILE_SCOPE("Job");
+                func(start, end);
+            });
+        }
+
+        // the calling thread takes the first range instead of idling
+        {
+            PROFILE_SCOPE("Job");
+            func(0, perJob);
+        }
+
+        group.join_all();
+    }
+}
+
+/*
+jobQueue_t: work handed off to the async workers and the results they hand back to the main thread. It's never
+freed so that workers still waiting on it at exit don't touch a destroyed mutex.
+*/
+typedef struct {
+    boost::mutex lock;
+    boost::condition_variable wake;
+    boost::condition_variable idle;
+    std::deque<jobfunc_t> pending;
+    std::vector<jobfunc_t> completed;
+    uint32_t numBusy;
+    bool started;
+} jobQueue_t;
+
+static jobQueue_t *asyncQueue = new jobQueue_t{};
+
+static void Job_AsyncWorker(uint32_t index)
+{
+    char name[64];
+    jobfunc_t func;
+
+    snprintf(name, sizeof(name), "Async Worker %u", index);
+    Profile_SetThreadName(name);
+
+    while (1) {
+        {
+            boost::unique_lock<boost::mutex> lock{ asyncQueue->lock };
+
+            while (asyncQueue->pending.empty()) {
+                asyncQueue->wake.wait(lock);
+            }
+            func = std::move(asyncQueue->pending.front());
+            asyncQueue->pending.pop_front();
+            asyncQueue->numBusy++;
+        }
+
+        func();
+        func = nullptr;
+
+        {
+            boost::lock_guard<boost::mutex> lock{ asyncQueue->lock };
+            if (!--asyncQueue->numBusy && asyncQueue->pending.empty()) {
+                asyncQueue->idle.notify_all();
+            }
+        }
+    }
+}
+
+/*
+Job_Async: runs func on one of the persistent async workers and returns right away, anything that has to touch
+GL or editor state should be passed back with Job_QueueMain
+*/
+void Job_Async(const jobfunc_t& func)
+{
+    boost::lock_guard<boost::mutex> lock{ asyncQueue->lock };
+
+    if (!asyncQueue->started) {
+        for (uint32_t i = 0; i < JOB_ASYNC_WORKERS; i++) {
+            boost::thread(Job_AsyncWorker, i).detach();
+        }
+        asyncQueue->started = true;
+    }
+    asyncQueue->pending.emplace_back(func);
+    asyncQueue->wake.notify_one();
+}
+
+/*
+Job_QueueMain: func is run by the main thread at the start of its next frame, can be called from any thread
+*/
+void Job_QueueMain(const jobfunc_t& func)
+{
+    boost::lock_guard<boost::mutex> lock{ asyncQueue->lock };
+    asyncQueue->completed.emplace_back(func);
+}
+
+/*
+Job_RunMainQueue: runs everything that was queued for the main thread, only called from the main thread
+*/
+void Job_RunMainQueue(void)
+{
+    std::vector<jobfunc_t> completed;
+
+    {
+        boost::lock_guard<boost::mutex> lock{ asyncQueue->lock };
+        if (asyncQueue->completed.empty()) {
+            return;
+        }
+        completed.swap(asyncQueue->completed);
+    }
+
+    PROFILE_SCOPE("Job_RunMainQueue");
+    for (auto& it : completed) {
+        it();
+    }
+}
+
+/*
+Job_Flush: blocks until the async workers are out of work and everything they queued up has been run
+*/
+void Job_Flush(void)
+{
+    PROFILE_FUNC();
+
+    while (1) {
+        {
+            boost::unique_lock<boost::mutex> lock{ asyncQueue->lock };
+
+            while (asyncQueue->numBusy || !asyncQueue->pending.empty()) {
+                asyncQueue->idle.wait(lock);
+            }
+            if (asyncQueue->completed.empty()) {
+                return;
+            }
+        }
+        // the main thread's callbacks might queue up more work
+        Job_RunMainQueue();
+    }
+}
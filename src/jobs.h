@@ -0,0 +1,27 @@
+#ifndef __JOBS__
+#define __JOBS__
+
+#pragma once
+
+#include <functional>
+#include <deque>
+
+// the smallest amount of work items a single worker will be handed by Job_ParallelFor
+#define JOB_MIN_GRAIN 16
+
+// the amount of persistent threads that Job_Async hands work to
+#define JOB_ASYNC_WORKERS 2
+
+typedef std::function<void(uint32_t start, uint32_t end)> jobrange_t;
+typedef std::function<void(void)> jobfunc_t;
+
+uint32_t Job_NumWorkers(void);
+void Job_ParallelFor(uint32_t count, uint32_t grain, const jobrange_t& func);
+void Job_SetSerial(bool serial);
+
+void Job_Async(const jobfunc_t& func);
+void Job_QueueMain(const jobfunc_t& func);
+void Job_RunMainQueue(void);
+void Job_Flush(void);
+
+#endif
@@ -0,0 +1,526 @@
+#include "gln.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void CLightmap::Clear(void)
+{
+    mRed.clear();
+    mGreen.clear();
+    mBlue.clear();
+    mRecords.clear();
+    mMasks.clear();
+    mCells.clear();
+    mCellsX = 0;
+    mCellsY = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mValid = false;
+}
+
+void CLightmap::Resize(uint32_t width, uint32_t height)
+{
+    const uint64_t numTiles = (uint64_t)width * height;
+
+    mWidth = width;
+    mHeight = height;
+    mRed.resize(numTiles);
+    mGreen.resize(numTiles);
+    mBlue.resize(numTiles);
+
+    mCellsX = (width + LIGHTMAP_CELL_SIZE - 1) / LIGHTMAP_CELL_SIZE;
+    mCellsY = (height + LIGHTMAP_CELL_SIZE - 1) / LIGHTMAP_CELL_SIZE;
+    mCells.clear();
+    mCells.resize(mCellsX * mCellsY);
+
+    mDirty[0] = mDirty[1] = INT32_MAX;
+    mDirty[2] = mDirty[3] = -1;
+    mValid = false;
+}
+
+/*
+CLightmap::Quantize: converts the baked values into the 8-bit samples stored in the lightmap lump
+*/
+void CLightmap::Quantize(maplightsample_t *out) const
+{
+    const uint64_t numTiles = (uint64_t)mWidth * mHeight;
+
+    for (uint64_t i = 0; i < numTiles; i++) {
+        out[i].rgba[0] = (byte)(clamp(mRed[i], 0.0f, 1.0f) * 255.0f);
+        out[i].rgba[1] = (byte)(clamp(mGreen[i], 0.0f, 1.0f) * 255.0f);
+        out[i].rgba[2] = (byte)(clamp(mBlue[i], 0.0f, 1.0f) * 255.0f);
+        out[i].rgba[3] = 255;
+    }
+}
+
+static void Lightmap_MakeRecord(const maplight_t *light, int32_t width, int32_t height, lightRecord_t *record)
+{
+    const float scale = light->brightness * light->color[3];
+
+    memset(record, 0, sizeof(*record));
+    if (light->range <= 0.0f) {
+        record->maxX = record->maxY = -1; // can't reach anything
+        return;
+    }
+
+    record->x = (float)light->origin[0];
+    record->y = (float)light->origin[1];
+    record->invRange = 1.0f / light->range;
+    record->r = light->color[0] * scale;
+    record->g = light->color[1] * scale;
+    record->b = light->color[2] * scale;
+    record->minX = clamp((int32_t)floorf(record->x - light->range), 0, width - 1);
+    record->maxX = clamp((int32_t)ceilf(record->x + light->range), 0, width - 1);
+    record->minY = clamp((int32_t)floorf(record->y - light->range), 0, height - 1);
+    record->maxY = clamp((int32_t)ceilf(record->y + light->range), 0, height - 1);
+}
+
+/*
+Lightmap_LinkRecord: adds or removes a light from every index cell its bounds overlap
+*/
+static void Lightmap_LinkRecord(CLightmap *lightmap, uint32_t index, bool link)
+{
+    const lightRecord_t *record = &lightmap->mRecords[index];
+
+    if (record->maxX < record->minX) {
+        return;
+    }
+    for (int32_t cy = record->minY / LIGHTMAP_CELL_SIZE; cy <= record->maxY / LIGHTMAP_CELL_SIZE; cy++) {
+        for (int32_t cx = record->minX / LIGHTMAP_CELL_SIZE; cx <= record->maxX / LIGHTMAP_CELL_SIZE; cx++) {
+            std::vector<uint32_t>& cell = lightmap->mCells[cy * lightmap->mCellsX + cx];
+
+            if (link) {
+                cell.emplace_back(index);
+            }
+            else {
+                const auto it = std::find(cell.begin(), cell.end(), index);
+
+                if (it == cell.end()) {
+                    Error("Lightmap_LinkRecord: light %u isn't in cell (%i, %i)", index, cx, cy);
+                }
+                cell.erase(it);
+            }
+        }
+    }
+}
+
+static INLINE const byte *Lightmap_Sides(const lightSides_t *grid, int32_t x, int32_t y)
+{
+    return grid->sides + ((uint64_t)y * grid->width + x) * grid->stride;
+}
+
+static INLINE bool Lightmap_Solid(const lightSides_t *grid, int32_t x, int32_t y)
+{
+    return Lightmap_Sides(grid, x, y)[SIDE_INSIDE];
+}
+
+/*
+Lightmap_StepOpen: checks if light can pass from tile (x, y) to its neighbour (x + sx, y + sy), only one of sx and sy
+can be non-zero. The edge counts as solid if either of the tiles sharing it says so.
+*/
+static INLINE bool Lightmap_StepOpen(const lightSides_t *grid, int32_t x, int32_t y, int32_t sx, int32_t sy)
+{
+    const byte *from = Lightmap_Sides(grid, x, y);
+    const byte *to = Lightmap_Sides(grid, x + sx, y + sy);
+
+    if (sx > 0) {
+        return !from[SIDE_EAST] && !to[SIDE_WEST];
+    }
+    else if (sx < 0) {
+        return !from[SIDE_WEST] && !to[SIDE_EAST];
+    }
+    else if (sy > 0) {
+        return !from[SIDE_SOUTH] && !to[SIDE_NORTH];
+    }
+    return !from[SIDE_NORTH] && !to[SIDE_SOUTH];
+}
+
+/*
+Lightmap_MapSides: the sides of the map's own tiles
+*/
+static void Lightmap_MapSides(const CMapData *data, lightSides_t *grid)
+{
+    grid->sides = (const byte *)data->mTiles.data() + offsetof(maptile_t, sides);
+    grid->stride = sizeof(maptile_t);
+    grid->width = data->mWidth;
+    grid->height = data->mHeight;
+}
+
+/*
+Lightmap_CastRay: walks every tile the line from the light's tile to (tx, ty) passes through, marking them as
+visible until it hits a solid edge or tile. Solid tiles are lit themselves but stop the ray.
+*/
+static void Lightmap_CastRay(const lightSides_t *grid, const lightRecord_t *l, lightMask_t *mask, int32_t tx, int32_t ty)
+{
+    int32_t x = clamp((int32_t)l->x, l->minX, l->maxX); // the editor lets lights sit on the map's far edge
+    int32_t y = clamp((int32_t)l->y, l->minY, l->maxY);
+    const int32_t nx = abs(tx - x);
+    const int32_t ny = abs(ty - y);
+    const int32_t sx = tx > x ? 1 : -1;
+    const int32_t sy = ty > y ? 1 : -1;
+    int32_t ix, iy;
+    int64_t decision;
+    uint32_t bit;
+
+    for (ix = 0, iy = 0; ; ) {
+        bit = x - l->minX;
+        mask->bits[(uint64_t)(y - l->minY) * mask->stride + (bit >> 6)] |= 1ULL << (bit & 63);
+
+        if ((ix >= nx && iy >= ny) || Lightmap_Solid(grid, x, y)) {
+            break;
+        }
+
+        decision = (int64_t)(1 + 2 * ix) * ny - (int64_t)(1 + 2 * iy) * nx;
+        if (decision == 0) {
+            // passing exactly through a corner, open if either way around it is
+            if (!(Lightmap_StepOpen(grid, x, y, sx, 0) && !Lightmap_Solid(grid, x + sx, y) && Lightmap_StepOpen(grid, x + sx, y, 0, sy))
+                && !(Lightmap_StepOpen(grid, x, y, 0, sy) && !Lightmap_Solid(grid, x, y + sy) && Lightmap_StepOpen(grid, x, y + sy, sx, 0))) {
+                break;
+            }
+            x += sx;
+            y += sy;
+            ix++;
+            iy++;
+        }
+        else if (decision < 0) {
+            if (!Lightmap_StepOpen(grid, x, y, sx, 0)) {
+                break;
+            }
+            x += sx;
+            ix++;
+        }
+        else {
+            if (!Lightmap_StepOpen(grid, x, y, 0, sy)) {
+                break;
+            }
+            y += sy;
+            iy++;
+        }
+    }
+}
+
+/*
+Lightmap_CastShadows: computes the light's visibility mask by casting a ray to every tile on the border of its bounds,
+each tile inside them is crossed by at least one of the rays
+*/
+static void Lightmap_CastShadows(const lightSides_t *grid, const lightRecord_t *l, lightMask_t *mask)
+{
+    PROFILE_FUNC();
+    mask->bits.clear();
+    mask->stride = 0;
+    if (l->maxX < l->minX) {
+        return;
+    }
+
+    mask->stride = (l->maxX - l->minX + 1 + 63) / 64;
+    mask->bits.resize((uint64_t)mask->stride * (l->maxY - l->minY + 1));
+
+    for (int32_t x = l->minX; x <= l->maxX; x++) {
+        Lightmap_CastRay(grid, l, mask, x, l->minY);
+        Lightmap_CastRay(grid, l, mask, x, l->maxY);
+    }
+    for (int32_t y = l->minY + 1; y < l->maxY; y++) {
+        Lightmap_CastRay(grid, l, mask, l->minX, y);
+        Lightmap_CastRay(grid, l, mask, l->maxX, y);
+    }
+}
+
+/*
+Lightmap_MaskBits: fetches the 4 visibility bits starting at the given one, they can straddle two words
+*/
+static INLINE uint32_t Lightmap_MaskBits(const uint64_t *row, uint32_t bit)
+{
+    const uint32_t shift = bit & 63;
+    uint64_t bits;
+
+    bits = row[bit >> 6] >> shift;
+    if (shift > 60) {
+        bits |= row[(bit >> 6) + 1] << (64 - shift);
+    }
+    return (uint32_t)bits & 0xf;
+}
+
+/*
+Lightmap_AccumulateSpan: adds the contribution of a single light scaled by scale to the tiles [x0, x1] of row y
+that the light can see, the attenuation is linear over the light's range, same as the editor's shader
+*/
+static void Lightmap_AccumulateSpan(float *r, float *g, float *b, int32_t x0, int32_t x1, int32_t y,
+    const lightRecord_t *l, const lightMask_t *mask, float scale)
+{
+    const float dy = (float)y - l->y;
+    const float dy2 = dy * dy;
+    const float cr = l->r * scale;
+    const float cg = l->g * scale;
+    const float cb = l->b * scale;
+    const uint64_t *row = &mask->bits[(uint64_t)(y - l->minY) * mask->stride];
+    int32_t x;
+
+    x = x0;
+#if defined(__SSE2__)
+    const __m128 vStep = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 vOriginX = _mm_set1_ps(l->x);
+    const __m128 vDY2 = _mm_set1_ps(dy2);
+    const __m128 vInvRange = _mm_set1_ps(l->invRange);
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vR = _mm_set1_ps(cr);
+    const __m128 vG = _mm_set1_ps(cg);
+    const __m128 vB = _mm_set1_ps(cb);
+    const __m128i vLaneBits = _mm_set_epi32(8, 4, 2, 1);
+
+    for (; x + 3 <= x1; x += 4) {
+        const uint32_t bits = Lightmap_MaskBits(row, x - l->minX);
+
+        if (!bits) {
+            continue; // all 4 in shadow
+        }
+
+        const __m128 visible = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), vLaneBits), vLaneBits));
+        const __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)x), vStep), vOriginX);
+        const __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), vDY2));
+        const __m128 atten = _mm_and_ps(_mm_max_ps(_mm_sub_ps(vOne, _mm_mul_ps(dist, vInvRange)), vZero), visible);
+
+        _mm_storeu_ps(r + x, _mm_add_ps(_mm_loadu_ps(r + x), _mm_mul_ps(atten, vR)));
+        _mm_storeu_ps(g + x, _mm_add_ps(_mm_loadu_ps(g + x), _mm_mul_ps(atten, vG)));
+        _mm_storeu_ps(b + x, _mm_add_ps(_mm_loadu_ps(b + x), _mm_mul_ps(atten, vB)));
+    }
+#endif
+    for (; x <= x1; x++) {
+        const uint32_t bit = x - l->minX;
+        const float dx = (float)x - l->x;
+        float atten;
+
+        if (!(row[bit >> 6] & (1ULL << (bit & 63)))) {
+            continue;
+        }
+        atten = 1.0f - sqrtf(dx * dx + dy2) * l->invRange;
+        if (atten <= 0.0f) {
+            continue;
+        }
+        r[x] += atten * cr;
+        g[x] += atten * cg;
+        b[x] += atten * cb;
+    }
+}
+
+/*
+Lightmap_RelightRows: recomputes the tiles [x0, x1] of rows [y0, y1] from scratch, only the lights
+indexed in the cells the region overlaps are looked at. Work is split between the job system's workers by tile rows.
+*/
+static void Lightmap_RelightRows(CLightmap *lightmap, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+    const uint32_t width = lightmap->mWidth;
+
+    Job_ParallelFor(y1 - y0 + 1, JOB_MIN_GRAIN, [&](uint32_t startRow, uint32_t endRow) {
+        for (int32_t y = y0 + startRow; y < y0 + (int32_t)endRow; y++) {
+            float *r = &lightmap->mRed[(uint64_t)y * width];
+            float *g = &lightmap->mGreen[(uint64_t)y * width];
+            float *b = &lightmap->mBlue[(uint64_t)y * width];
+            const std::vector<uint32_t> *cells = &lightmap->mCells[(y / LIGHTMAP_CELL_SIZE) * lightmap->mCellsX];
+
+            for (int32_t x = x0; x <= x1; x++) {
+                r[x] = lightmap->mAmbient[0];
+                g[x] = lightmap->mAmbient[1];
+                b[x] = lightmap->mAmbient[2];
+            }
+
+            // a light overlapping several cells is clipped to each of them, so every tile sees it once
+            for (int32_t cx = x0 / LIGHTMAP_CELL_SIZE; cx <= x1 / LIGHTMAP_CELL_SIZE; cx++) {
+                const int32_t cellMinX = std::max(cx * LIGHTMAP_CELL_SIZE, x0);
+                const int32_t cellMaxX = std::min(cx * LIGHTMAP_CELL_SIZE + LIGHTMAP_CELL_SIZE - 1, x1);
+
+                for (const auto& i : cells[cx]) {
+                    const lightRecord_t *l = &lightmap->mRecords[i];
+
+                    if (y < l->minY || y > l->maxY) {
+                        continue;
+                    }
+                    Lightmap_AccumulateSpan(r, g, b, std::max(l->minX, cellMinX), std::min(l->maxX, cellMaxX), y, l,
+                        &lightmap->mMasks[i], 1.0f);
+                }
+            }
+        }
+    });
+}
+
+/*
+Lightmap_AddRecord: adds (or with a scale of -1, removes) a single light's contribution over its bounds
+*/
+static void Lightmap_AddRecord(CLightmap *lightmap, uint32_t index, float scale)
+{
+    const uint32_t width = lightmap->mWidth;
+    const lightRecord_t *l = &lightmap->mRecords[index];
+    const lightMask_t *mask = &lightmap->mMasks[index];
+
+    if (l->maxX < l->minX) {
+        return;
+    }
+
+    Job_ParallelFor(l->maxY - l->minY + 1, JOB_MIN_GRAIN, [&](uint32_t startRow, uint32_t endRow) {
+        for (int32_t y = l->minY + startRow; y < l->minY + (int32_t)endRow; y++) {
+            Lightmap_AccumulateSpan(&lightmap->mRed[(uint64_t)y * width], &lightmap->mGreen[(uint64_t)y * width],
+                &lightmap->mBlue[(uint64_t)y * width], l->minX, l->maxX, y, l, mask, scale);
+        }
+    });
+
+    lightmap->mDirty[0] = std::min(lightmap->mDirty[0], l->minX);
+    lightmap->mDirty[1] = std::min(lightmap->mDirty[1], l->minY);
+    lightmap->mDirty[2] = std::max(lightmap->mDirty[2], l->maxX);
+    lightmap->mDirty[3] = std::max(lightmap->mDirty[3], l->maxY);
+}
+
+/*
+Lightmap_BakeSides: computes the light value of every tile in the grid from the ambient term and the static lights,
+it only needs to know where the solid tiles and edges are
+*/
+void Lightmap_BakeSides(const lightSides_t *grid, const maplight_t *lights, uint32_t numLights, const float *ambient,
+    CLightmap *lightmap)
+{
+    PROFILE_FUNC();
+    uint64_t start;
+    const uint32_t width = grid->width;
+    const uint32_t height = grid->height;
+
+    start = Sys_Microseconds();
+
+    lightmap->Resize(width, height);
+    lightmap->mAmbient[0] = ambient[0];
+    lightmap->mAmbient[1] = ambient[1];
+    lightmap->mAmbient[2] = ambient[2];
+
+    lightmap->mRecords.resize(numLights);
+    lightmap->mMasks.resize(numLights);
+    for (uint32_t i = 0; i < lightmap->mRecords.size(); i++) {
+        Lightmap_MakeRecord(&lights[i], width, height, &lightmap->mRecords[i]);
+        Lightmap_LinkRecord(lightmap, i, true);
+    }
+
+    // every light's visibility is independent of the others
+    Job_ParallelFor(lightmap->mRecords.size(), 1, [&](uint32_t startLight, uint32_t endLight) {
+        for (uint32_t i = startLight; i < endLight; i++) {
+            Lightmap_CastShadows(grid, &lightmap->mRecords[i], &lightmap->mMasks[i]);
+        }
+    });
+
+    if (width && height) {
+        Lightmap_RelightRows(lightmap, 0, 0, width - 1, height - 1);
+    }
+    lightmap->mValid = true;
+
+    Printf("Lightmap_Bake: %ux%u tiles, %u lights, %u workers, %.3f ms", width, height, numLights, Job_NumWorkers(),
+        (double)(Sys_Microseconds() - start) / 1000.0);
+}
+
+/*
+Lightmap_Bake: computes the light value of every tile in the map from its ambient term and static lights
+*/
+void Lightmap_Bake(const CMapData *data, CLightmap *lightmap)
+{
+    lightSides_t grid;
+    float ambient[3];
+
+    Lightmap_MapSides(data, &grid);
+    ambient[0] = data->mAmbientColor[0] + data->mAmbientIntensity;
+    ambient[1] = data->mAmbientColor[1] + data->mAmbientIntensity;
+    ambient[2] = data->mAmbientColor[2] + data->mAmbientIntensity;
+
+    Lightmap_BakeSides(&grid, data->mLights.data(), data->mLights.size(), ambient, lightmap);
+}
+
+/*
+Lightmap_UpdateLight: replaces the contribution of light #index with the one of the given light, only the tiles in
+range of either of them are touched. Does a full bake if the lightmap is out of date with the map, tile edits clear
+mValid since they can change what every light's mask was cast against.
+*/
+void Lightmap_UpdateLight(const CMapData *data, CLightmap *lightmap, uint32_t index, const maplight_t *light)
+{
+    PROFILE_FUNC();
+    lightRecord_t record;
+    lightSides_t grid;
+
+    // has to come before the early out below, which only compares the light itself
+    if (!lightmap->Matches(data->mWidth, data->mHeight) || lightmap->mRecords.size() != data->mLights.size()) {
+        Lightmap_Bake(data, lightmap);
+    }
+    if (index >= lightmap->mRecords.size()) {
+        Error("Lightmap_UpdateLight: bad light index %u", index);
+    }
+
+    Lightmap_MakeRecord(light, lightmap->mWidth, lightmap->mHeight, &record);
+    if (!memcmp(&record, &lightmap->mRecords[index], sizeof(record))) {
+        return; // nothing that affects the lighting changed
+    }
+
+    Lightmap_AddRecord(lightmap, index, -1.0f);
+    Lightmap_LinkRecord(lightmap, index, false);
+
+    lightmap->mRecords[index] = record;
+    Lightmap_MapSides(data, &grid);
+    Lightmap_CastShadows(&grid, &lightmap->mRecords[index], &lightmap->mMasks[index]);
+    Lightmap_LinkRecord(lightmap, index, true);
+    Lightmap_AddRecord(lightmap, index, 1.0f);
+}
+
+/*
+Lightmap_Flush: the float error of adding and subtracting light contributions builds up over a long edit, so once
+it's finished the touched tiles are recomputed from the lights that actually reach them
+*/
+void Lightmap_Flush(CLightmap *lightmap)
+{
+    PROFILE_FUNC();
+    if (lightmap->mDirty[2] < lightmap->mDirty[0]) {
+        return;
+    }
+
+    Lightmap_RelightRows(lightmap, lightmap->mDirty[0], lightmap->mDirty[1], lightmap->mDirty[2], lightmap->mDirty[3]);
+
+    lightmap->mDirty[0] = lightmap->mDirty[1] = INT32_MAX;
+    lightmap->mDirty[2] = lightmap->mDirty[3] = -1;
+}
+
+/*
+Lightmap_Benchmark: bakes a maximum-size map lit by the maximum amount of lights at full range,
+with a scattering of solid tiles for the shadows
+*/
+void Lightmap_Benchmark(void)
+{
+    std::unique_ptr<CMapData> data;
+    CLightmap lightmap;
+
+    data = std::make_unique<CMapData>();
+    data->SetMapSize(MAX_MAP_WIDTH, MAX_MAP_HEIGHT);
+    data->mLights.resize(MAX_MAP_LIGHTS);
+
+    srand(MAX_MAP_LIGHTS);
+    for (auto& it : data->mTiles) {
+        it.sides[SIDE_INSIDE] = (rand() & 15) == 0;
+    }
+    for (auto& it : data->mLights) {
+        memset(&it, 0, sizeof(it));
+        it.origin[0] = rand() % MAX_MAP_WIDTH;
+        it.origin[1] = rand() % MAX_MAP_HEIGHT;
+        it.color[0] = it.color[1] = it.color[2] = it.color[3] = 1.0f;
+        it.brightness = 1.0f;
+        it.range = 256.0f;
+    }
+
+    Printf("Lightmap_Benchmark: baking %ux%u tiles with %u lights...", MAX_MAP_WIDTH, MAX_MAP_HEIGHT, MAX_MAP_LIGHTS);
+    Lightmap_Bake(data.get(), &lightmap);
+
+    // drag the first light across the map one tile at a time
+    const uint32_t numMoves = 64;
+    maplight_t light = data->mLights[0];
+    uint64_t start;
+
+    start = Sys_Microseconds();
+    for (uint32_t i = 0; i < numMoves; i++) {
+        light.origin[0] = (light.origin[0] + 1) % MAX_MAP_WIDTH;
+        Lightmap_UpdateLight(data.get(), &lightmap, 0, &light);
+    }
+    Printf("Lightmap_Benchmark: %u single light updates, %.3f ms average", numMoves,
+        (double)(Sys_Microseconds() - start) / 1000.0 / numMoves);
+
+    start = Sys_Microseconds();
+    Lightmap_Flush(&lightmap);
+    Printf("Lightmap_Benchmark: flushed the dragged area in %.3f ms", (double)(Sys_Microseconds() - start) / 1000.0);
+}
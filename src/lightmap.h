@@ -0,0 +1,94 @@
+#ifndef __LIGHTMAP__
+#define __LIGHTMAP__
+
+#pragma once
+
+class CMapData;
+
+#define LIGHTMAP_CELL_SIZE 32 // tiles per side of a light index cell
+
+/*
+lightRecord_t: the parameters a light was baked with and the tile-space bounds it can reach,
+kept around so that its contribution can be taken back out of the lightmap
+*/
+typedef struct {
+    float x;
+    float y;
+    float invRange;
+    float r;
+    float g;
+    float b;
+    int32_t minX;
+    int32_t maxX;
+    int32_t minY;
+    int32_t maxY; // maxX < minX if the light doesn't reach any tiles
+} lightRecord_t;
+
+/*
+lightMask_t: which tiles in a light's bounds it can see, one bit per tile, rows padded to whole words
+*/
+typedef struct {
+    std::vector<uint64_t> bits;
+    uint32_t stride; // words per row
+} lightMask_t;
+
+/*
+CLightmap: baked per-tile light values for the static map lights. The color channels are kept in
+separate planes so that the bake kernel can work on several tiles at once.
+*/
+class CLightmap
+{
+public:
+    std::vector<float> mRed;
+    std::vector<float> mGreen;
+    std::vector<float> mBlue;
+    std::vector<lightRecord_t> mRecords;        // one per map light, same order as CMapData::mLights
+    std::vector<lightMask_t> mMasks;            // occlusion of each record, cast against the tile sides
+    std::vector<std::vector<uint32_t>> mCells;  // the lights reaching each LIGHTMAP_CELL_SIZE square
+    float mAmbient[3];
+    uint32_t mCellsX;
+    uint32_t mCellsY;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    int32_t mDirty[4];                          // tiles touched by incremental updates since the last flush
+    bool mValid;                                // cleared by map and tile edits until the next bake
+
+    CLightmap(void)
+        : mCellsX{ 0 }, mCellsY{ 0 }, mWidth{ 0 }, mHeight{ 0 }, mValid{ false }
+    { }
+    ~CLightmap() { }
+
+    void Clear(void);
+    void Resize(uint32_t width, uint32_t height);
+    void Quantize(maplightsample_t *out) const;
+
+    INLINE bool Matches(uint32_t width, uint32_t height) const
+    { return mValid && mWidth == width && mHeight == height; }
+    INLINE void Sample(uint32_t x, uint32_t y, float *rgb) const
+    {
+        const uint64_t i = (uint64_t)y * mWidth + x;
+        rgb[0] = clamp(mRed[i], 0.0f, 1.0f);
+        rgb[1] = clamp(mGreen[i], 0.0f, 1.0f);
+        rgb[2] = clamp(mBlue[i], 0.0f, 1.0f);
+    }
+};
+
+/*
+lightSides_t: the tile sides that block light, NUMSIDES bytes per tile with stride bytes from one tile to the next in
+row-major order, so that the bake can run off of a map's tiles or a plain grid of sides
+*/
+typedef struct {
+    const byte *sides;
+    uint64_t stride;
+    uint32_t width;
+    uint32_t height;
+} lightSides_t;
+
+void Lightmap_Bake(const CMapData *data, CLightmap *lightmap);
+void Lightmap_BakeSides(const lightSides_t *grid, const maplight_t *lights, uint32_t numLights, const float *ambient,
+    CLightmap *lightmap);
+void Lightmap_UpdateLight(const CMapData *data, CLightmap *lightmap, uint32_t index, const maplight_t *light);
+void Lightmap_Flush(CLightmap *lightmap);
+void Lightmap_Benchmark(void);
+
+#endif
@@ -22,25 +22,71 @@ static void GenIndexes(void)
 
 int main(int argc, char **argv)
 {
-    gui = std::make_unique<Window>();
+    benchParms_t bench;
+    const char *load;
+
+    // mapeditor [project] or mapeditor --benchmark <project|map> [--frames <n>] [--camera <path.json>] [--output <file.json>]
+    memset(&bench, 0, sizeof(bench));
+    bench.numFrames = BENCH_DEFAULT_FRAMES;
+    bench.output = "benchmark.json";
+    load = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!N_stricmp(argv[i], "--benchmark") && i + 1 < argc) {
+            bench.path = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--frames") && i + 1 < argc) {
+            bench.numFrames = atoi(argv[++i]);
+        }
+        else if (!N_stricmp(argv[i], "--camera") && i + 1 < argc) {
+            bench.camera = argv[++i];
+        }
+        else if (!N_stricmp(argv[i], "--output") && i + 1 < argc) {
+            bench.output = argv[++i];
+        }
+        else {
+            load = argv[i];
+        }
+    }
+
+    Profile_Init();
+
+    gui = std::make_unique<Window>(bench.path != NULL);
     editor = std::make_unique<CEditor>();
     gameConfig = std::make_unique<CGameConfig>();
     mapData = std::make_unique<CMapData>();
     project = std::make_unique<CProject>();
 
+    TexCache_Init((gameConfig->mEditorPath + TEXCACHE_DIR).c_str());
+    TexMem_Init();
+    if (!bench.path) {
+        Watch_AddListener(Project_FileChanged);
+        Watch_AddListener([](const std::string& path, uint32_t flags) { editor->mFileTree.FileChanged(path, flags); });
+        Watch_Init(gameConfig->mEditorPath.c_str());
+    }
     editor->ReloadFileCache();
     gameConfig->LoadMobList();
     InitGLObjects();
 
+    if (bench.path) {
+        return Bench_Run(&bench);
+    }
+
     // if we're given something from the command line, load it up
-    if (argv[1] && N_stricmp(GetExtension(argv[1]), "proj")) {
-        Project_Load(argv[1]);
+    if (load && !N_stricmp(GetExtension(load), "proj")) {
+        Project_Load(load);
     }
     else {
         Project_New();
     }
 
     while (1) {
+        Profile_BeginFrame();
+        PROFILE_SCOPE("Frame");
+
+        // finished background work, texture uploads and the like
+        Job_RunMainQueue();
+        TexMem_Collect();
+
         CheckAutoSave();
         gui->BeginFrame();
         editor->Draw();
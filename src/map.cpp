@@ -153,7 +153,7 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
                 return false;
             }
             tileset->texData->mName = tok;
-            tileset->texData->Load(tok);
+            tileset->texData->Load(tok, Tileset_TextureReady);
         }
         //
         // tileHeight <height>
@@ -215,8 +215,8 @@ static bool ParseChunk(const char **text, CMapData *tmpData)
         // sides <sides...>
         //
         else if (!N_stricmp(tok, "sides")) {
-            int sides[5];
-            if (!Parse1DMatrix(text, 5, (float *)sides)) {
+            float sides[5];
+            if (!Parse1DMatrix(text, 5, sides)) {
                 COM_ParseError("failed to parse sides for map tile");
                 return false;
             }
@@ -472,19 +472,16 @@ static bool ParseMap(const char **text, const char *path, CMapData *tmpData)
     return true;
 }
 
-void Map_LoadFile(IDataStream *file, const char *ext, const char *rpath)
+/*
+Map_LoadBuffer: parses a whole map file and swaps it in for the current map, buf has to be NUL terminated
+*/
+static void Map_LoadBuffer(char *buf, uint64_t fileLen, const char *rpath)
 {
-    uint64_t fileLen;
-    char *buf, *ptr;
+    char *ptr;
     const char **text;
     CMapData tmpData;
 
-    fileLen = file->GetLength();
-
     tmpData.Clear();
-    buf = (char *)GetMemory(fileLen);
-    file->Read(buf, fileLen);
-    file->Close();
 
     ptr = buf;
     text = (const char **)&ptr;
@@ -497,13 +494,70 @@ void Map_LoadFile(IDataStream *file, const char *ext, const char *rpath)
         project->tileset->GenerateTiles();
         *mapData = tmpData;
         mapData->mPath = rpath;
+        mapData->mFileHash = HashData(buf, fileLen);
+        mapData->mModified = false; // Clear() marked it, nothing's been edited yet
+        Lightmap_Bake(mapData.get(), &mapData->mLightmap);
         SDL_SetWindowTitle(gui->mWindow, mapData->mName.c_str());
     }
+}
+
+void Map_LoadFile(IDataStream *file, const char *ext, const char *rpath)
+{
+    uint64_t fileLen;
+    char *buf;
+
+    fileLen = file->GetLength();
+
+    buf = (char *)GetMemory(fileLen + 1);
+    file->Read(buf, fileLen);
+    file->Close();
+    buf[fileLen] = '\0';
+
+    Map_LoadBuffer(buf, fileLen, rpath);
     FreeMemory(buf);
 }
 
+/*
+Map_Reload: picks up changes made to the current map's file outside of the editor. The file is read and hashed on
+a worker and swapped in at the next frame boundary, unless it's what the editor last loaded or saved or there are
+unsaved edits that would be thrown away.
+*/
+void Map_Reload(void)
+{
+    const std::string path = mapData->mPath;
+
+    Job_Async([path](void) {
+        std::shared_ptr<std::string> text;
+        const void *data;
+        uint64_t length, hash;
+
+        data = Sys_MapFile(path.c_str(), &length);
+        if (!data) {
+            return;
+        }
+        text = std::make_shared<std::string>((const char *)data, length);
+        Sys_UnmapFile(data, length);
+        hash = HashData(text->data(), text->size());
+
+        Job_QueueMain([path, text, hash](void) {
+            PROFILE_SCOPE("Map_Reload");
+
+            if (mapData->mPath != path || mapData->mFileHash == hash) {
+                return;
+            }
+            if (mapData->mModified) {
+                Printf("Map_Reload: '%s' was changed on disk, but has unsaved changes that would be lost, not reloading", path.c_str());
+                return;
+            }
+            Printf("Map_Reload: reloading '%s'", path.c_str());
+            Map_LoadBuffer(text->data(), text->size(), path.c_str());
+        });
+    });
+}
+
 void Map_Load(const char *filename)
 {
+    PROFILE_FUNC();
     FileStream file;
     Printf("Loading map file '%s'", filename);
 
@@ -648,6 +702,19 @@ void Map_Save(const char *filename)
     SaveTiles(&file);
 
     file.Write("}\n", 2);
+    file.Close();
+
+    // so that the watcher doesn't reload what was just written
+    {
+        const void *data;
+        uint64_t length;
+
+        data = Sys_MapFile(rpath, &length);
+        if (data) {
+            mapData->mFileHash = HashData(data, length);
+            Sys_UnmapFile(data, length);
+        }
+    }
 
     mapData->mModified = false;
 }
@@ -659,6 +726,7 @@ CMapData::CMapData(void)
     mWidth = 16;
     mHeight = 16;
     mModified = true;
+    mFileHash = 0;
     mAmbientColor = { 1.0f, 1.0f, 1.0f };
     mAmbientIntensity = 0.0f;
 
@@ -952,7 +1020,9 @@ void CMapData::Clear(void)
     mTiles.clear();
     mPath.clear();
     mName.clear();
+    mLightmap.Clear();
     mModified = true;
+    mFileHash = 0;
 
     mCheckpoints.reserve(MAX_MAP_CHECKPOINTS);
     mSpawns.reserve(MAX_MAP_SPAWNS);
@@ -977,6 +1047,7 @@ CheckAutoSave: if mAutoSaveTime (in minutes) have passed since last edit, and th
 static time_t s_start = 0;
 void CheckAutoSave(void)
 {
+    PROFILE_FUNC();
     time_t now;
     time(&now);
 
@@ -20,6 +20,8 @@ public:
     std::vector<mapcheckpoint_t> mCheckpoints;
     std::vector<CEntity> mEntities;
 
+    CLightmap mLightmap;
+
     bool mDarkAmbience;
     float mAmbientIntensity;
     glm::vec3 mAmbientColor;
@@ -30,6 +32,7 @@ public:
     std::string mName;
 
     bool mModified;
+    uint64_t mFileHash; // of the file it was last loaded from or saved to
 
     CMapData(void);
     ~CMapData();
@@ -50,6 +53,7 @@ extern char mapname[1024];
 void Map_New(void);
 void Map_Load(const char *filename);
 void Map_Save(const char *filename);
+void Map_Reload(void);
 void CheckAutoSave(void);
 void CalcVertexNormals(Vertex *quad);
 
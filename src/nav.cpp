@@ -0,0 +1,759 @@
+#include "gln.h"
+#include <algorithm>
+#include <queue>
+
+#define NAV_LONG_ENTRANCE 6 // a border crossing at least this long gets a node at both ends instead of one in the middle
+#define NAV_START UINT32_MAX // the parent of the nodes a search starts from
+
+// NAVMOVE_* and SIDE_* order
+static const int32_t navSteps[4][2] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+
+/*
+navScratch_t: what a search keeps per tile or node, only the entries stamped with the current search are valid so
+that nothing has to be cleared between searches
+*/
+typedef struct {
+    std::vector<uint32_t> cost;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> stamp;
+    uint32_t search;
+} navScratch_t;
+
+static thread_local navScratch_t gridScratch;
+static thread_local navScratch_t graphScratch;
+
+/*
+navBuildNode_t: a node while the graph is being built
+*/
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t cluster;
+    std::vector<mapnavedge_t> edges;
+} navBuildNode_t;
+
+static void Nav_BeginSearch(navScratch_t *s, uint64_t count)
+{
+    if (s->stamp.size() < count) {
+        s->cost.resize(count);
+        s->parent.resize(count);
+        s->stamp.assign(count, 0);
+        s->search = 0;
+    }
+    if (++s->search == 0) {
+        std::fill(s->stamp.begin(), s->stamp.end(), 0);
+        s->search = 1;
+    }
+}
+
+static INLINE uint32_t Nav_Cost(const navScratch_t *s, uint64_t i)
+{
+    return s->stamp[i] == s->search ? s->cost[i] : NAV_NO_PATH;
+}
+
+static INLINE void Nav_SetCost(navScratch_t *s, uint64_t i, uint32_t cost, uint32_t parent)
+{
+    s->stamp[i] = s->search;
+    s->cost[i] = cost;
+    s->parent[i] = parent;
+}
+
+static INLINE uint32_t Nav_Distance(uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by)
+{
+    return (ax > bx ? ax - bx : bx - ax) + (ay > by ? ay - by : by - ay);
+}
+
+/*
+Nav_Moves: which ways every tile can be walked out of. A step is open if neither tile is solid and neither of the
+sides they share is set, like Lightmap_StepOpen, so that it's the same both ways.
+*/
+static void Nav_Moves(const lightSides_t *grid, byte *moves)
+{
+    const auto sides = [grid](int64_t x, int64_t y) {
+        return grid->sides + ((uint64_t)y * grid->width + x) * grid->stride;
+    };
+
+    for (uint32_t y = 0; y < grid->height; y++) {
+        for (uint32_t x = 0; x < grid->width; x++) {
+            const byte *from = sides(x, y);
+            byte bits = 0;
+
+            if (!from[SIDE_INSIDE]) {
+                for (uint32_t d = 0; d < 4; d++) {
+                    const int64_t nx = (int64_t)x + navSteps[d][0];
+                    const int64_t ny = (int64_t)y + navSteps[d][1];
+
+                    if (nx < 0 || ny < 0 || nx >= grid->width || ny >= grid->height) {
+                        continue;
+                    }
+                    const byte *to = sides(nx, ny);
+                    if (!to[SIDE_INSIDE] && !from[d] && !to[(d + 2) & 3]) {
+                        bits |= 1 << d;
+                    }
+                }
+            }
+            moves[(uint64_t)y * grid->width + x] = bits;
+        }
+    }
+}
+
+/*
+Nav_ClusterSearch: a breadth first search from (x, y) that doesn't leave its cluster, cost and parent are indexed by
+a tile's place in the cluster, y * clusterSize + x
+*/
+static void Nav_ClusterSearch(const byte *moves, uint32_t width, uint32_t height, uint32_t clusterSize, uint32_t x,
+    uint32_t y, uint32_t *cost, uint32_t *parent)
+{
+    const uint32_t x0 = x - x % clusterSize;
+    const uint32_t y0 = y - y % clusterSize;
+    const uint32_t x1 = std::min(x0 + clusterSize, width);
+    const uint32_t y1 = std::min(y0 + clusterSize, height);
+    uint32_t queue[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+    uint32_t head, tail;
+
+    std::fill(cost, cost + clusterSize * clusterSize, NAV_NO_PATH);
+
+    head = tail = 0;
+    queue[tail++] = (y - y0) * clusterSize + (x - x0);
+    cost[queue[0]] = 0;
+    parent[queue[0]] = queue[0];
+    while (head < tail) {
+        const uint32_t local = queue[head++];
+        const uint32_t lx = x0 + local % clusterSize;
+        const uint32_t ly = y0 + local / clusterSize;
+        const byte bits = moves[(uint64_t)ly * width + lx];
+
+        for (uint32_t d = 0; d < 4; d++) {
+            const uint32_t nx = lx + navSteps[d][0];
+            const uint32_t ny = ly + navSteps[d][1];
+            uint32_t next;
+
+            if (!(bits & (1 << d)) || nx < x0 || ny < y0 || nx >= x1 || ny >= y1) {
+                continue;
+            }
+            next = (ny - y0) * clusterSize + (nx - x0);
+            if (cost[next] == NAV_NO_PATH) {
+                cost[next] = cost[local] + 1;
+                parent[next] = local;
+                queue[tail++] = next;
+            }
+        }
+    }
+}
+
+/*
+Nav_Build: works the navigation lump out of a grid of sides. Crossings are found along every border between two
+clusters, a stretch ends where either side of it can't be walked along, so every tile of a stretch can get to its
+node without leaving the cluster. The costs inside of each cluster are searched for in parallel.
+*/
+void Nav_Build(const lightSides_t *grid, std::vector<byte>& out)
+{
+    const uint32_t width = grid->width;
+    const uint32_t height = grid->height;
+    const uint32_t clustersX = (width + NAV_CLUSTER_SIZE - 1) / NAV_CLUSTER_SIZE;
+    const uint32_t clustersY = (height + NAV_CLUSTER_SIZE - 1) / NAV_CLUSTER_SIZE;
+    const uint32_t numClusters = clustersX * clustersY;
+    std::vector<byte> moves;
+    std::vector<navBuildNode_t> nodes;
+    std::vector<uint32_t> order, remap, clusterNodes;
+    std::unordered_map<uint64_t, uint32_t> tileNodes;
+    mapnavheader_t header;
+    uint64_t size, numEdges;
+    byte *data;
+
+    moves.resize((uint64_t)width * height);
+    Nav_Moves(grid, moves.data());
+
+    const auto addNode = [&](uint32_t x, uint32_t y) -> uint32_t {
+        const uint64_t tile = (uint64_t)y * width + x;
+        const auto it = tileNodes.find(tile);
+
+        if (it != tileNodes.end()) {
+            return it->second;
+        }
+        navBuildNode_t& node = nodes.emplace_back();
+        node.x = x;
+        node.y = y;
+        node.cluster = (y / NAV_CLUSTER_SIZE) * clustersX + x / NAV_CLUSTER_SIZE;
+        tileNodes[tile] = nodes.size() - 1;
+        return nodes.size() - 1;
+    };
+    const auto addCrossing = [&](uint32_t x, uint32_t y, uint32_t dx, uint32_t dy) {
+        const uint32_t a = addNode(x, y);
+        const uint32_t b = addNode(x + dx, y + dy);
+
+        nodes[a].edges.push_back({ b, 1 });
+        nodes[b].edges.push_back({ a, 1 });
+    };
+    // a stretch along a border from (x, y) that's length tiles long, going (dx, dy) crosses it
+    const auto addStretch = [&](uint32_t x, uint32_t y, uint32_t length, uint32_t dx, uint32_t dy) {
+        const uint32_t ax = dx ? 0 : 1;
+        const uint32_t ay = dx ? 1 : 0;
+
+        if (length < NAV_LONG_ENTRANCE) {
+            addCrossing(x + ax * (length / 2), y + ay * (length / 2), dx, dy);
+        }
+        else {
+            addCrossing(x, y, dx, dy);
+            addCrossing(x + ax * (length - 1), y + ay * (length - 1), dx, dy);
+        }
+    };
+
+    // borders between columns of clusters
+    for (uint32_t x = NAV_CLUSTER_SIZE - 1; x + 1 < width; x += NAV_CLUSTER_SIZE) {
+        for (uint32_t y0 = 0; y0 < height; y0 += NAV_CLUSTER_SIZE) {
+            const uint32_t y1 = std::min(y0 + NAV_CLUSTER_SIZE, height);
+            uint32_t start = y0;
+
+            for (uint32_t y = y0; y < y1; y++) {
+                const byte here = moves[(uint64_t)y * width + x];
+                const byte there = moves[(uint64_t)y * width + x + 1];
+
+                if (!(here & NAVMOVE_EAST)) {
+                    if (y > start) {
+                        addStretch(x, start, y - start, 1, 0);
+                    }
+                    start = y + 1;
+                }
+                else if (!(here & NAVMOVE_SOUTH) || !(there & NAVMOVE_SOUTH) || y + 1 == y1) {
+                    addStretch(x, start, y + 1 - start, 1, 0);
+                    start = y + 1;
+                }
+            }
+        }
+    }
+
+    // and between rows of them
+    for (uint32_t y = NAV_CLUSTER_SIZE - 1; y + 1 < height; y += NAV_CLUSTER_SIZE) {
+        for (uint32_t x0 = 0; x0 < width; x0 += NAV_CLUSTER_SIZE) {
+            const uint32_t x1 = std::min(x0 + NAV_CLUSTER_SIZE, width);
+            uint32_t start = x0;
+
+            for (uint32_t x = x0; x < x1; x++) {
+                const byte here = moves[(uint64_t)y * width + x];
+                const byte there = moves[(uint64_t)(y + 1) * width + x];
+
+                if (!(here & NAVMOVE_SOUTH)) {
+                    if (x > start) {
+                        addStretch(start, y, x - start, 0, 1);
+                    }
+                    start = x + 1;
+                }
+                else if (!(here & NAVMOVE_EAST) || !(there & NAVMOVE_EAST) || x + 1 == x1) {
+                    addStretch(start, y, x + 1 - start, 0, 1);
+                    start = x + 1;
+                }
+            }
+        }
+    }
+
+    // sort the nodes by cluster
+    order.resize(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&nodes](uint32_t a, uint32_t b) {
+        if (nodes[a].cluster != nodes[b].cluster) {
+            return nodes[a].cluster < nodes[b].cluster;
+        }
+        return nodes[a].y != nodes[b].y ? nodes[a].y < nodes[b].y : nodes[a].x < nodes[b].x;
+    });
+    remap.resize(nodes.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        remap[order[i]] = i;
+    }
+    {
+        std::vector<navBuildNode_t> sorted(nodes.size());
+
+        for (uint32_t i = 0; i < order.size(); i++) {
+            sorted[i] = std::move(nodes[order[i]]);
+            for (auto& it : sorted[i].edges) {
+                it.node = remap[it.node];
+            }
+        }
+        nodes.swap(sorted);
+    }
+    clusterNodes.assign(numClusters + 1, 0);
+    for (const auto& it : nodes) {
+        clusterNodes[it.cluster + 1]++;
+    }
+    for (uint32_t i = 0; i < numClusters; i++) {
+        clusterNodes[i + 1] += clusterNodes[i];
+    }
+
+    // walking costs between the nodes of each cluster
+    Job_ParallelFor(numClusters, JOB_MIN_GRAIN, [&](uint32_t start, uint32_t end) {
+        uint32_t cost[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE], parent[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+
+        for (uint32_t c = start; c < end; c++) {
+            for (uint32_t i = clusterNodes[c]; i < clusterNodes[c + 1]; i++) {
+                navBuildNode_t *node = &nodes[i];
+
+                Nav_ClusterSearch(moves.data(), width, height, NAV_CLUSTER_SIZE, node->x, node->y, cost, parent);
+                for (uint32_t j = clusterNodes[c]; j < clusterNodes[c + 1]; j++) {
+                    const uint32_t local = (nodes[j].y % NAV_CLUSTER_SIZE) * NAV_CLUSTER_SIZE + nodes[j].x % NAV_CLUSTER_SIZE;
+
+                    if (j != i && cost[local] != NAV_NO_PATH) {
+                        node->edges.push_back({ j, cost[local] });
+                    }
+                }
+            }
+        }
+    });
+
+    numEdges = 0;
+    for (const auto& it : nodes) {
+        numEdges += it.edges.size();
+    }
+
+    header.clusterSize = NAV_CLUSTER_SIZE;
+    header.width = width;
+    header.height = height;
+    header.numNodes = nodes.size();
+    header.numEdges = numEdges;
+
+    size = sizeof(header) + sizeof(uint32_t) * clusterNodes.size() + sizeof(mapnavnode_t) * nodes.size()
+        + sizeof(mapnavedge_t) * numEdges + moves.size();
+    out.resize(size);
+    data = out.data();
+
+    memcpy(data, &header, sizeof(header));
+    data += sizeof(header);
+    memcpy(data, clusterNodes.data(), sizeof(uint32_t) * clusterNodes.size());
+    data += sizeof(uint32_t) * clusterNodes.size();
+
+    numEdges = 0;
+    for (const auto& it : nodes) {
+        mapnavnode_t node;
+
+        node.pos[0] = it.x;
+        node.pos[1] = it.y;
+        node.cluster = it.cluster;
+        node.firstEdge = numEdges;
+        node.numEdges = it.edges.size();
+        memcpy(data, &node, sizeof(node));
+        data += sizeof(node);
+        numEdges += it.edges.size();
+    }
+    for (const auto& it : nodes) {
+        if (!it.edges.empty()) {
+            memcpy(data, it.edges.data(), sizeof(mapnavedge_t) * it.edges.size());
+            data += sizeof(mapnavedge_t) * it.edges.size();
+        }
+    }
+    if (!moves.empty()) {
+        memcpy(data, moves.data(), moves.size());
+    }
+
+    Printf("Nav_Build: %u clusters, %u nodes, %u edges", numClusters, header.numNodes, header.numEdges);
+}
+
+/*
+Nav_Load: points graph at the parts of a navigation lump, nothing is copied so the lump has to stay loaded
+*/
+bool Nav_Load(navGraph_t *graph, const void *lump, uint64_t length)
+{
+    const byte *data = (const byte *)lump;
+    uint64_t numClusters, size;
+
+    memset(graph, 0, sizeof(*graph));
+    if (!lump || length < sizeof(mapnavheader_t) || ((uintptr_t)lump & (sizeof(uint32_t) - 1))) {
+        Printf("Nav_Load: no navigation data");
+        return false;
+    }
+    graph->header = (const mapnavheader_t *)data;
+    if (!graph->header->clusterSize || graph->header->clusterSize > NAV_CLUSTER_SIZE) {
+        Printf("Nav_Load: bad cluster size %u", graph->header->clusterSize);
+        return false;
+    }
+
+    graph->clustersX = (graph->header->width + graph->header->clusterSize - 1) / graph->header->clusterSize;
+    graph->clustersY = (graph->header->height + graph->header->clusterSize - 1) / graph->header->clusterSize;
+    numClusters = (uint64_t)graph->clustersX * graph->clustersY;
+    size = sizeof(mapnavheader_t) + sizeof(uint32_t) * (numClusters + 1) + sizeof(mapnavnode_t) * graph->header->numNodes
+        + sizeof(mapnavedge_t) * graph->header->numEdges + (uint64_t)graph->header->width * graph->header->height;
+    if (size != length) {
+        Printf("Nav_Load: lump is %lu bytes, expected %lu", length, size);
+        return false;
+    }
+
+    data += sizeof(mapnavheader_t);
+    graph->clusterNodes = (const uint32_t *)data;
+    data += sizeof(uint32_t) * (numClusters + 1);
+    graph->nodes = (const mapnavnode_t *)data;
+    data += sizeof(mapnavnode_t) * graph->header->numNodes;
+    graph->edges = (const mapnavedge_t *)data;
+    data += sizeof(mapnavedge_t) * graph->header->numEdges;
+    graph->moves = data;
+
+    if (graph->clusterNodes[numClusters] != graph->header->numNodes) {
+        Printf("Nav_Load: cluster offsets don't add up to %u nodes", graph->header->numNodes);
+        return false;
+    }
+    for (uint64_t i = 0; i < numClusters; i++) {
+        if (graph->clusterNodes[i] > graph->clusterNodes[i + 1]) {
+            Printf("Nav_Load: cluster %lu has a bad offset", i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < graph->header->numNodes; i++) {
+        const mapnavnode_t *node = &graph->nodes[i];
+
+        if ((uint64_t)node->firstEdge + node->numEdges > graph->header->numEdges || node->cluster >= numClusters
+            || node->pos[0] >= graph->header->width || node->pos[1] >= graph->header->height) {
+            Printf("Nav_Load: node %u is out of range", i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < graph->header->numEdges; i++) {
+        if (graph->edges[i].node >= graph->header->numNodes) {
+            Printf("Nav_Load: edge %u is out of range", i);
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < (uint64_t)graph->header->width * graph->header->height; i++) {
+        const uint32_t x = i % graph->header->width;
+        const uint32_t y = i / graph->header->width;
+
+        for (uint32_t d = 0; d < 4; d++) {
+            if ((graph->moves[i] & (1 << d)) && (x + navSteps[d][0] >= graph->header->width
+                || y + navSteps[d][1] >= graph->header->height)) {
+                Printf("Nav_Load: tile (%u, %u) can move off the map", x, y);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+Nav_AppendClusterPath: adds the tiles from the one the cluster search started at to (x, y) onto path, leaving out
+the first one
+*/
+static void Nav_AppendClusterPath(const uint32_t *parent, uint32_t clusterSize, uint32_t x, uint32_t y,
+    std::vector<navPoint_t> *path)
+{
+    const uint32_t x0 = x - x % clusterSize;
+    const uint32_t y0 = y - y % clusterSize;
+    const uint64_t first = path->size();
+    uint32_t local = (y - y0) * clusterSize + (x - x0);
+
+    while (parent[local] != local) {
+        path->push_back({ x0 + local % clusterSize, y0 + local / clusterSize });
+        local = parent[local];
+    }
+    std::reverse(path->begin() + first, path->end());
+}
+
+/*
+Nav_FindPath: an HPA* search from (sx, sy) to (gx, gy). The start and goal are joined to the nodes of their own
+clusters, the graph is searched between them and the result is only as long as going through the nodes, which
+is close to but not always the shortest path. If path is given it's filled in with every tile along the way,
+start and goal included. Returns the amount of steps or NAV_NO_PATH.
+*/
+uint32_t Nav_FindPath(const navGraph_t *graph, uint32_t sx, uint32_t sy, uint32_t gx, uint32_t gy,
+    std::vector<navPoint_t> *path)
+{
+    const mapnavheader_t *h = graph->header;
+    const uint32_t size = h->clusterSize;
+    const uint32_t startCluster = (sy / size) * graph->clustersX + sx / size;
+    const uint32_t goalCluster = (gy / size) * graph->clustersX + gx / size;
+    uint32_t startCost[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE], startParent[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+    uint32_t goalCost[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE], goalParent[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> open;
+    navScratch_t *s = &graphScratch;
+    uint32_t best, bestNode;
+
+    if (path) {
+        path->clear();
+    }
+    if (sx >= h->width || sy >= h->height || gx >= h->width || gy >= h->height) {
+        return NAV_NO_PATH;
+    }
+
+    const auto local = [size](uint32_t x, uint32_t y) { return (y % size) * size + x % size; };
+
+    Nav_ClusterSearch(graph->moves, h->width, h->height, size, sx, sy, startCost, startParent);
+    if (startCluster == goalCluster && startCost[local(gx, gy)] != NAV_NO_PATH) {
+        if (path) {
+            path->push_back({ sx, sy });
+            Nav_AppendClusterPath(startParent, size, gx, gy, path);
+        }
+        return startCost[local(gx, gy)];
+    }
+    Nav_ClusterSearch(graph->moves, h->width, h->height, size, gx, gy, goalCost, goalParent);
+
+    Nav_BeginSearch(s, h->numNodes);
+    for (uint32_t i = graph->clusterNodes[startCluster]; i < graph->clusterNodes[startCluster + 1]; i++) {
+        const mapnavnode_t *node = &graph->nodes[i];
+        const uint32_t cost = startCost[local(node->pos[0], node->pos[1])];
+
+        if (cost != NAV_NO_PATH) {
+            Nav_SetCost(s, i, cost, NAV_START);
+            open.push(((uint64_t)(cost + Nav_Distance(node->pos[0], node->pos[1], gx, gy)) << 32) | i);
+        }
+    }
+
+    best = bestNode = NAV_NO_PATH;
+    while (!open.empty()) {
+        const uint32_t f = open.top() >> 32;
+        const uint32_t index = open.top() & 0xffffffff;
+        const mapnavnode_t *node = &graph->nodes[index];
+        const uint32_t cost = Nav_Cost(s, index);
+
+        open.pop();
+        if (f >= best) {
+            break;
+        }
+        if (f != cost + Nav_Distance(node->pos[0], node->pos[1], gx, gy)) {
+            continue; // it's been reached some cheaper way since
+        }
+
+        if (node->cluster == goalCluster && goalCost[local(node->pos[0], node->pos[1])] != NAV_NO_PATH
+            && cost + goalCost[local(node->pos[0], node->pos[1])] < best) {
+            best = cost + goalCost[local(node->pos[0], node->pos[1])];
+            bestNode = index;
+        }
+
+        for (uint32_t i = 0; i < node->numEdges; i++) {
+            const mapnavedge_t *edge = &graph->edges[node->firstEdge + i];
+            const mapnavnode_t *next = &graph->nodes[edge->node];
+
+            if (cost + edge->cost < Nav_Cost(s, edge->node)) {
+                Nav_SetCost(s, edge->node, cost + edge->cost, index);
+                open.push(((uint64_t)(cost + edge->cost + Nav_Distance(next->pos[0], next->pos[1], gx, gy)) << 32)
+                    | edge->node);
+            }
+        }
+    }
+
+    if (best == NAV_NO_PATH || !path) {
+        return best;
+    }
+
+    // walk it back through the nodes and then fill in the tiles between them
+    std::vector<uint32_t> chain;
+    uint32_t cost[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE], parent[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+
+    for (uint32_t i = bestNode; i != NAV_START; i = s->parent[i]) {
+        chain.push_back(i);
+    }
+    std::reverse(chain.begin(), chain.end());
+
+    path->push_back({ sx, sy });
+    Nav_AppendClusterPath(startParent, size, graph->nodes[chain[0]].pos[0], graph->nodes[chain[0]].pos[1], path);
+    for (uint32_t i = 1; i < chain.size(); i++) {
+        const mapnavnode_t *from = &graph->nodes[chain[i - 1]];
+        const mapnavnode_t *to = &graph->nodes[chain[i]];
+
+        if (from->cluster != to->cluster) {
+            path->push_back({ to->pos[0], to->pos[1] });
+            continue;
+        }
+        Nav_ClusterSearch(graph->moves, h->width, h->height, size, from->pos[0], from->pos[1], cost, parent);
+        Nav_AppendClusterPath(parent, size, to->pos[0], to->pos[1], path);
+    }
+
+    // the goal's search runs the other way, so its parents already lead towards the goal
+    for (uint32_t i = local(path->back().x, path->back().y); goalParent[i] != i; ) {
+        i = goalParent[i];
+        path->push_back({ gx - gx % size + i % size, gy - gy % size + i / size });
+    }
+
+    return best;
+}
+
+/*
+Nav_FindGridPath: a plain A* over every tile, what Nav_FindPath is measured against. Always finds the shortest
+path. Returns the same as Nav_FindPath.
+*/
+uint32_t Nav_FindGridPath(const navGraph_t *graph, uint32_t sx, uint32_t sy, uint32_t gx, uint32_t gy,
+    std::vector<navPoint_t> *path)
+{
+    const mapnavheader_t *h = graph->header;
+    const uint64_t goal = (uint64_t)gy * h->width + gx;
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> open;
+    navScratch_t *s = &gridScratch;
+    uint64_t start;
+
+    if (path) {
+        path->clear();
+    }
+    if (sx >= h->width || sy >= h->height || gx >= h->width || gy >= h->height) {
+        return NAV_NO_PATH;
+    }
+
+    Nav_BeginSearch(s, (uint64_t)h->width * h->height);
+    start = (uint64_t)sy * h->width + sx;
+    Nav_SetCost(s, start, 0, start);
+    open.push(((uint64_t)Nav_Distance(sx, sy, gx, gy) << 32) | start);
+
+    while (!open.empty()) {
+        const uint32_t f = open.top() >> 32;
+        const uint32_t index = open.top() & 0xffffffff;
+        const uint32_t x = index % h->width;
+        const uint32_t y = index / h->width;
+        const uint32_t cost = Nav_Cost(s, index);
+
+        open.pop();
+        if (f != cost + Nav_Distance(x, y, gx, gy)) {
+            continue;
+        }
+        if (index == goal) {
+            break;
+        }
+
+        for (uint32_t d = 0; d < 4; d++) {
+            const uint32_t nx = x + navSteps[d][0];
+            const uint32_t ny = y + navSteps[d][1];
+            const uint32_t next = ny * h->width + nx;
+
+            if ((graph->moves[index] & (1 << d)) && nx < h->width && ny < h->height && cost + 1 < Nav_Cost(s, next)) {
+                Nav_SetCost(s, next, cost + 1, index);
+                open.push(((uint64_t)(cost + 1 + Nav_Distance(nx, ny, gx, gy)) << 32) | next);
+            }
+        }
+    }
+
+    if (Nav_Cost(s, goal) == NAV_NO_PATH) {
+        return NAV_NO_PATH;
+    }
+    if (path) {
+        for (uint64_t i = goal; ; i = s->parent[i]) {
+            path->push_back({ (uint32_t)(i % h->width), (uint32_t)(i / h->width) });
+            if (i == start) {
+                break;
+            }
+        }
+        std::reverse(path->begin(), path->end());
+    }
+    return Nav_Cost(s, goal);
+}
+
+/*
+Nav_CheckPath: true if every step of path is one tile that can be walked and it goes from start to goal
+*/
+static bool Nav_CheckPath(const navGraph_t *graph, const std::vector<navPoint_t>& path, uint32_t cost, uint32_t sx,
+    uint32_t sy, uint32_t gx, uint32_t gy)
+{
+    if (path.size() != (uint64_t)cost + 1 || path.front().x != sx || path.front().y != sy || path.back().x != gx
+        || path.back().y != gy) {
+        return false;
+    }
+    for (uint64_t i = 1; i < path.size(); i++) {
+        const byte bits = graph->moves[(uint64_t)path[i - 1].y * graph->header->width + path[i - 1].x];
+        uint32_t d;
+
+        for (d = 0; d < 4; d++) {
+            if (path[i - 1].x + navSteps[d][0] == path[i].x && path[i - 1].y + navSteps[d][1] == path[i].y) {
+                break;
+            }
+        }
+        if (d == 4 || !(bits & (1 << d))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Nav_PrintTimes(const char *name, std::vector<uint64_t>& times)
+{
+    uint64_t total = 0;
+
+    if (times.empty()) {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    for (const auto& it : times) {
+        total += it;
+    }
+    Printf("Nav_Benchmark: %-14s %9.1f us mean, %7lu us median, %7lu us p99", name, (double)total / times.size(),
+        times[times.size() / 2], times[std::min<uint64_t>(times.size() * 99 / 100, times.size() - 1)]);
+}
+
+/*
+Nav_Benchmark: times numQueries searches between random open tiles of a compiled level with the HPA* graph, with
+and without filling in the tiles, and with a plain A* over the tiles. Every path is checked and the HPA* lengths are
+compared to the shortest ones.
+*/
+void Nav_Benchmark(const char *path, uint32_t numQueries)
+{
+    std::vector<uint64_t> gridTimes, graphTimes, pathTimes;
+    std::vector<navPoint_t> points, tiles;
+    uint64_t gridTotal, graphTotal, time;
+    uint32_t numFound, numBad, numOpen;
+    navGraph_t graph;
+    bmfFile_t file;
+    const void *lump;
+    uint64_t length;
+
+    if (!BMF_Open(path, &file)) {
+        Error("Nav_Benchmark: failed to load '%s'", path);
+    }
+    lump = BMF_GetLump(&file, LUMP_NAVIGATION, &length);
+    if (!Nav_Load(&graph, lump, length)) {
+        Error("Nav_Benchmark: '%s' has no usable navigation lump", path);
+    }
+
+    numOpen = 0;
+    for (uint64_t i = 0; i < (uint64_t)graph.header->width * graph.header->height; i++) {
+        numOpen += graph.moves[i] != 0;
+    }
+    if (numOpen < 2) {
+        Error("Nav_Benchmark: '%s' doesn't have anywhere to walk", path);
+    }
+
+    // fixed so that runs can be compared
+    srand(numQueries);
+    while (points.size() < (uint64_t)numQueries * 2) {
+        const uint32_t x = ((uint32_t)rand() * RAND_MAX + rand()) % graph.header->width;
+        const uint32_t y = ((uint32_t)rand() * RAND_MAX + rand()) % graph.header->height;
+
+        if (graph.moves[(uint64_t)y * graph.header->width + x]) {
+            points.push_back({ x, y });
+        }
+    }
+
+    Printf("Nav_Benchmark: %u queries on '%s', %ux%u tiles, %u nodes, %u edges", numQueries, path, graph.header->width,
+        graph.header->height, graph.header->numNodes, graph.header->numEdges);
+
+    numFound = numBad = 0;
+    gridTotal = graphTotal = 0;
+    for (uint32_t i = 0; i < numQueries; i++) {
+        const navPoint_t *a = &points[i * 2];
+        const navPoint_t *b = &points[i * 2 + 1];
+        uint32_t gridCost, graphCost, pathCost;
+
+        time = Sys_Microseconds();
+        gridCost = Nav_FindGridPath(&graph, a->x, a->y, b->x, b->y, NULL);
+        gridTimes.push_back(Sys_Microseconds() - time);
+
+        time = Sys_Microseconds();
+        graphCost = Nav_FindPath(&graph, a->x, a->y, b->x, b->y, NULL);
+        graphTimes.push_back(Sys_Microseconds() - time);
+
+        time = Sys_Microseconds();
+        pathCost = Nav_FindPath(&graph, a->x, a->y, b->x, b->y, &tiles);
+        pathTimes.push_back(Sys_Microseconds() - time);
+
+        if ((gridCost == NAV_NO_PATH) != (graphCost == NAV_NO_PATH) || pathCost != graphCost || graphCost < gridCost
+            || (pathCost != NAV_NO_PATH && !Nav_CheckPath(&graph, tiles, pathCost, a->x, a->y, b->x, b->y))) {
+            numBad++;
+            continue;
+        }
+        if (gridCost != NAV_NO_PATH) {
+            numFound++;
+            gridTotal += gridCost;
+            graphTotal += graphCost;
+        }
+    }
+
+    Nav_PrintTimes("grid A*", gridTimes);
+    Nav_PrintTimes("HPA*", graphTimes);
+    Nav_PrintTimes("HPA* + tiles", pathTimes);
+    Printf("Nav_Benchmark: %u paths found, %u unreachable, %u wrong, HPA* paths are %.2f%% longer than the shortest",
+        numFound, numQueries - numFound - numBad, numBad, gridTotal ? 100.0 * (graphTotal - gridTotal) / gridTotal : 0.0);
+
+    BMF_Close(&file);
+}
@@ -0,0 +1,34 @@
+#ifndef __NAV__
+#define __NAV__
+
+#pragma once
+
+/*
+navGraph_t: a level's navigation lump read in place, see mapnavheader_t for what each part is
+*/
+typedef struct {
+    const mapnavheader_t *header;
+    const uint32_t *clusterNodes; // clustersX * clustersY + 1 offsets into nodes
+    const mapnavnode_t *nodes;
+    const mapnavedge_t *edges;
+    const byte *moves; // NAVMOVE_* for every tile, row-major
+    uint32_t clustersX;
+    uint32_t clustersY;
+} navGraph_t;
+
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+} navPoint_t;
+
+#define NAV_NO_PATH UINT32_MAX
+
+void Nav_Build(const lightSides_t *grid, std::vector<byte>& out);
+bool Nav_Load(navGraph_t *graph, const void *lump, uint64_t length);
+uint32_t Nav_FindPath(const navGraph_t *graph, uint32_t sx, uint32_t sy, uint32_t gx, uint32_t gy,
+    std::vector<navPoint_t> *path);
+uint32_t Nav_FindGridPath(const navGraph_t *graph, uint32_t sx, uint32_t sy, uint32_t gx, uint32_t gy,
+    std::vector<navPoint_t> *path);
+void Nav_Benchmark(const char *path, uint32_t numQueries);
+
+#endif
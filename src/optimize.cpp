@@ -1,67 +1,214 @@
-// optimize.cpp: meant to optimize a glnomad map/level file, possibly making it smaller and faster
+// optimize.cpp: makes a compiled .bmf smaller and faster to draw, run after bmfc has written it
 
-#include "Common.hpp"
+#include "gln.h"
+#include <algorithm>
 
-static uint64_t CopyLump(void **dest, uint64_t size, mapheader_t *header, int lumpnum)
+/*
+Optimize_Morton: interleaves the bits of x and y so that sorting by it walks a Z-order curve, tiles that are close
+on the map end up close in memory
+*/
+static uint64_t Optimize_Morton(uint32_t x, uint32_t y)
 {
-    uint64_t length, ofs;
+    const auto spread = [](uint64_t v) {
+        v &= 0xffffffff;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+        v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+        v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        v = (v | (v << 2)) & 0x3333333333333333ULL;
+        v = (v | (v << 1)) & 0x5555555555555555ULL;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+/*
+Shrink_Tiles: drops the tiles that don't draw or block anything and sorts the rest by their position's Morton code,
+each one already knows where it goes from its pos. A lump that's already sparse is only sorted again.
+*/
+static void Shrink_Tiles(std::vector<maptile_t>& tiles)
+{
+    std::vector<maptile_t> kept;
 
-    length = header->lumps[lumpnum].length;
-    ofs = header->lumps[lumpnum].fileofs;
+    kept.reserve(tiles.size());
+    for (const auto& it : tiles) {
+        bool solid = false;
 
-    if (length % size)
-        Error("CopyLump: odd lump size");
-    
-    *dest = Malloc(length);
-    memcpy(*dest, (byte *)header + ofs, length);
+        for (uint32_t i = 0; i < NUMSIDES; i++) {
+            solid |= it.sides[i] != 0;
+        }
+        if (it.index >= 0 || solid || it.flags) {
+            kept.emplace_back(it);
+        }
+    }
 
-    return length / size;
+    std::stable_sort(kept.begin(), kept.end(), [](const maptile_t& a, const maptile_t& b) {
+        return Optimize_Morton(a.pos[0], a.pos[1]) < Optimize_Morton(b.pos[0], b.pos[1]);
+    });
+    tiles.swap(kept);
 }
 
-static maptexture_t *textures;
-static uint64_t numTextures;
-static mapcheckpoint_t *checkpoints;
-static uint64_t numCheckpoints;
-static mapspawn_t *spawns;
-static uint64_t numSpawns;
-static maplight_t *lights;
-static uint64_t numLights;
-static maptile_t *tiles;
-static uint64_t numTiles;
-static mapvert_t *vertices;
-static uint64_t numVertices;
-static uint32_t *indices;
-static uint64_t numIndices;
-
-void Optimize_Map(const char *filepath)
+/*
+Shrink_VerticesAndIndices: merges vertices that are exactly the same, sorts the triangles by the Morton code of their
+centers and then numbers the vertices in the order the triangles first use them, so that both buffers are read
+front to back while drawing. Returns false if an index is past the vertices.
+*/
+static bool Shrink_VerticesAndIndices(std::vector<mapdrawvert_t>& vertices, std::vector<uint32_t>& indices)
 {
-    mapheader_t *header;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> unique;
+    std::vector<uint32_t> remap, order;
+    std::vector<uint64_t> codes;
+    std::vector<mapdrawvert_t> outVertices;
+    std::vector<uint32_t> outIndices;
+    uint32_t numTriangles;
 
-    if (!FileExists(filepath)) {
-        Printf("Optimize_Map: filepath '%s' doesn't exist", filepath);
-        return;
+    // identical vertices
+    remap.resize(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        auto& bucket = unique[HashData(&vertices[i], sizeof(vertices[i]))];
+        uint32_t j;
+
+        for (j = 0; j < bucket.size(); j++) {
+            if (!memcmp(&vertices[bucket[j]], &vertices[i], sizeof(vertices[i]))) {
+                break;
+            }
+        }
+        if (j == bucket.size()) {
+            bucket.emplace_back(i);
+        }
+        remap[i] = bucket[j];
+    }
+    for (auto& it : indices) {
+        if (it >= vertices.size()) {
+            Printf("Shrink_VerticesAndIndices: index %u out of %lu vertices", it, vertices.size());
+            return false;
+        }
+        it = remap[it];
     }
 
-    LoadMap();
+    // the triangles along the curve
+    numTriangles = indices.size() / 3;
+    codes.resize(numTriangles);
+    order.resize(numTriangles);
+    for (uint32_t i = 0; i < numTriangles; i++) {
+        const mapdrawvert_t *v[3] = { &vertices[indices[i * 3 + 0]], &vertices[indices[i * 3 + 1]], &vertices[indices[i * 3 + 2]] };
+        const float x = (v[0]->xyz[0] + v[1]->xyz[0] + v[2]->xyz[0]) / 3.0f;
+        const float y = (v[0]->xyz[1] + v[1]->xyz[1] + v[2]->xyz[1]) / 3.0f;
 
-    LoadFile(filepath, (void **)&header);
+        codes[i] = Optimize_Morton((uint32_t)std::max(x, 0.0f), (uint32_t)std::max(y, 0.0f));
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&codes](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
 
-    numTiles = CopyLump((void **)&tiles, sizeof(maptile_t), header, MAP_LUMP_TILES);
-    numCheckpoints = CopyLump((void **)&checkpoints, sizeof(mapcheckpoint_t), header, MAP_LUMP_CHECKPOINTS);
-    numSpawns = CopyLump((void **)&spawns, sizeof(mapspawn_t), header, MAP_LUMP_SPAWNS);
+    // and the vertices in the order they're first used
+    remap.assign(vertices.size(), UINT32_MAX);
+    outIndices.reserve(numTriangles * 3);
+    for (const auto& triangle : order) {
+        for (uint32_t i = 0; i < 3; i++) {
+            const uint32_t index = indices[triangle * 3 + i];
 
-    Free(header);
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = outVertices.size();
+                outVertices.emplace_back(vertices[index]);
+            }
+            outIndices.emplace_back(remap[index]);
+        }
+    }
+
+    vertices.swap(outVertices);
+    indices.swap(outIndices);
+
+    return true;
 }
 
-void Shrink_Tiles(void)
+template<typename T>
+static void Optimize_LoadRecords(bmfFile_t *file, int lumpnum, std::vector<T>& out)
 {
-    
+    const bmfSpan_t<T> span = BMF_GetRecords<T>(file, lumpnum);
+
+    out.assign(span.begin(), span.end());
 }
 
-void Shrink_VerticesAndIndices(void)
+/*
+Optimize_File: rewrites a compiled level with sparse, Z-ordered tiles and deduplicated, Z-ordered draw data, the
+rest of the lumps are copied over. Lumps of at least COMPRESSED_LUMP_SIZE bytes are compressed with compression.
+input and output can be the same file. Prints what every lump was before and after.
+*/
+bool Optimize_File(const char *input, const char *output, int compression)
 {
-    // multiple of four
-    if (!(numVertices % 4)) {
-        
+    const uint64_t start = Sys_Microseconds();
+    std::vector<std::vector<byte>> lumps;
+    std::vector<maptile_t> tiles;
+    std::vector<mapdrawvert_t> vertices;
+    std::vector<uint32_t> indices;
+    bmfLumpData_t data[NUMLUMPS];
+    lump_t before[NUMLUMPS];
+    uint64_t beforeRecords[NUMLUMPS], length;
+    bmfFile_t file;
+    std::string report;
+    char line[256];
+    bmf_t bmf;
+
+    if (!BMF_Open(input, &file)) {
+        Printf("Optimize_File: failed to load '%s'", input);
+        return false;
+    }
+
+    // everything is copied out so that the file can be written over
+    bmf = file.header;
+    if (bmf.map.lumps[LUMP_SECTORS].uncompressedLength) {
+        Printf("Optimize_File: '%s' is split into sectors, optimize it before it's split", input);
+        BMF_Close(&file);
+        return false;
+    }
+    memcpy(before, bmf.map.lumps, sizeof(before));
+    lumps.resize(NUMLUMPS);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const byte *lump = (const byte *)BMF_GetLump(&file, i, &length);
+
+        if (bmf.map.lumps[i].uncompressedLength && !lump) {
+            Printf("Optimize_File: failed to load the %s lump of '%s'", BMF_LumpName(i), input);
+            BMF_Close(&file);
+            return false;
+        }
+        lumps[i].assign(lump, lump + length);
+        beforeRecords[i] = length / BMF_LumpRecordSize(i);
+    }
+    Optimize_LoadRecords(&file, LUMP_TILES, tiles);
+    Optimize_LoadRecords(&file, LUMP_VERTICES, vertices);
+    Optimize_LoadRecords(&file, LUMP_INDICES, indices);
+    BMF_Close(&file);
+
+    Shrink_Tiles(tiles);
+    if (!Shrink_VerticesAndIndices(vertices, indices)) {
+        Printf("Optimize_File: '%s' has broken draw data", input);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        data[i].data = lumps[i].data();
+        data[i].size = lumps[i].size();
+        data[i].flags = before[i].flags;
     }
+    data[LUMP_TILES] = { tiles.data(), sizeof(maptile_t) * tiles.size(), before[LUMP_TILES].flags | LUMPFLAG_SPARSE };
+    data[LUMP_VERTICES] = { vertices.data(), sizeof(mapdrawvert_t) * vertices.size(), before[LUMP_VERTICES].flags };
+    data[LUMP_INDICES] = { indices.data(), sizeof(uint32_t) * indices.size(), before[LUMP_INDICES].flags };
+
+    if (!BMF_WriteFile(output, &bmf, data, compression)) {
+        return false;
+    }
+
+    snprintf(line, sizeof(line), "Optimize_File: '%s' -> '%s' in %.3f ms\n  %-12s %10s %10s %12s %12s %12s %12s", input,
+        output, (Sys_Microseconds() - start) / 1000.0, "lump", "records", "after", "bytes", "after", "stored", "after");
+    report = line;
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const lump_t *after = &bmf.map.lumps[i];
+
+        snprintf(line, sizeof(line), "\n  %-12s %10lu %10lu %12lu %12lu %12lu %12lu", BMF_LumpName(i), beforeRecords[i],
+            after->uncompressedLength / BMF_LumpRecordSize(i), before[i].uncompressedLength, after->uncompressedLength,
+            before[i].length, after->length);
+        report += line;
+    }
+    Printf("%s", report.c_str());
+
+    return true;
 }
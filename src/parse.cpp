@@ -1,12 +1,13 @@
 #include "gln.h"
 
-static	char	com_token[MAX_TOKEN_CHARS];
-static	char	com_parsename[MAX_TOKEN_CHARS];
-static	uint64_t com_lines;
-static  uint64_t com_tokenline;
+// per thread so that bmfc can parse several maps at once
+static thread_local char com_token[MAX_TOKEN_CHARS];
+static thread_local char com_parsename[MAX_TOKEN_CHARS];
+static thread_local uint64_t com_lines;
+static thread_local uint64_t com_tokenline;
 
 // for complex parser
-tokenType_t		com_tokentype;
+thread_local tokenType_t com_tokentype;
 
 
 void COM_BeginParseSession( const char *name )
@@ -36,7 +37,7 @@ const char *COM_Parse( const char **data_p )
 void COM_ParseError( const char *format, ... )
 {
 	va_list argptr;
-	static char string[4096];
+	static thread_local char string[4096];
 
 	va_start( argptr, format );
 	N_vsnprintf (string, sizeof(string), format, argptr);
@@ -48,7 +49,7 @@ void COM_ParseError( const char *format, ... )
 void COM_ParseWarning( const char *format, ... )
 {
 	va_list argptr;
-	static char string[4096];
+	static thread_local char string[4096];
 
 	va_start( argptr, format );
 	N_vsnprintf (string, sizeof(string), format, argptr);
@@ -41,7 +41,7 @@ typedef enum {
 	TK_EOF,
 } tokenType_t;
 
-extern tokenType_t com_tokentype;
+extern thread_local tokenType_t com_tokentype;
 
 #define MAX_TOKENLENGTH		1024
 
@@ -0,0 +1,334 @@
+#include "gln.h"
+#include <atomic>
+#include <algorithm>
+
+/*
+profileThread_t: a ring buffer of the scopes one thread has finished. Only the owning thread writes to it,
+readers copy out everything but the oldest slice so that a scope being written over isn't picked up.
+*/
+typedef struct {
+    char name[64];
+    uint32_t id;
+    bool inUse;
+    uint32_t depth;
+    std::atomic<uint64_t> head;
+    profileEvent_t events[PROFILE_MAX_EVENTS];
+} profileThread_t;
+
+#define PROFILE_READ_MARGIN 1024 // events left alone at the tail of the ring while reading
+
+static std::vector<profileThread_t *> profileThreads;
+static boost::mutex profileLock;
+
+static uint64_t frameStarts[PROFILE_MAX_FRAMES];
+static uint64_t frameTimes[PROFILE_MAX_FRAMES];
+static uint64_t frameCount;
+
+/*
+profileThreadRef_t: gives the thread's buffer back when it exits so that the next thread with the same name
+ends up on the same track, the job system spawns its workers for every dispatch
+*/
+typedef struct profileThreadRef_s {
+    profileThread_t *thread = NULL;
+
+    ~profileThreadRef_s()
+    {
+        if (thread) {
+            boost::lock_guard<boost::mutex> lock{ profileLock };
+            thread->inUse = false;
+        }
+    }
+} profileThreadRef_t;
+
+static thread_local profileThreadRef_t threadRef;
+
+/*
+Profile_AcquireThread: hands out the free buffer with the given name or makes a new one, a NULL name gets a new
+buffer named after its id
+*/
+static profileThread_t *Profile_AcquireThread(const char *name)
+{
+    boost::lock_guard<boost::mutex> lock{ profileLock };
+    profileThread_t *thread;
+
+    for (auto& it : profileThreads) {
+        if (name && !it->inUse && !N_stricmp(it->name, name)) {
+            it->inUse = true;
+            return it;
+        }
+    }
+
+    thread = new profileThread_t;
+    if (name) {
+        N_strncpyz(thread->name, name, sizeof(thread->name));
+    }
+    else {
+        snprintf(thread->name, sizeof(thread->name), "Thread %lu", profileThreads.size() + 1);
+    }
+    thread->id = profileThreads.size() + 1;
+    thread->inUse = true;
+    thread->depth = 0;
+    thread->head = 0;
+    profileThreads.emplace_back(thread);
+
+    return thread;
+}
+
+/*
+Profile_SetThreadName: puts the calling thread on the track with the given name
+*/
+void Profile_SetThreadName(const char *name)
+{
+    if (threadRef.thread) {
+        if (!N_stricmp(threadRef.thread->name, name)) {
+            return;
+        }
+        boost::lock_guard<boost::mutex> lock{ profileLock };
+        threadRef.thread->inUse = false;
+    }
+    threadRef.thread = Profile_AcquireThread(name);
+}
+
+static INLINE profileThread_t *Profile_GetThread(void)
+{
+    if (!threadRef.thread) {
+        threadRef.thread = Profile_AcquireThread(NULL);
+    }
+    return threadRef.thread;
+}
+
+uint64_t Profile_Begin(void)
+{
+    Profile_GetThread()->depth++;
+    return Sys_Microseconds();
+}
+
+void Profile_End(const char *name, uint64_t start)
+{
+    profileThread_t *thread = Profile_GetThread();
+    const uint64_t head = thread->head.load(std::memory_order_relaxed);
+    profileEvent_t *e = &thread->events[head % PROFILE_MAX_EVENTS];
+
+    e->name = name;
+    e->start = start;
+    e->end = Sys_Microseconds();
+    e->depth = --thread->depth;
+
+    thread->head.store(head + 1, std::memory_order_release);
+}
+
+/*
+Profile_BeginFrame: marks the start of a new frame on the main thread
+*/
+void Profile_BeginFrame(void)
+{
+    const uint64_t now = Sys_Microseconds();
+
+    if (frameCount) {
+        frameTimes[(frameCount - 1) % PROFILE_MAX_FRAMES] = now - frameStarts[(frameCount - 1) % PROFILE_MAX_FRAMES];
+    }
+    frameStarts[frameCount % PROFILE_MAX_FRAMES] = now;
+    frameCount++;
+}
+
+/*
+Profile_FrameStart: returns the start time of the frame numFrames frames back, or 0 if there isn't one that old
+*/
+static uint64_t Profile_FrameStart(uint32_t numFrames)
+{
+    numFrames = std::min(numFrames, (uint32_t)PROFILE_MAX_FRAMES);
+    if (numFrames > frameCount) {
+        return 0;
+    }
+    return frameStarts[(frameCount - numFrames) % PROFILE_MAX_FRAMES];
+}
+
+static void Profile_CopyEvents(const profileThread_t *thread, uint64_t since, std::vector<profileEvent_t>& events)
+{
+    const uint64_t head = thread->head.load(std::memory_order_acquire);
+    const uint64_t count = std::min(head, (uint64_t)(PROFILE_MAX_EVENTS - PROFILE_READ_MARGIN));
+
+    for (uint64_t i = head - count; i < head; i++) {
+        const profileEvent_t *e = &thread->events[i % PROFILE_MAX_EVENTS];
+
+        if (e->start >= since) {
+            events.emplace_back(*e);
+        }
+    }
+}
+
+static void Profile_WriteString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            fputc('\\', fp);
+        }
+        fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+Profile_WriteTrace: dumps the scopes of the last numFrames frames from every thread in the chrome trace_event format,
+it can be opened with chrome://tracing or ui.perfetto.dev
+*/
+bool Profile_WriteTrace(const char *path, uint32_t numFrames)
+{
+    std::vector<profileEvent_t> events;
+    std::vector<profileThread_t *> threads;
+    const uint64_t since = Profile_FrameStart(numFrames);
+    uint64_t numEvents;
+    FILE *fp;
+    bool first;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        Printf("Profile_WriteTrace: failed to open '%s' in write mode", path);
+        return false;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock{ profileLock };
+        threads = profileThreads;
+    }
+
+    numEvents = 0;
+    first = true;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (const auto& thread : threads) {
+        fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+        Profile_WriteString(fp, thread->name);
+        fprintf(fp, "}}");
+        first = false;
+
+        events.clear();
+        Profile_CopyEvents(thread, since, events);
+        for (const auto& it : events) {
+            fprintf(fp, ",\n{\"ph\":\"X\",\"name\":");
+            Profile_WriteString(fp, it.name);
+            fprintf(fp, ",\"pid\":1,\"tid\":%u,\"ts\":%lu,\"dur\":%lu}", thread->id, it.start, it.end - it.start);
+        }
+        numEvents += events.size();
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    Printf("Profile_WriteTrace: wrote %lu events from %lu threads to '%s'", numEvents, threads.size(), path);
+
+    return true;
+}
+
+#ifndef BMFC
+#define PROFILE_GRAPH_FRAMES 256
+#define PROFILE_TOP_SCOPES 16
+#define PROFILE_TOP_FRAMES 60
+
+/*
+Profile_DrawOverlay: a rolling graph of the frame times and the main thread's most expensive scopes, times
+include the scopes nested inside
+*/
+void Profile_DrawOverlay(bool *open)
+{
+    static std::vector<profileEvent_t> events;
+    std::unordered_map<std::string_view, std::pair<uint64_t, uint64_t>> totals;
+    std::vector<std::pair<std::string_view, std::pair<uint64_t, uint64_t>>> scopes;
+    float graph[PROFILE_GRAPH_FRAMES];
+    uint32_t numGraph, numFrames;
+    float maxTime, avgTime;
+    profileThread_t *thread;
+
+    if (!*open) {
+        return;
+    }
+    if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::End();
+        return;
+    }
+
+    // the frame that's in progress doesn't have a time yet
+    numGraph = frameCount ? std::min(frameCount - 1, (uint64_t)PROFILE_GRAPH_FRAMES) : 0;
+    maxTime = avgTime = 0.0f;
+    for (uint32_t i = 0; i < numGraph; i++) {
+        graph[i] = frameTimes[(frameCount - 1 - numGraph + i) % PROFILE_MAX_FRAMES] / 1000.0f;
+        maxTime = std::max(maxTime, graph[i]);
+        avgTime += graph[i];
+    }
+    if (numGraph) {
+        avgTime /= numGraph;
+    }
+
+    ImGui::Text("frame: %.3f ms avg, %.3f ms max over %u frames", avgTime, maxTime, numGraph);
+    ImGui::PlotLines("##FrameTimes", graph, numGraph, 0, NULL, 0.0f, std::max(maxTime, 16.6f), ImVec2(400, 80));
+
+    // the overlay is drawn from the main thread, so its own track is the one to look at
+    thread = Profile_GetThread();
+    numFrames = std::min((uint64_t)PROFILE_TOP_FRAMES, frameCount ? frameCount - 1 : 0);
+
+    events.clear();
+    if (numFrames) {
+        const uint64_t since = Profile_FrameStart(numFrames + 1);
+        const uint64_t until = Profile_FrameStart(1);
+
+        Profile_CopyEvents(thread, since, events);
+        for (const auto& it : events) {
+            if (it.end > until) {
+                continue; // part of the current frame
+            }
+            auto& total = totals[it.name];
+            total.first += it.end - it.start;
+            total.second++;
+        }
+    }
+    scopes.assign(totals.begin(), totals.end());
+    std::sort(scopes.begin(), scopes.end(), [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+
+    ImGui::SeparatorText("Top Scopes");
+    if (ImGui::BeginTable("##ProfileScopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("ms/frame");
+        ImGui::TableSetupColumn("calls/frame");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < scopes.size() && i < PROFILE_TOP_SCOPES; i++) {
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(scopes[i].first.data(), scopes[i].first.data() + scopes[i].first.size());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", scopes[i].second.first / 1000.0 / numFrames);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", (double)scopes[i].second.second / numFrames);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+static void ProfileDump_f(void)
+{
+    uint32_t numFrames;
+    const char *path;
+
+    if (Argc() > 3) {
+        Printf("usage: profileDump [frames] [path]");
+        return;
+    }
+
+    numFrames = Argc() > 1 ? atoi(Argv(1)) : 120;
+    path = Argc() > 2 ? Argv(2) : "profile_trace.json";
+    if (!numFrames || numFrames >= PROFILE_MAX_FRAMES) {
+        Printf("profileDump: frames must be between 1 and %u", PROFILE_MAX_FRAMES - 1);
+        return;
+    }
+
+    Profile_WriteTrace(path, numFrames);
+}
+#endif
+
+void Profile_Init(void)
+{
+    Profile_SetThreadName("Main");
+#ifndef BMFC
+    Cmd_AddCommand("profileDump", ProfileDump_f);
+#endif
+}
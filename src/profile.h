@@ -0,0 +1,47 @@
+#ifndef __PROFILE__
+#define __PROFILE__
+
+#pragma once
+
+#define PROFILE_MAX_EVENTS 16384 // per thread, the oldest ones get overwritten
+#define PROFILE_MAX_FRAMES 512
+
+typedef struct {
+    const char *name; // has to outlive the profiler, a string literal or __func__
+    uint64_t start;
+    uint64_t end;
+    uint32_t depth;
+} profileEvent_t;
+
+void Profile_Init(void);
+void Profile_SetThreadName(const char *name);
+void Profile_BeginFrame(void);
+uint64_t Profile_Begin(void);
+void Profile_End(const char *name, uint64_t start);
+bool Profile_WriteTrace(const char *path, uint32_t numFrames);
+#ifndef BMFC
+void Profile_DrawOverlay(bool *open);
+#endif
+
+/*
+CProfileScope: times everything until the end of the enclosing block, use PROFILE_SCOPE instead of this directly
+*/
+class CProfileScope
+{
+public:
+    INLINE CProfileScope(const char *name)
+        : mName{ name }, mStart{ Profile_Begin() }
+    { }
+    INLINE ~CProfileScope()
+    { Profile_End(mName, mStart); }
+private:
+    const char *mName;
+    uint64_t mStart;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) CProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNC() PROFILE_SCOPE(__func__)
+
+#endif
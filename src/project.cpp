@@ -1,4 +1,5 @@
 #include "gln.h"
+#include <filesystem>
 
 std::unique_ptr<CProject> project = std::make_unique<CProject>();
 
@@ -76,6 +77,7 @@ static bool ValidateProject(const json& data)
 
 void Project_Load(const char *filename)
 {
+    PROFILE_FUNC();
     json data;
 
     if (!LoadJSON(data, filename)) {
@@ -108,11 +110,38 @@ void Project_Load(const char *filename)
         memcpy(t->texcoords, texcoords.data(), sizeof(t->texcoords));
     }
 
-    project->texData->Load(data["tileset"]["texFile"]);
+    project->texData->Load(data["tileset"]["texFile"], Tileset_TextureReady);
 
     Map_Load(data["mapName"].get<std::string>().c_str());
 }
 
+/*
+Project_FileChanged: hot reloads whatever the project uses out of a file that changed on disk, textures come back
+through the async loader and the map through Map_Reload, so nothing else gets reloaded with it
+*/
+void Project_FileChanged(const std::string& path, uint32_t flags)
+{
+    const std::shared_ptr<CTileset>& tileset = project->tileset;
+    std::error_code err;
+
+    // a burst that ended with the file gone leaves whatever is loaded alone
+    if (!(flags & WATCH_MODIFIED) || !std::filesystem::exists(path, err)) {
+        return;
+    }
+
+    if (Watch_SamePath(path, tileset->texData->mName)) {
+        Printf("Project_FileChanged: reloading tileset texture '%s'", tileset->texData->mName.c_str());
+        tileset->texData->Load(tileset->texData->mName, Tileset_TextureReady);
+    }
+    if (Watch_SamePath(path, tileset->normalData->mName)) {
+        Printf("Project_FileChanged: reloading normal map '%s'", tileset->normalData->mName.c_str());
+        tileset->normalData->Load(tileset->normalData->mName);
+    }
+    if (Watch_SamePath(path, mapData->mPath)) {
+        Map_Reload();
+    }
+}
+
 CProject::CProject(void)
 {
     tileset = std::make_shared<CTileset>();
@@ -23,5 +23,6 @@ extern std::unique_ptr<CProject> project;
 void Project_New(void);
 void Project_Save(const char *filename);
 void Project_Load(const char *filename);
+void Project_FileChanged(const std::string& path, uint32_t flags);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,260 @@
+// sector.cpp: splits a compiled .bmf into sectors that can be streamed in one at a time
+
+#include "gln.h"
+#include <algorithm>
+
+#define MIN_SECTOR_SIZE 8 // smaller ones would be more padding than level
+
+// the lumps that every sector gets its own part of
+static const int sectorLumps[] = { LUMP_TILES, LUMP_CHECKPOINTS, LUMP_SPAWNS, LUMP_LIGHTS, LUMP_VERTICES, LUMP_INDICES };
+
+/*
+bmfcSector_t: a sector's records while they're being sorted out
+*/
+typedef struct {
+    mapsector_t info;
+    std::vector<maptile_t> tiles;
+    std::vector<mapcheckpoint_t> checkpoints;
+    std::vector<mapspawn_t> spawns;
+    std::vector<maplight_t> lights;
+    std::vector<uint32_t> triangles; // the first index of each of its triangles in the whole level's indices
+    std::vector<mapdrawvert_t> vertices;
+    std::vector<uint32_t> indices;
+} bmfcSector_t;
+
+static void Sector_AddBounds(mapsector_t *info, float minX, float minY, float maxX, float maxY)
+{
+    info->boundsMins[0] = std::min(info->boundsMins[0], minX);
+    info->boundsMins[1] = std::min(info->boundsMins[1], minY);
+    info->boundsMaxs[0] = std::max(info->boundsMaxs[0], maxX);
+    info->boundsMaxs[1] = std::max(info->boundsMaxs[1], maxY);
+}
+
+/*
+Sector_WriteFile: rewrites a compiled level split into sectors of sectorSize tiles a side. Tiles, checkpoints, spawns
+and lights go to the sector they're in and every triangle to the one its center is in, each sector gets its own
+copy of the vertices it uses. input and output can be the same file.
+*/
+bool Sector_WriteFile(const char *input, const char *output, uint32_t sectorSize, int compression)
+{
+    static const byte padding[BMF_SECTOR_ALIGN] = { 0 };
+    const uint64_t start = Sys_Microseconds();
+    std::vector<std::vector<byte>> lumps;
+    std::vector<bmfcSector_t> sectors;
+    std::vector<maptile_t> tiles;
+    std::vector<mapcheckpoint_t> checkpoints;
+    std::vector<mapspawn_t> spawns;
+    std::vector<maplight_t> lights;
+    std::vector<mapdrawvert_t> vertices;
+    std::vector<uint32_t> indices, stamp, local;
+    uint32_t width, height, sectorsX, sectorsY, numSectors;
+    uint64_t length, largest, pos;
+    bmfLumpData_t data;
+    bmfFile_t file;
+    bmf_t bmf;
+    FILE *fp;
+
+    if (sectorSize < MIN_SECTOR_SIZE) {
+        Printf("Sector_WriteFile: sectors have to be at least %u tiles a side", MIN_SECTOR_SIZE);
+        return false;
+    }
+    if (!BMF_Open(input, &file)) {
+        Printf("Sector_WriteFile: failed to load '%s'", input);
+        return false;
+    }
+    bmf = file.header;
+    if (bmf.map.lumps[LUMP_SECTORS].uncompressedLength) {
+        Printf("Sector_WriteFile: '%s' is already split into sectors", input);
+        BMF_Close(&file);
+        return false;
+    }
+
+    // everything is copied out so that the file can be written over
+    lumps.resize(NUMLUMPS);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        const byte *lump = (const byte *)BMF_GetLump(&file, i, &length);
+
+        if (bmf.map.lumps[i].uncompressedLength && !lump) {
+            Printf("Sector_WriteFile: failed to load the %s lump of '%s'", BMF_LumpName(i), input);
+            BMF_Close(&file);
+            return false;
+        }
+        lumps[i].assign(lump, lump + length);
+    }
+    {
+        const bmfSpan_t<maptile_t> t = BMF_GetRecords<maptile_t>(&file, LUMP_TILES);
+        const bmfSpan_t<mapcheckpoint_t> c = BMF_GetRecords<mapcheckpoint_t>(&file, LUMP_CHECKPOINTS);
+        const bmfSpan_t<mapspawn_t> s = BMF_GetRecords<mapspawn_t>(&file, LUMP_SPAWNS);
+        const bmfSpan_t<maplight_t> l = BMF_GetRecords<maplight_t>(&file, LUMP_LIGHTS);
+        const bmfSpan_t<mapdrawvert_t> v = BMF_GetRecords<mapdrawvert_t>(&file, LUMP_VERTICES);
+        const bmfSpan_t<uint32_t> n = BMF_GetRecords<uint32_t>(&file, LUMP_INDICES);
+
+        tiles.assign(t.begin(), t.end());
+        checkpoints.assign(c.begin(), c.end());
+        spawns.assign(s.begin(), s.end());
+        lights.assign(l.begin(), l.end());
+        vertices.assign(v.begin(), v.end());
+        indices.assign(n.begin(), n.end());
+    }
+    BMF_Close(&file);
+
+    // the level doesn't store its size, but everything in it has a place
+    width = height = 1;
+    for (const auto& it : tiles) {
+        width = std::max(width, it.pos[0] + 1);
+        height = std::max(height, it.pos[1] + 1);
+    }
+    for (const auto& it : vertices) {
+        width = std::max(width, (uint32_t)std::max(it.xyz[0], 0.0f));
+        height = std::max(height, (uint32_t)std::max(it.xyz[1], 0.0f));
+    }
+
+    sectorsX = (width + sectorSize - 1) / sectorSize;
+    sectorsY = (height + sectorSize - 1) / sectorSize;
+    numSectors = sectorsX * sectorsY;
+    sectors.resize(numSectors);
+    for (uint32_t y = 0; y < sectorsY; y++) {
+        for (uint32_t x = 0; x < sectorsX; x++) {
+            mapsector_t *info = &sectors[y * sectorsX + x].info;
+
+            memset(info, 0, sizeof(*info));
+            info->mins[0] = x * sectorSize;
+            info->mins[1] = y * sectorSize;
+            info->maxs[0] = std::min((x + 1) * sectorSize, width);
+            info->maxs[1] = std::min((y + 1) * sectorSize, height);
+            info->boundsMins[0] = info->mins[0];
+            info->boundsMins[1] = info->mins[1];
+            info->boundsMaxs[0] = info->maxs[0];
+            info->boundsMaxs[1] = info->maxs[1];
+        }
+    }
+
+    const auto sectorAt = [&](float x, float y) -> bmfcSector_t * {
+        const uint32_t sx = std::min((uint32_t)std::max(x, 0.0f) / sectorSize, sectorsX - 1);
+        const uint32_t sy = std::min((uint32_t)std::max(y, 0.0f) / sectorSize, sectorsY - 1);
+        return &sectors[sy * sectorsX + sx];
+    };
+
+    for (const auto& it : tiles) {
+        sectorAt(it.pos[0], it.pos[1])->tiles.emplace_back(it);
+    }
+    for (const auto& it : checkpoints) {
+        sectorAt(it.xyz[0], it.xyz[1])->checkpoints.emplace_back(it);
+    }
+    for (const auto& it : spawns) {
+        sectorAt(it.xyz[0], it.xyz[1])->spawns.emplace_back(it);
+    }
+    for (const auto& it : lights) {
+        bmfcSector_t *sector = sectorAt(it.origin[0], it.origin[1]);
+
+        sector->lights.emplace_back(it);
+        Sector_AddBounds(&sector->info, it.origin[0] - it.range, it.origin[1] - it.range, it.origin[0] + it.range,
+            it.origin[1] + it.range);
+    }
+    for (uint64_t i = 0; i + 2 < indices.size(); i += 3) {
+        const mapdrawvert_t *v[3];
+
+        for (uint32_t j = 0; j < 3; j++) {
+            if (indices[i + j] >= vertices.size()) {
+                Printf("Sector_WriteFile: index %u out of %lu vertices", indices[i + j], vertices.size());
+                return false;
+            }
+            v[j] = &vertices[indices[i + j]];
+        }
+        bmfcSector_t *sector = sectorAt((v[0]->xyz[0] + v[1]->xyz[0] + v[2]->xyz[0]) / 3.0f,
+            (v[0]->xyz[1] + v[1]->xyz[1] + v[2]->xyz[1]) / 3.0f);
+
+        sector->triangles.emplace_back(i);
+        Sector_AddBounds(&sector->info, std::min({ v[0]->xyz[0], v[1]->xyz[0], v[2]->xyz[0] }),
+            std::min({ v[0]->xyz[1], v[1]->xyz[1], v[2]->xyz[1] }), std::max({ v[0]->xyz[0], v[1]->xyz[0], v[2]->xyz[0] }),
+            std::max({ v[0]->xyz[1], v[1]->xyz[1], v[2]->xyz[1] }));
+    }
+
+    // each sector numbers the vertices it uses from 0, in the order it first uses them
+    stamp.assign(vertices.size(), UINT32_MAX);
+    local.resize(vertices.size());
+    for (uint32_t s = 0; s < numSectors; s++) {
+        bmfcSector_t *sector = &sectors[s];
+
+        sector->indices.reserve(sector->triangles.size() * 3);
+        for (const auto& it : sector->triangles) {
+            for (uint32_t j = 0; j < 3; j++) {
+                const uint32_t index = indices[it + j];
+
+                if (stamp[index] != s) {
+                    stamp[index] = s;
+                    local[index] = sector->vertices.size();
+                    sector->vertices.emplace_back(vertices[index]);
+                }
+                sector->indices.emplace_back(local[index]);
+            }
+        }
+        sector->triangles.clear();
+        sector->triangles.shrink_to_fit();
+    }
+
+    fp = fopen(output, "wb");
+    if (!fp) {
+        Printf("Sector_WriteFile: failed to open '%s' in write mode", output);
+        return false;
+    }
+
+    // the lumps that aren't split up, with room for the sector list
+    fseeko64(fp, BMF_HEADER_SIZE, SEEK_SET);
+    for (uint32_t i = 0; i < NUMLUMPS; i++) {
+        lump_t *lump = &bmf.map.lumps[i];
+
+        if (std::find(std::begin(sectorLumps), std::end(sectorLumps), i) != std::end(sectorLumps)) {
+            data = { NULL, 0, lump->flags };
+        }
+        else if (i == LUMP_SECTORS) {
+            lumps[i].assign(sizeof(mapsector_t) * numSectors, 0);
+            data = { lumps[i].data(), lumps[i].size(), 0 };
+            BMF_WriteLump(fp, lump, &data, COMPRESS_NONE);
+            continue;
+        }
+        else {
+            data = { lumps[i].data(), lumps[i].size(), lump->flags };
+        }
+        BMF_WriteLump(fp, lump, &data, compression);
+    }
+
+    largest = 0;
+    for (auto& it : sectors) {
+        const bmfLumpData_t parts[] = {
+            { it.tiles.data(), sizeof(maptile_t) * it.tiles.size(), bmf.map.lumps[LUMP_TILES].flags },
+            { it.checkpoints.data(), sizeof(mapcheckpoint_t) * it.checkpoints.size(), bmf.map.lumps[LUMP_CHECKPOINTS].flags },
+            { it.spawns.data(), sizeof(mapspawn_t) * it.spawns.size(), bmf.map.lumps[LUMP_SPAWNS].flags },
+            { it.lights.data(), sizeof(maplight_t) * it.lights.size(), bmf.map.lumps[LUMP_LIGHTS].flags },
+            { it.vertices.data(), sizeof(mapdrawvert_t) * it.vertices.size(), bmf.map.lumps[LUMP_VERTICES].flags },
+            { it.indices.data(), sizeof(uint32_t) * it.indices.size(), bmf.map.lumps[LUMP_INDICES].flags },
+        };
+
+        pos = ftello64(fp);
+        if (pos % BMF_SECTOR_ALIGN) {
+            SafeWrite(padding, BMF_SECTOR_ALIGN - pos % BMF_SECTOR_ALIGN, fp);
+        }
+        it.info.fileofs = ftello64(fp);
+        for (uint32_t i = 0; i < arraylen(sectorLumps); i++) {
+            BMF_WriteLump(fp, &it.info.lumps[sectorLumps[i]], &parts[i], compression);
+        }
+        pos = ftello64(fp);
+        if (pos % BMF_SECTOR_ALIGN) {
+            SafeWrite(padding, BMF_SECTOR_ALIGN - pos % BMF_SECTOR_ALIGN, fp);
+        }
+        it.info.length = ftello64(fp) - it.info.fileofs;
+        largest = std::max(largest, it.info.length);
+
+        memcpy(lumps[LUMP_SECTORS].data() + sizeof(mapsector_t) * (&it - sectors.data()), &it.info, sizeof(it.info));
+    }
+
+    fseeko64(fp, bmf.map.lumps[LUMP_SECTORS].fileofs, SEEK_SET);
+    SafeWrite(lumps[LUMP_SECTORS].data(), lumps[LUMP_SECTORS].size(), fp);
+    BMF_WriteHeader(fp, &bmf);
+    fclose(fp);
+
+    Printf("Sector_WriteFile: '%s' -> '%s' in %ux%u sectors of %u tiles, up to %lu bytes each, in %.3f ms", input,
+        output, sectorsX, sectorsY, sectorSize, largest, (Sys_Microseconds() - start) / 1000.0);
+
+    return true;
+}
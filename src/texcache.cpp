@@ -0,0 +1,337 @@
+#include "gln.h"
+#include <zlib.h>
+#include <filesystem>
+
+#ifndef GL_RGB8
+#define GL_RGB8 0x8051
+#define GL_RGBA8 0x8058
+#endif
+
+typedef struct {
+    uint64_t size;
+    uint64_t lastUse; // higher is more recent
+} texCacheEntry_t;
+
+/*
+everything in here is guarded by cacheLock, loads and stores come from the async workers
+*/
+static boost::mutex cacheLock;
+static std::unordered_map<uint64_t, texCacheEntry_t> cacheEntries;
+static std::string cachePath;
+static texCacheStats_t cacheStats;
+static uint64_t cacheClock;
+
+static std::string TexCache_FilePath(uint64_t hash)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), "%016lx" TEXTURE_FILE_EXT, hash);
+    return cachePath + name;
+}
+
+/*
+TexCache_Evict: drops the least recently used entries until the cache fits in its budget again, cacheLock has to be held
+*/
+static void TexCache_Evict(void)
+{
+    std::error_code err;
+
+    while (cacheStats.totalSize > cacheStats.maxSize && !cacheEntries.empty()) {
+        auto oldest = cacheEntries.begin();
+
+        for (auto it = cacheEntries.begin(); it != cacheEntries.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+
+        std::filesystem::remove(TexCache_FilePath(oldest->first), err);
+        cacheStats.totalSize -= oldest->second.size;
+        cacheStats.evictions++;
+        cacheEntries.erase(oldest);
+    }
+    cacheStats.numEntries = cacheEntries.size();
+}
+
+#ifndef BMFC
+static void TexCacheInfo_f(void)
+{
+    texCacheStats_t stats;
+
+    TexCache_GetStats(&stats);
+    Printf("texture cache '%s':", cachePath.c_str());
+    Printf("  %lu entries, %.2f of %.2f MiB used", stats.numEntries, stats.totalSize / (1024.0 * 1024.0), stats.maxSize / (1024.0 * 1024.0));
+    Printf("  %lu hits, %lu misses, %lu evictions this session", stats.hits, stats.misses, stats.evictions);
+}
+
+static void TexCacheClear_f(void)
+{
+    TexCache_Clear();
+    Printf("texture cache cleared");
+}
+
+static void TexCacheSize_f(void)
+{
+    if (Argc() != 2) {
+        Printf("usage: texCacheSize <megabytes>");
+        return;
+    }
+    TexCache_SetMaxSize((uint64_t)atoi(Argv(1)) * 1024 * 1024);
+}
+#endif
+
+/*
+TexCache_Init: picks up whatever is already in the cache directory, the modification times of the files are the
+recency from older sessions
+*/
+void TexCache_Init(const char *path, uint64_t maxSize)
+{
+    std::vector<std::pair<std::filesystem::file_time_type, std::pair<uint64_t, uint64_t>>> found;
+    std::error_code err;
+
+    boost::lock_guard<boost::mutex> lock{ cacheLock };
+
+    cachePath = path;
+    if (cachePath.size() && cachePath.back() != PATH_SEP) {
+        cachePath.push_back(PATH_SEP);
+    }
+    cacheEntries.clear();
+    memset(&cacheStats, 0, sizeof(cacheStats));
+    cacheStats.maxSize = maxSize;
+    cacheClock = 0;
+
+    std::filesystem::create_directories(cachePath, err);
+    if (err) {
+        Printf("TexCache_Init: failed to create cache directory '%s', %s", cachePath.c_str(), err.message().c_str());
+        return;
+    }
+
+    for (const auto& it : std::filesystem::directory_iterator{ cachePath, err }) {
+        const std::string name = it.path().filename().string();
+        char *end;
+        uint64_t hash;
+
+        if (!it.is_regular_file() || it.path().extension() != TEXTURE_FILE_EXT) {
+            continue;
+        }
+        hash = strtoull(name.c_str(), &end, 16);
+        if (*end != '.') {
+            continue;
+        }
+        found.push_back({ it.last_write_time(), { hash, it.file_size() } });
+    }
+
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& it : found) {
+        cacheEntries[it.second.first] = { it.second.second, ++cacheClock };
+        cacheStats.totalSize += it.second.second;
+    }
+    TexCache_Evict();
+
+#ifndef BMFC
+    static bool registered = false;
+    if (!registered) {
+        Cmd_AddCommand("texCacheInfo", TexCacheInfo_f);
+        Cmd_AddCommand("texCacheClear", TexCacheClear_f);
+        Cmd_AddCommand("texCacheSize", TexCacheSize_f);
+        registered = true;
+    }
+#endif
+
+    Printf("TexCache_Init: %lu cached textures, %lu of %lu bytes used in '%s'", cacheStats.numEntries, cacheStats.totalSize,
+        cacheStats.maxSize, cachePath.c_str());
+}
+
+void TexCache_SetMaxSize(uint64_t maxSize)
+{
+    boost::lock_guard<boost::mutex> lock{ cacheLock };
+
+    cacheStats.maxSize = maxSize;
+    TexCache_Evict();
+}
+
+void TexCache_Clear(void)
+{
+    boost::lock_guard<boost::mutex> lock{ cacheLock };
+    std::error_code err;
+
+    for (const auto& it : cacheEntries) {
+        std::filesystem::remove(TexCache_FilePath(it.first), err);
+    }
+    cacheEntries.clear();
+    cacheStats.totalSize = 0;
+    cacheStats.numEntries = 0;
+}
+
+void TexCache_GetStats(texCacheStats_t *stats)
+{
+    boost::lock_guard<boost::mutex> lock{ cacheLock };
+    *stats = cacheStats;
+}
+
+/*
+TexCache_Load: returns the decoded pixels of the image with the given content hash, or NULL if they aren't cached.
+The file is mapped in and inflated straight into the returned buffer, which is freed with FreeMemory.
+*/
+byte *TexCache_Load(uint64_t hash, uint64_t fileSize, uint32_t *width, uint32_t *height, uint32_t *channels)
+{
+    PROFILE_FUNC();
+    const tex2d_t *header;
+    const byte *data;
+    std::error_code err;
+    std::string path;
+    uint64_t length = 0, size;
+    uLongf outLen;
+    byte *pixels;
+
+    {
+        boost::lock_guard<boost::mutex> lock{ cacheLock };
+
+        auto it = cacheEntries.find(hash);
+        if (cachePath.empty() || it == cacheEntries.end()) {
+            cacheStats.misses++;
+            return NULL;
+        }
+        it->second.lastUse = ++cacheClock;
+        path = TexCache_FilePath(hash);
+    }
+
+    pixels = NULL;
+    data = (const byte *)Sys_MapFile(path.c_str(), &length);
+    if (!data) {
+        goto failed;
+    }
+
+    header = (const tex2d_t *)data;
+    size = length >= sizeof(*header) ? (uint64_t)header->width * header->height * header->channels : 0;
+    if (length < sizeof(*header) || header->ident != TEX2D_IDENT || header->version != TEX2D_VERSION
+        || header->fileSize != fileSize || (header->channels != 3 && header->channels != 4)
+        || header->compressedSize > length - sizeof(*header)) {
+        goto failed;
+    }
+
+    pixels = (byte *)GetMemory(size);
+    if (header->compression == COMPRESS_NONE) {
+        if (header->compressedSize != size) {
+            goto failed;
+        }
+        memcpy(pixels, data + sizeof(*header), size);
+    }
+    else if (header->compression == COMPRESS_ZLIB) {
+        outLen = size;
+        if (uncompress(pixels, &outLen, data + sizeof(*header), header->compressedSize) != Z_OK || outLen != size) {
+            goto failed;
+        }
+    }
+    else {
+        goto failed;
+    }
+
+    *width = header->width;
+    *height = header->height;
+    *channels = header->channels;
+    Sys_UnmapFile(data, length);
+
+    {
+        boost::lock_guard<boost::mutex> lock{ cacheLock };
+        cacheStats.hits++;
+    }
+
+    // keeps the recency around for the next session
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), err);
+
+    return pixels;
+
+failed:
+    // a stale or broken entry, it gets replaced by the next store
+    if (pixels) {
+        FreeMemory(pixels);
+    }
+    Sys_UnmapFile(data, length);
+    {
+        boost::lock_guard<boost::mutex> lock{ cacheLock };
+        auto it = cacheEntries.find(hash);
+        if (it != cacheEntries.end()) {
+            std::filesystem::remove(path, err);
+            cacheStats.totalSize -= it->second.size;
+            cacheEntries.erase(it);
+            cacheStats.numEntries = cacheEntries.size();
+        }
+        cacheStats.misses++;
+    }
+    return NULL;
+}
+
+/*
+TexCache_Store: compresses the pixels with zlib's fastest level (or not at all if that doesn't save anything) and
+writes them out under the content hash, the file is written under a temporary name first so a half written entry is
+never picked up
+*/
+void TexCache_Store(uint64_t hash, uint64_t fileSize, const char *name, const byte *pixels, uint32_t width, uint32_t height,
+    uint32_t channels)
+{
+    PROFILE_FUNC();
+    const uint64_t size = (uint64_t)width * height * channels;
+    std::string path, tmpPath;
+    std::error_code err;
+    tex2d_t header;
+    uLongf outLen;
+    byte *out;
+    FILE *fp;
+    bool ok;
+
+    {
+        boost::lock_guard<boost::mutex> lock{ cacheLock };
+        if (cachePath.empty() || cacheEntries.count(hash) || size + sizeof(header) > cacheStats.maxSize) {
+            return;
+        }
+        path = TexCache_FilePath(hash);
+        tmpPath = path + ".tmp" + std::to_string(++cacheClock);
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.ident = TEX2D_IDENT;
+    header.version = TEX2D_VERSION;
+    N_strncpyz(header.name, name, sizeof(header.name));
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.format = channels == 4 ? GL_RGBA8 : GL_RGB8;
+    header.fileSize = fileSize;
+
+    outLen = compressBound(size);
+    out = (byte *)GetMemory(outLen);
+    if (compress2(out, &outLen, pixels, size, Z_BEST_SPEED) == Z_OK && outLen < size - size / 8) {
+        header.compression = COMPRESS_ZLIB;
+        header.compressedSize = outLen;
+    }
+    else {
+        header.compression = COMPRESS_NONE;
+        header.compressedSize = size;
+    }
+
+    fp = fopen(tmpPath.c_str(), "wb");
+    ok = fp != NULL;
+    if (fp) {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(header.compression == COMPRESS_NONE ? pixels : out, header.compressedSize, 1, fp) == 1;
+        ok = !fclose(fp) && ok;
+    }
+    FreeMemory(out);
+
+    if (ok) {
+        std::filesystem::rename(tmpPath, path, err);
+        ok = !err;
+    }
+    if (!ok) {
+        std::filesystem::remove(tmpPath, err);
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock{ cacheLock };
+    if (!cacheEntries.count(hash)) {
+        cacheEntries[hash] = { sizeof(header) + header.compressedSize, ++cacheClock };
+        cacheStats.totalSize += sizeof(header) + header.compressedSize;
+    }
+    TexCache_Evict();
+}
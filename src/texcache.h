@@ -0,0 +1,31 @@
+#ifndef __TEXCACHE__
+#define __TEXCACHE__
+
+#pragma once
+
+/*
+decoded images kept on disk as tex2d files named after the hash of the source file's contents, so that opening
+the same image again skips the decoder entirely
+*/
+
+#define TEXCACHE_DIR "texcache"
+#define TEXCACHE_DEFAULT_SIZE (256ULL * 1024 * 1024) // bytes on disk before the least recently used entries go
+
+typedef struct {
+    uint64_t numEntries;
+    uint64_t totalSize;
+    uint64_t maxSize;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} texCacheStats_t;
+
+void TexCache_Init(const char *path, uint64_t maxSize = TEXCACHE_DEFAULT_SIZE);
+void TexCache_SetMaxSize(uint64_t maxSize);
+void TexCache_Clear(void);
+void TexCache_GetStats(texCacheStats_t *stats);
+byte *TexCache_Load(uint64_t hash, uint64_t fileSize, uint32_t *width, uint32_t *height, uint32_t *channels);
+void TexCache_Store(uint64_t hash, uint64_t fileSize, const char *name, const byte *pixels, uint32_t width, uint32_t height,
+    uint32_t channels);
+
+#endif
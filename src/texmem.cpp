@@ -0,0 +1,187 @@
+#include "gln.h"
+#include <algorithm>
+
+typedef struct {
+    void *block; // NULL once purged
+    uint64_t size;
+    uint64_t lastUse; // higher is more recent
+    std::string name;
+} texMemBlock_t;
+
+// never destroyed, textures owned by globals still free their blocks on the way out
+static std::unordered_map<void **, texMemBlock_t>& memBlocks = *new std::unordered_map<void **, texMemBlock_t>;
+static texMemStats_t memStats;
+static uint64_t memClock;
+
+/*
+TexMem_Purge: frees the least recently used resident blocks until the budget is met
+*/
+static void TexMem_Purge(void)
+{
+    while (memStats.residentBytes > memStats.budget) {
+        texMemBlock_t *oldest = NULL;
+        void **user = NULL;
+
+        for (auto& it : memBlocks) {
+            if (!it.second.block) {
+                continue;
+            }
+            if (!oldest || it.second.lastUse < oldest->lastUse) {
+                oldest = &it.second;
+                user = it.first;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+
+        FreeMemory(oldest->block);
+        oldest->block = NULL;
+        *user = NULL;
+
+        memStats.residentBytes -= oldest->size;
+        memStats.residentBlocks--;
+        memStats.purgedBytes += oldest->size;
+        memStats.purgedBlocks++;
+        memStats.purges++;
+    }
+}
+
+static void TexMemInfo_f(void)
+{
+    std::vector<const texMemBlock_t *> blocks;
+    texMemStats_t stats;
+
+    TexMem_GetStats(&stats);
+    Printf("texture memory:");
+    Printf("  %lu blocks resident, %.2f of %.2f MiB", stats.residentBlocks, stats.residentBytes / (1024.0 * 1024.0),
+        stats.budget / (1024.0 * 1024.0));
+    Printf("  %lu blocks purged, %.2f MiB", stats.purgedBlocks, stats.purgedBytes / (1024.0 * 1024.0));
+    Printf("  %lu purges, %lu regenerations this session", stats.purges, stats.regenerations);
+
+    for (const auto& it : memBlocks) {
+        blocks.emplace_back(&it.second);
+    }
+    std::sort(blocks.begin(), blocks.end(), [](const texMemBlock_t *a, const texMemBlock_t *b) { return a->lastUse > b->lastUse; });
+    for (const auto& it : blocks) {
+        Printf("  %-8s %10lu bytes  %s", it->block ? "resident" : "purged", it->size, it->name.c_str());
+    }
+}
+
+static void TexMemBudget_f(void)
+{
+    if (Argc() != 2) {
+        Printf("usage: texMemBudget <megabytes>");
+        return;
+    }
+    TexMem_SetBudget((uint64_t)atoi(Argv(1)) * 1024 * 1024);
+}
+
+void TexMem_Init(uint64_t budget)
+{
+    static bool registered = false;
+
+    memStats.budget = budget;
+    if (!registered) {
+        Cmd_AddCommand("texMemInfo", TexMemInfo_f);
+        Cmd_AddCommand("texMemBudget", TexMemBudget_f);
+        registered = true;
+    }
+}
+
+/*
+TexMem_SetBudget: takes effect at the next TexMem_Collect, a budget of 0 drops every copy as soon as the frame
+that made it is over
+*/
+void TexMem_SetBudget(uint64_t budget)
+{
+    memStats.budget = budget;
+}
+
+void TexMem_GetStats(texMemStats_t *stats)
+{
+    *stats = memStats;
+}
+
+/*
+TexMem_Add: takes ownership of a block from GetMemory and sets *user to it, if user had a block that was purged
+this counts as regenerating it
+*/
+void TexMem_Add(void *block, uint64_t size, void **user, const char *name)
+{
+    texMemBlock_t *b;
+
+    if (!user) {
+        Error("TexMem_Add: block '%s' has no owner", name);
+    }
+
+    auto it = memBlocks.find(user);
+    if (it != memBlocks.end()) {
+        b = &it->second;
+        if (b->block) {
+            if (b->block != block) {
+                FreeMemory(b->block);
+            }
+            memStats.residentBytes -= b->size;
+            memStats.residentBlocks--;
+        }
+        else {
+            memStats.purgedBytes -= b->size;
+            memStats.purgedBlocks--;
+            memStats.regenerations++;
+        }
+    }
+    else {
+        b = &memBlocks[user];
+    }
+
+    b->block = block;
+    b->size = size;
+    b->lastUse = ++memClock;
+    b->name = name;
+    *user = block;
+
+    memStats.residentBytes += size;
+    memStats.residentBlocks++;
+}
+
+/*
+TexMem_Free: frees the owner's block if it's still resident and forgets about it
+*/
+void TexMem_Free(void **user)
+{
+    auto it = memBlocks.find(user);
+
+    if (it == memBlocks.end()) {
+        return;
+    }
+    if (it->second.block) {
+        FreeMemory(it->second.block);
+        memStats.residentBytes -= it->second.size;
+        memStats.residentBlocks--;
+    }
+    else {
+        memStats.purgedBytes -= it->second.size;
+        memStats.purgedBlocks--;
+    }
+    memBlocks.erase(it);
+    *user = NULL;
+}
+
+void TexMem_Touch(void **user)
+{
+    auto it = memBlocks.find(user);
+
+    if (it != memBlocks.end()) {
+        it->second.lastUse = ++memClock;
+    }
+}
+
+/*
+TexMem_Collect: purges down to the budget, called at the start of a frame when nothing is holding on to a block
+*/
+void TexMem_Collect(void)
+{
+    PROFILE_FUNC();
+    TexMem_Purge();
+}
@@ -0,0 +1,35 @@
+#ifndef __TEXMEM__
+#define __TEXMEM__
+
+#pragma once
+
+/*
+cpu side copies of pixels that are already on the gpu, kept around under a budget. Blocks are handed over with the
+address of the pointer that owns them like Z_Malloc's purgeable tags, when one is purged the memory is freed and the
+owner's pointer is set to NULL so it knows to regenerate the pixels the next time it needs them.
+
+Everything in here belongs to the main thread. A block is only ever purged by TexMem_Collect, so a pointer taken out
+of an owner stays good until the start of the next frame.
+*/
+
+#define TEXMEM_DEFAULT_BUDGET (256ULL * 1024 * 1024) // resident bytes before the least recently used blocks are purged
+
+typedef struct {
+    uint64_t budget;
+    uint64_t residentBytes;
+    uint64_t residentBlocks;
+    uint64_t purgedBytes; // blocks that were purged and haven't been asked for again
+    uint64_t purgedBlocks;
+    uint64_t purges; // this session
+    uint64_t regenerations;
+} texMemStats_t;
+
+void TexMem_Init(uint64_t budget = TEXMEM_DEFAULT_BUDGET);
+void TexMem_SetBudget(uint64_t budget);
+void TexMem_GetStats(texMemStats_t *stats);
+void TexMem_Add(void *block, uint64_t size, void **user, const char *name);
+void TexMem_Free(void **user);
+void TexMem_Touch(void **user);
+void TexMem_Collect(void);
+
+#endif
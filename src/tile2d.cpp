@@ -0,0 +1,224 @@
+#include "gln.h"
+#include <filesystem>
+#include <atomic>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+the on-disk layout is the header's fields in order without the sprites pointer, followed by info.numTiles sprites
+*/
+#define TILE2D_HEADER_SIZE (sizeof(uint64_t) * 2 + sizeof(tile2d_info_t))
+
+/*
+Tile2D_GenerateSprites: fills out the uvs of numSprites tiles of a row major sheet, indices picks which tile
+each sprite is (NULL for 0 ... numSprites - 1). The corners go (right, top) (right, bottom) (left, bottom) (left, top)
+in texture space, with the left/top edge of column/row n at n * tileSize / sheetSize.
+*/
+void Tile2D_GenerateSprites(uint32_t sheetWidth, uint32_t sheetHeight, uint32_t tileWidth, uint32_t tileHeight,
+    const uint32_t *indices, uint32_t numSprites, tile2d_sprite_t *out)
+{
+    PROFILE_FUNC();
+    const uint32_t tileCountX = tileWidth ? sheetWidth / tileWidth : 0;
+
+    if (!tileCountX || !sheetHeight) {
+        if (numSprites) {
+            memset(out, 0, sizeof(*out) * numSprites);
+        }
+        return;
+    }
+
+    Job_ParallelFor(numSprites, 4096, [&](uint32_t start, uint32_t end) {
+#if defined(__SSE2__)
+        const __m128 tileSize = _mm_setr_ps(tileWidth, tileHeight, tileWidth, tileHeight);
+        const __m128 sheetSize = _mm_setr_ps(sheetWidth, sheetHeight, sheetWidth, sheetHeight);
+#endif
+
+        for (uint32_t i = start; i < end; i++) {
+            const uint32_t index = indices ? indices[i] : i;
+            const uint32_t x = index % tileCountX;
+            const uint32_t y = index / tileCountX;
+            tile2d_sprite_t *sprite = &out[i];
+
+#if defined(__SSE2__)
+            // edges = { left, top, right, bottom }, the same multiply then divide as the scalar path so they match exactly
+            const __m128 edges = _mm_div_ps(_mm_mul_ps(_mm_setr_ps(x, y, x + 1, y + 1), tileSize), sheetSize);
+
+            _mm_storeu_ps(&sprite->uv[0][0], _mm_shuffle_ps(edges, edges, _MM_SHUFFLE(3, 2, 1, 2)));
+            _mm_storeu_ps(&sprite->uv[2][0], _mm_shuffle_ps(edges, edges, _MM_SHUFFLE(1, 0, 3, 0)));
+#else
+            const float left = ((float)x * tileWidth) / sheetWidth;
+            const float top = ((float)y * tileHeight) / sheetHeight;
+            const float right = ((float)(x + 1) * tileWidth) / sheetWidth;
+            const float bottom = ((float)(y + 1) * tileHeight) / sheetHeight;
+
+            sprite->uv[0][0] = right;
+            sprite->uv[0][1] = top;
+            sprite->uv[1][0] = right;
+            sprite->uv[1][1] = bottom;
+            sprite->uv[2][0] = left;
+            sprite->uv[2][1] = bottom;
+            sprite->uv[3][0] = left;
+            sprite->uv[3][1] = top;
+#endif
+            sprite->index = index;
+        }
+    });
+}
+
+/*
+Tile2D_CachePath: the sheet's path with its extension swapped for .tile2d
+*/
+std::string Tile2D_CachePath(const char *texture)
+{
+    std::filesystem::path path = texture;
+
+    path.replace_extension(TILESET_FILE_EXT);
+    return path.string();
+}
+
+/*
+Tile2D_Map: maps a .tile2d file in, only uncompressed sprites can be used straight from the mapping
+*/
+bool Tile2D_Map(const char *path, tile2dFile_t *file)
+{
+    const byte *data;
+    uint64_t length = 0;
+
+    memset(file, 0, sizeof(*file));
+
+    data = (const byte *)Sys_MapFile(path, &length);
+    if (!data) {
+        return false;
+    }
+    if (length < TILE2D_HEADER_SIZE) {
+        Sys_UnmapFile(data, length);
+        return false;
+    }
+
+    memcpy(&file->header.magic, data, sizeof(uint64_t));
+    memcpy(&file->header.version, data + sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&file->header.info, data + sizeof(uint64_t) * 2, sizeof(tile2d_info_t));
+    if (file->header.magic != TILE2D_MAGIC || file->header.version != TILE2D_VERSION
+        || file->header.info.compression != COMPRESS_NONE
+        || (length - TILE2D_HEADER_SIZE) / sizeof(tile2d_sprite_t) < file->header.info.numTiles)
+    {
+        Sys_UnmapFile(data, length);
+        memset(file, 0, sizeof(*file));
+        return false;
+    }
+
+    file->header.sprites = (tile2d_sprite_t *)(data + TILE2D_HEADER_SIZE);
+    file->data = data;
+    file->length = length;
+
+    return true;
+}
+
+void Tile2D_Unmap(tile2dFile_t *file)
+{
+    if (file->data) {
+        Sys_UnmapFile(file->data, file->length);
+    }
+    else if (file->header.sprites) {
+        FreeMemory(file->header.sprites);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+/*
+Tile2D_Write: writes the header and its sprites under a temporary name of its own first, so that nobody maps a half
+written file and two writers of the same file don't write into each other's. The name has the process id in it as
+well, the editor and bmfc or two batches can be writing the same cache at once.
+*/
+bool Tile2D_Write(const char *path, const tile2d_header_t *header)
+{
+    static std::atomic<uint32_t> numWrites;
+    const std::string tmpPath = std::string(path) + ".tmp" + std::to_string(getpid()) + "." + std::to_string(++numWrites);
+    std::error_code err;
+    FILE *fp;
+    bool ok;
+
+    fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    ok = fwrite(&header->magic, sizeof(header->magic), 1, fp) == 1
+        && fwrite(&header->version, sizeof(header->version), 1, fp) == 1
+        && fwrite(&header->info, sizeof(header->info), 1, fp) == 1
+        && fwrite(header->sprites, sizeof(*header->sprites), header->info.numTiles, fp) == header->info.numTiles;
+    ok = !fclose(fp) && ok;
+
+    if (ok) {
+        std::filesystem::rename(tmpPath, path, err);
+        ok = !err;
+    }
+    if (!ok) {
+        std::filesystem::remove(tmpPath, err);
+    }
+    return ok;
+}
+
+/*
+Tile2D_LoadCached: maps the .tile2d next to the texture if it was written after the texture last changed and is
+for the same tile layout, otherwise the sprites are generated, kept in memory and written out for next time. file is
+released with Tile2D_Unmap either way.
+*/
+bool Tile2D_LoadCached(const char *texture, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t tileWidth, uint32_t tileHeight,
+    tile2dFile_t *file)
+{
+    PROFILE_FUNC();
+    const std::string path = Tile2D_CachePath(texture);
+    const uint32_t tileCountX = tileWidth ? sheetWidth / tileWidth : 0;
+    const uint32_t tileCountY = tileHeight ? sheetHeight / tileHeight : 0;
+    std::filesystem::file_time_type textureTime, cacheTime;
+    std::error_code err;
+    tile2d_header_t header;
+    bool cacheable;
+
+    memset(file, 0, sizeof(*file));
+    if (!tileCountX || !tileCountY) {
+        return false;
+    }
+
+    // without a file on disk there's nothing to tell a stale cache by
+    textureTime = std::filesystem::last_write_time(texture, err);
+    cacheable = !err;
+    if (cacheable) {
+        cacheTime = std::filesystem::last_write_time(path, err);
+    }
+    if (cacheable && !err && cacheTime >= textureTime && Tile2D_Map(path.c_str(), file)) {
+        const tile2d_info_t *info = &file->header.info;
+
+        if (info->tileWidth == tileWidth && info->tileHeight == tileHeight && info->tileCountX == tileCountX
+            && info->tileCountY == tileCountY && info->numTiles == tileCountX * tileCountY)
+        {
+            return true;
+        }
+        Tile2D_Unmap(file);
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = TILE2D_MAGIC;
+    header.version = TILE2D_VERSION;
+    header.info.numTiles = tileCountX * tileCountY;
+    header.info.tileWidth = tileWidth;
+    header.info.tileHeight = tileHeight;
+    header.info.tileCountX = tileCountX;
+    header.info.tileCountY = tileCountY;
+    header.info.compression = COMPRESS_NONE;
+    N_strncpyz(header.info.texture, GetFilename(texture), sizeof(header.info.texture));
+    header.sprites = (tile2d_sprite_t *)GetMemory(sizeof(*header.sprites) * std::max(header.info.numTiles, 1U));
+    Tile2D_GenerateSprites(sheetWidth, sheetHeight, tileWidth, tileHeight, NULL, header.info.numTiles, header.sprites);
+
+    // what was just generated is used rather than mapping the file back in, another layout of the same texture could
+    // have replaced it already
+    if (cacheable) {
+        Tile2D_Write(path.c_str(), &header);
+    }
+    file->header = header;
+    file->data = NULL;
+    file->length = 0;
+    return true;
+}
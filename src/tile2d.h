@@ -0,0 +1,29 @@
+#ifndef __TILE2D__
+#define __TILE2D__
+
+#pragma once
+
+/*
+sprite coordinates of a tile sheet and the .tile2d files they're kept in, written next to the sheet's texture so that
+the editor and the compiler only generate them once for every texture
+*/
+
+/*
+tile2dFile_t: a .tile2d file mapped into memory, header.sprites points into the mapping
+*/
+typedef struct {
+    tile2d_header_t header;
+    const void *data;
+    uint64_t length;
+} tile2dFile_t;
+
+void Tile2D_GenerateSprites(uint32_t sheetWidth, uint32_t sheetHeight, uint32_t tileWidth, uint32_t tileHeight,
+    const uint32_t *indices, uint32_t numSprites, tile2d_sprite_t *out);
+std::string Tile2D_CachePath(const char *texture);
+bool Tile2D_Map(const char *path, tile2dFile_t *file);
+void Tile2D_Unmap(tile2dFile_t *file);
+bool Tile2D_Write(const char *path, const tile2d_header_t *header);
+bool Tile2D_LoadCached(const char *texture, uint32_t sheetWidth, uint32_t sheetHeight, uint32_t tileWidth, uint32_t tileHeight,
+    tile2dFile_t *file);
+
+#endif
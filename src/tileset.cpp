@@ -1,32 +1,128 @@
 #include "gln.h"
 
-void CTileset::GenerateTiles(void)
+/*
+Tileset_TextureReady: the project's sheet finished loading, so the tiles can be cut from it
+*/
+void Tileset_TextureReady(CTexture *texture)
 {
-    auto genCoords = [&](const glm::vec2& sheetDims, const glm::vec2& spriteDims, const glm::vec2& coords, float texcoords[4][2]) {
-        const glm::vec2 min = { ((coords.x + 1) * spriteDims.x) / sheetDims.x, ((coords.y + 1) * spriteDims.y) / sheetDims.y };
-        const glm::vec2 max = { (coords.x * spriteDims.x) / sheetDims.x, (coords.y * spriteDims.y) / sheetDims.y };
-
-        texcoords[0][0] = min.x;
-        texcoords[0][1] = max.y;
+    project->tileset->GenerateTiles();
+}
 
-        texcoords[1][0] = min.x;
-        texcoords[1][1] = min.y;
+/*
+CTileset::GenerateTiles: cuts the sheet into tiles, the coordinates come from the .tile2d next to the texture
+when it's still current
+*/
+void CTileset::GenerateTiles(void)
+{
+    tile2dFile_t file;
 
-        texcoords[2][0] = max.x;
-        texcoords[2][1] = min.y;
-        
-        texcoords[3][0] = max.x;
-        texcoords[3][1] = max.y;
-    };
+    if (!tileWidth || !tileHeight) {
+        return;
+    }
     
     tileCountX = texData->mWidth / tileWidth;
     tileCountY = texData->mHeight / tileHeight;
 
     tiles.resize(tileCountX * tileCountY);
     memset(tiles.data(), 0, sizeof(maptile_t) * tiles.size());
-    for (uint32_t y = 0; y < tileCountY; y++) {
-        for (uint32_t x = 0; x < tileCountX; x++) {
-            genCoords({ texData->mWidth, texData->mHeight }, { tileWidth, tileHeight }, { x, y }, tiles[y * tileCountX + x].texcoords);
+    if (!Tile2D_LoadCached(texData->mName.c_str(), texData->mWidth, texData->mHeight, tileWidth, tileHeight, &file)) {
+        return;
+    }
+    for (uint32_t i = 0; i < tiles.size(); i++) {
+        memcpy(tiles[i].texcoords, file.header.sprites[i].uv, sizeof(tiles[i].texcoords));
+    }
+    Tile2D_Unmap(&file);
+}
+
+void CTileset::ClearTextureArray(void)
+{
+    if (arrayId) {
+        glDeleteTextures(1, (const GLuint *)&arrayId);
+    }
+    arrayId = 0;
+    arrayHash = 0;
+    arrayLayers = 0;
+}
+
+/*
+CTileset::UpdateTextureArray: (re)builds the texture array if the sheet or the tile size changed since the last time,
+the split and the mip chains are done on the cpu by the job system
+*/
+void CTileset::UpdateTextureArray(void)
+{
+    PROFILE_FUNC();
+    CImageArray images;
+    const byte *pixels;
+    GLint min, mag;
+
+    if (arrayId && arrayHash == texData->mHash && arrayTileWidth == tileWidth && arrayTileHeight == tileHeight) {
+        return;
+    }
+
+    ClearTextureArray();
+    if (!texData->IsLoaded() || !tileWidth || !tileHeight
+        || tileWidth > texData->mWidth || tileHeight > texData->mHeight) {
+        return;
+    }
+
+    // the sheet's copy may have been given back to texmem since it was uploaded
+    pixels = texData->Pixels();
+    Image_SplitTiles(pixels, texData->mWidth, texData->mHeight, texData->mChannels, tileWidth, tileHeight, &images);
+
+    // only the tiles that are different from each other take up a layer, and they're mipped once
+    Image_DedupTiles(pixels, texData->mWidth, texData->mHeight, texData->mChannels, tileWidth, tileHeight, &arrayRemap);
+    if (arrayRemap.unique.empty()) {
+        Image_IdentityRemap(images.mLayers, &arrayRemap);
+    }
+    for (uint32_t i = 0; i < arrayRemap.unique.size(); i++) {
+        if (arrayRemap.unique[i] != i) {
+            memcpy(images.Layer(0, i), images.Layer(0, arrayRemap.unique[i]), images.LayerSize(0));
         }
     }
-}
\ No newline at end of file
+    images.mLayers = arrayRemap.unique.size();
+    images.mLevels[0].pixels.resize(images.LayerSize(0) * images.mLayers);
+    Image_GenerateMips(&images);
+
+    // same choices as the sheet, just with the mips blended in when it's filtered
+    switch (gameConfig->mTextureFiltering) {
+    case 0: // Nearest
+        min = GL_NEAREST_MIPMAP_NEAREST;
+        mag = GL_NEAREST;
+        break;
+    case 1: // Linear
+        min = GL_LINEAR_MIPMAP_LINEAR;
+        mag = GL_LINEAR;
+        break;
+    case 2: // Bilinear
+        min = GL_NEAREST_MIPMAP_LINEAR;
+        mag = GL_LINEAR;
+        break;
+    case 3: // Trilinear
+    default:
+        min = GL_LINEAR_MIPMAP_LINEAR;
+        mag = GL_NEAREST;
+        break;
+    };
+
+    glGenTextures(1, (GLuint *)&arrayId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, min);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, mag);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, images.mLevels.size() - 1);
+    for (uint32_t i = 0; i < images.mLevels.size(); i++) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, images.mLevels[i].width, images.mLevels[i].height, images.mLayers, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, images.mLevels[i].pixels.data());
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    arrayHash = texData->mHash;
+    arrayTileWidth = tileWidth;
+    arrayTileHeight = tileHeight;
+    arrayLayers = images.mLayers;
+
+    Printf("[CTileset::UpdateTextureArray] %u layers of %ux%u, %lu mip levels, %u duplicate and %u empty tiles left out",
+        arrayLayers, tileWidth, tileHeight, images.mLevels.size(), arrayRemap.numDuplicates, arrayRemap.numEmpty);
+}
@@ -14,12 +14,27 @@ public:
     uint32_t tileWidth;
     uint32_t tileHeight;
 
+    // GL_TEXTURE_2D_ARRAY with one mipmapped layer per tile, tiles can't bleed into their neighbours
+    // and zoomed out views don't alias
+    uint32_t arrayId;
+    uint64_t arrayHash; // of the texData contents it was built from
+    uint32_t arrayTileWidth;
+    uint32_t arrayTileHeight;
+    uint32_t arrayLayers;
+    tileRemap_t arrayRemap; // duplicate tiles share a layer, empty ones don't get one
+
     CTileset(void)
-        : tileCountX{ 0 }, tileCountY{ 0 }, tileWidth{ 0 }, tileHeight{ 0 }
+        : tileCountX{ 0 }, tileCountY{ 0 }, tileWidth{ 0 }, tileHeight{ 0 }, arrayId{ 0 }, arrayHash{ 0 },
+        arrayTileWidth{ 0 }, arrayTileHeight{ 0 }, arrayLayers{ 0 }
     { }
-    ~CTileset() { }
+    ~CTileset()
+    { ClearTextureArray(); }
 
     void GenerateTiles(void);
+    void UpdateTextureArray(void);
+    void ClearTextureArray(void);
 };
 
+void Tileset_TextureReady(CTexture *texture);
+
 #endif
\ No newline at end of file
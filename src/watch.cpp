@@ -0,0 +1,188 @@
+#include "gln.h"
+#include <filesystem>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    uint32_t flags;
+    uint64_t lastEvent;
+} watchPending_t;
+
+// only touched on the main thread
+static std::vector<watchFunc_t> watchListeners;
+
+#ifdef __linux__
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+
+// only touched by the watcher thread once it's running
+static int watchFd = -1;
+static std::unordered_map<int, std::string> watchDirs;
+
+static void Watch_AddDirectory(const std::string& path)
+{
+    std::error_code err;
+    int wd;
+
+    wd = inotify_add_watch(watchFd, path.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+    if (wd == -1) {
+        return;
+    }
+    watchDirs[wd] = path;
+
+    // inotify doesn't recurse on its own
+    for (const auto& it : std::filesystem::directory_iterator{ path, err }) {
+        if (it.is_directory(err) && !it.is_symlink(err)) {
+            Watch_AddDirectory(it.path().string());
+        }
+    }
+}
+
+static uint32_t Watch_EventFlags(uint32_t mask)
+{
+    uint32_t flags;
+
+    flags = 0;
+    if (mask & (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO)) {
+        flags |= WATCH_MODIFIED;
+    }
+    if (mask & (IN_CREATE | IN_MOVED_TO)) {
+        flags |= WATCH_CREATED;
+    }
+    if (mask & (IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF)) {
+        flags |= WATCH_DELETED;
+    }
+    return flags;
+}
+
+/*
+Watch_Thread: collects the events of every watched directory and hands each changed path to the main thread once
+it's been quiet for WATCH_DEBOUNCE_MSEC
+*/
+static void Watch_Thread(void)
+{
+    alignas(struct inotify_event) char buf[8192];
+    std::unordered_map<std::string, watchPending_t> pending;
+    std::vector<std::pair<std::string, uint32_t>> ready;
+    struct pollfd pfd;
+    ssize_t len;
+    uint64_t now;
+
+    Profile_SetThreadName("File Watcher");
+
+    pfd.fd = watchFd;
+    pfd.events = POLLIN;
+    while (1) {
+        if (poll(&pfd, 1, pending.empty() ? -1 : WATCH_DEBOUNCE_MSEC / 2) > 0) {
+            len = read(watchFd, buf, sizeof(buf));
+            now = Sys_Microseconds();
+
+            for (char *p = buf; len > 0 && p < buf + len; ) {
+                const struct inotify_event *e = (const struct inotify_event *)p;
+                p += sizeof(*e) + e->len;
+
+                if (e->mask & IN_IGNORED) {
+                    watchDirs.erase(e->wd);
+                    continue;
+                }
+                auto dir = watchDirs.find(e->wd);
+                if (dir == watchDirs.end()) {
+                    continue;
+                }
+
+                const std::string path = e->len ? dir->second + PATH_SEP + e->name : dir->second;
+                if ((e->mask & IN_ISDIR) && (e->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    Watch_AddDirectory(path);
+                }
+
+                watchPending_t *w = &pending[path];
+                w->flags |= Watch_EventFlags(e->mask);
+                w->lastEvent = now;
+            }
+        }
+
+        now = Sys_Microseconds();
+        for (auto it = pending.begin(); it != pending.end(); ) {
+            if (now - it->second.lastEvent >= WATCH_DEBOUNCE_MSEC * 1000) {
+                ready.emplace_back(it->first, it->second.flags);
+                it = pending.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        if (ready.empty()) {
+            continue;
+        }
+
+        // the listeners run at the next frame boundary so they can swap things in without locking
+        Job_QueueMain([changed = std::move(ready)](void) {
+            PROFILE_SCOPE("Watch_Dispatch");
+            for (const auto& it : changed) {
+                for (const auto& func : watchListeners) {
+                    func(it.first, it.second);
+                }
+            }
+        });
+        ready.clear();
+    }
+}
+#endif
+
+/*
+Watch_Init: starts watching everything under path, changes are reported to the listeners on the main thread
+*/
+void Watch_Init(const char *path)
+{
+#ifdef __linux__
+    std::error_code err;
+    std::string dir;
+
+    if (watchFd != -1) {
+        return;
+    }
+
+    dir = std::filesystem::weakly_canonical(std::filesystem::absolute(path, err), err).string();
+    if (dir.size() > 1 && dir.back() == PATH_SEP) {
+        dir.pop_back();
+    }
+
+    watchFd = inotify_init1(IN_CLOEXEC);
+    if (watchFd == -1) {
+        Printf("Watch_Init: inotify_init1 failed, %s", strerror(errno));
+        return;
+    }
+    Watch_AddDirectory(dir);
+    if (watchDirs.empty()) {
+        Printf("Watch_Init: failed to watch '%s', hot reloading is disabled", dir.c_str());
+        return;
+    }
+
+    Printf("Watch_Init: watching %lu directories under '%s'", watchDirs.size(), dir.c_str());
+    boost::thread(Watch_Thread).detach();
+#else
+    Printf("Watch_Init: file watching isn't supported on this platform, hot reloading is disabled");
+#endif
+}
+
+void Watch_AddListener(const watchFunc_t& func)
+{
+    watchListeners.emplace_back(func);
+}
+
+/*
+Watch_SamePath: the watcher reports absolute paths while the editor keeps whatever it was given, so both are
+normalized before comparing
+*/
+bool Watch_SamePath(const std::string& a, const std::string& b)
+{
+    std::error_code err;
+
+    if (a.empty() || b.empty()) {
+        return false;
+    }
+    return std::filesystem::weakly_canonical(std::filesystem::absolute(a, err), err)
+        == std::filesystem::weakly_canonical(std::filesystem::absolute(b, err), err);
+}
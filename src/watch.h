@@ -0,0 +1,20 @@
+#ifndef __WATCH__
+#define __WATCH__
+
+#pragma once
+
+// how long a file has to go without events before its changes are handed out, editors tend to save in bursts
+#define WATCH_DEBOUNCE_MSEC 100
+
+// watchFunc_t flags, a burst can have more than one
+#define WATCH_MODIFIED 0x1
+#define WATCH_CREATED 0x2
+#define WATCH_DELETED 0x4
+
+typedef std::function<void(const std::string& path, uint32_t flags)> watchFunc_t;
+
+void Watch_Init(const char *path);
+void Watch_AddListener(const watchFunc_t& func);
+bool Watch_SamePath(const std::string& a, const std::string& b);
+
+#endif
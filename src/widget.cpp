@@ -1,4 +1,5 @@
 #include "gln.h"
+#include <algorithm>
 
 static constexpr ImVec2 FileDlgWindowSize = ImVec2( 1012, 641 );
 
@@ -257,7 +258,11 @@ typedef struct {
 } mapGlobals_t;
 
 typedef struct {
+    char tileSearch[64];
+    int tileShow;
+    int tileSort;
     bool tilesetOpen;
+    bool profilerOpen;
 } viewGlobals_t;
 
 typedef struct {
@@ -338,6 +343,9 @@ static INLINE void Update_Graphics(void)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag);
 
         texture->Unbind();
+
+        // gets rebuilt with the new filters the next time the map is drawn
+        project->tileset->ClearTextureArray();
     }
 
     UPDATE_VAR(gameConfig->mTextureDetail, g->textureDetails, g->textureDetailsChanged);
@@ -368,6 +376,8 @@ static INLINE void Update_Map(void)
         memcpy(&mapData->mAmbientColor[0], g->ambientColor, sizeof(vec3_t));
         g->ambientColorChanged = false;
     }
+
+    mapData->mLightmap.mValid = false;
 }
 
 static INLINE void Update_Tileset(void)
@@ -385,6 +395,34 @@ static INLINE void Update_Tileset(void)
 }
 
 
+/*
+File_IndexList: every indexed file with the given extension as menu items, returns the one that was clicked on
+*/
+static const CFileEntry *File_IndexList(const char *ext)
+{
+    const std::vector<CFileEntry *>& files = editor->mFileTree.FindByExtension(ext);
+    const CFileEntry *selected;
+    ImGuiListClipper clipper;
+
+    if (files.empty()) {
+        ImGui::TextDisabled("%s", editor->mFileTree.IsScanning() ? "(indexing...)" : "(none)");
+        return NULL;
+    }
+
+    selected = NULL;
+    clipper.Begin(files.size());
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            ImGui::PushID(files[i]);
+            if (ItemWithTooltip(files[i]->mName.c_str(), "%s", files[i]->mPath.c_str())) {
+                selected = files[i];
+            }
+            ImGui::PopID();
+        }
+    }
+    return selected;
+}
+
 static void File_Menu(void)
 {
     if (ImGui::BeginMenu("Project")) {
@@ -403,6 +441,24 @@ static void File_Menu(void)
         if (ImGui::MenuItem("Open Map")) {
             ImGuiFileDialog::Instance()->OpenDialog("SelectMapDlg", "Select File", ".map, .bmf, .*", gameConfig->mEditorPath);
         }
+        ImGui::Separator();
+        // straight out of the file tree's index, no directory walk
+        const CFileEntry *entry = File_IndexList("map");
+        if (entry) {
+            Map_Load(entry->mPath.c_str());
+        }
+        ImGui::EndMenu();
+    }
+    if (ImGui::BeginMenu("Browse")) {
+        const CFileEntry *file = editor->mFileTree.Root() ? Draw_FileList(editor->mFileTree.Root()) : NULL;
+        if (file) {
+            if (!N_stricmp(GetExtension(file->mPath.c_str()), "map")) {
+                Map_Load(file->mPath.c_str());
+            }
+            else if (!N_stricmp(GetExtension(file->mPath.c_str()), "proj")) {
+                Project_Load(file->mPath.c_str());
+            }
+        }
         ImGui::EndMenu();
     }
 }
@@ -429,6 +485,9 @@ static void Build_Menu(void)
     if (ItemWithTooltip("Compile Map", "Compile a .map file into a .bmf file,\nNOTE: .bmf files cannot be used in the map editor")) {
 
     }
+    if (ItemWithTooltip("Bake Lighting", "Bake the static lights into a per-tile lightmap,\nthe preview samples it instead of lighting every pixel")) {
+        Cmd_ExecuteText("bakeLighting");
+    }
 }
 
 static void Edit_Graphics(void)
@@ -635,6 +694,9 @@ static void TileMode(void)
             const glm::vec4 color = NormalToRGBA({ g->color[0], g->color[1], g->color[2], 1 });
             memcpy(mapData->mVertices[tileMode.curY * mapData->mWidth + tileMode.curX].color, &color[0], sizeof(vec4_t));
 
+            // the shadows were cast against the old tile, the next light edit or bake redoes all of them
+            mapData->mLightmap.mValid = false;
+
             g->open = false;
         }
     }
@@ -731,6 +793,7 @@ static void Edit_Lighting(void)
 {
     lightGlobals_t *g = &globals->light;
     maplight_t *l;
+    maplight_t preview;
     bool open;
     const int index = globals->map.editingLightIndex;
 
@@ -742,6 +805,7 @@ static void Edit_Lighting(void)
     CHECK_VAR(g->x, l->origin[0], !g->xChanged);
     CHECK_VAR(g->y, l->origin[1], !g->yChanged);
     CHECK_VAR(g->brightness, l->brightness, !g->brightnessChanged);
+    CHECK_VAR(g->range, l->range, !g->rangeChanged);
     if (!g->colorChanged) {
         memcpy(&g->color[0], l->color, sizeof(vec4_t));
     }
@@ -783,9 +847,26 @@ static void Edit_Lighting(void)
 
             open = false;
         }
+
+        // relight only the tiles the light reaches while it's being edited
+        preview = *l;
+        preview.origin[0] = g->x;
+        preview.origin[1] = g->y;
+        preview.brightness = g->brightness;
+        preview.range = g->range;
+        memcpy(preview.color, &g->color[0], sizeof(vec4_t));
+        if (open) {
+            Lightmap_UpdateLight(mapData.get(), &mapData->mLightmap, index, &preview);
+        }
     }
     ImGui::End();
 
+    if (!open) {
+        // puts back the unsaved changes' lighting, then clears out the error from the edit
+        Lightmap_UpdateLight(mapData.get(), &mapData->mLightmap, index, l);
+        Lightmap_Flush(&mapData->mLightmap);
+    }
+
     globals->map.editingLight = open;
 }
 
@@ -851,12 +932,12 @@ static void Edit_Tileset(void)
 
         if (ButtonWithTooltip(va("(Diffuse) Texture Path: %s", tileset->texData->mName.size() ? tileset->texData->mName.c_str() : "None"),
         "Change the (diffuse) texture path of the current tileset")) {
-            ImGuiFileDialog::Instance()->OpenDialog("SelectDiffuseTexturePathDlg", "Select File", ".png, .bmp, .jpeg, .tga, .pcx, .*", gameConfig->mEditorPath);
+            ImGuiFileDialog::Instance()->OpenDialog("SelectDiffuseTexturePathDlg", "Select File", ".qoi, .png, .bmp, .jpeg, .tga, .pcx, .*", gameConfig->mEditorPath);
             g->changed = true;
         }
         if (ButtonWithTooltip(va("(Normal) Texture Path: %s", tileset->normalData->mName.size() ? tileset->normalData->mName.c_str() : "None"),
         "Change the (normal) texture path of the current tileset")) {
-            ImGuiFileDialog::Instance()->OpenDialog("SelectNormalTexturePathDlg", "Select File", ".png, .bmp, .jpeg, .tga, .pcx, .*", gameConfig->mEditorPath);
+            ImGuiFileDialog::Instance()->OpenDialog("SelectNormalTexturePathDlg", "Select File", ".qoi, .png, .bmp, .jpeg, .tga, .pcx, .*", gameConfig->mEditorPath);
             g->changed = true;
         }
 
@@ -1021,14 +1102,126 @@ static void Edit_Map(void)
     ImGui::End();
 }
 
+#define PALETTE_USAGE_MSEC 250 // how often the map is recounted while the palette is open
+
+typedef enum {
+    PALETTE_SHOW_ALL,
+    PALETTE_SHOW_USED,
+    PALETTE_SHOW_UNUSED
+} paletteShow_t;
+
+typedef enum {
+    PALETTE_SORT_INDEX,
+    PALETTE_SORT_MOST_USED,
+    PALETTE_SORT_LEAST_USED
+} paletteSort_t;
+
+/*
+paletteState_t: the palette's filtered and sorted tile list, only redone when the filter or the usage counts change
+*/
+typedef struct {
+    std::vector<uint32_t> usage; // how many map tiles use each tileset tile
+    std::vector<uint32_t> visible; // tileset indices in display order
+    char search[64];
+    int show;
+    int sort;
+    uint64_t lastCount;
+} paletteState_t;
+
+static paletteState_t palette;
+
+static void Palette_Update(const viewGlobals_t *g, uint32_t numTiles)
+{
+    PROFILE_FUNC();
+    const uint64_t now = Sys_Microseconds();
+    const uint64_t numMapTiles = std::min((uint64_t)mapData->mWidth * mapData->mHeight, (uint64_t)mapData->mTiles.size());
+    std::vector<uint32_t> usage;
+    uint32_t first, last;
+    bool changed;
+
+    changed = numTiles != palette.usage.size() || g->tileShow != palette.show || g->tileSort != palette.sort
+        || strcmp(g->tileSearch, palette.search);
+    if (!changed && now - palette.lastCount < PALETTE_USAGE_MSEC * 1000) {
+        return;
+    }
+
+    usage.assign(numTiles, 0);
+    for (uint64_t i = 0; i < numMapTiles; i++) {
+        const int32_t index = mapData->mTiles[i].index;
+
+        if (index >= 0 && (uint32_t)index < numTiles) {
+            usage[index]++;
+        }
+    }
+    palette.lastCount = now;
+    if (!changed && usage == palette.usage) {
+        return;
+    }
+    palette.usage = std::move(usage);
+    palette.show = g->tileShow;
+    palette.sort = g->tileSort;
+    N_strncpyz(palette.search, g->tileSearch, sizeof(palette.search));
+
+    // "12" is tile 12, "10-20" is a range, anything else shows every tile
+    first = 0;
+    last = numTiles ? numTiles - 1 : 0;
+    if (sscanf(palette.search, "%u-%u", &first, &last) == 1) {
+        last = first;
+    }
+
+    palette.visible.clear();
+    for (uint32_t i = first; i <= last && i < numTiles; i++) {
+        if ((palette.show == PALETTE_SHOW_USED && !palette.usage[i]) || (palette.show == PALETTE_SHOW_UNUSED && palette.usage[i])) {
+            continue;
+        }
+        palette.visible.emplace_back(i);
+    }
+
+    if (palette.sort == PALETTE_SORT_MOST_USED) {
+        std::stable_sort(palette.visible.begin(), palette.visible.end(),
+            [](uint32_t a, uint32_t b) { return palette.usage[a] > palette.usage[b]; });
+    }
+    else if (palette.sort == PALETTE_SORT_LEAST_USED) {
+        std::stable_sort(palette.visible.begin(), palette.visible.end(),
+            [](uint32_t a, uint32_t b) { return palette.usage[a] < palette.usage[b]; });
+    }
+}
+
+static void Palette_TilePreview(const CTileset *tileset, uint32_t index, const ImVec2& size, const ImVec2& min, const ImVec2& max)
+{
+    ImGui::BeginTooltip();
+    ImGui::Image((ImTextureID)(uint64_t)tileset->texData->mId, ImVec2( size.x * 2, size.y * 2 ), min, max);
+    ImGui::Text("Tile %u (%u, %u)", index, index % tileset->tileCountX, index / tileset->tileCountX);
+    ImGui::Text("Used %u times", palette.usage[index]);
+    if (tileset->arrayId && index < tileset->arrayRemap.remap.size()) {
+        const int32_t layer = tileset->arrayRemap.remap[index];
+
+        if (layer == TILE_EMPTY) {
+            ImGui::TextDisabled("empty");
+        }
+        else if (tileset->arrayRemap.unique[layer] != index) {
+            ImGui::TextDisabled("same as tile %u", tileset->arrayRemap.unique[layer]);
+        }
+    }
+    ImGui::EndTooltip();
+}
+
+/*
+View_Tileset: the tile palette, laid out in rows of as many tiles as fit and clipped so that only the rows in view
+are submitted
+*/
 static void View_Tileset(void)
 {
     viewGlobals_t *g = &globals->view;
     const std::shared_ptr<CTileset>& tileset = project->tileset;
     const std::shared_ptr<CTexture>& texture = tileset->texData;
+    const ImGuiStyle& style = ImGui::GetStyle();
     ImVec2 textureSize = { tileset->tileWidth, tileset->tileHeight };
+    ImGuiListClipper clipper;
     ImVec2 min, max;
     const maptile_t *tile;
+    maptile_t *current;
+    uint32_t perRow, numRows;
 
     if (!g->tilesetOpen) {
         return;
@@ -1036,24 +1229,69 @@ static void View_Tileset(void)
 
     textureSize = clamp(textureSize, ImVec2( 64, 64 ), ImVec2( 128, 128 ));
 
-    if (ImGui::Begin("Tiles", &g->tilesetOpen, ImGuiWindowFlags_AlwaysAutoResize)) {
-        for (uint32_t y = 0; y < tileset->tileCountY; y++) {
-            for (uint32_t x = 0; x < tileset->tileCountX; x++) {
-                tile = &tileset->tiles[y * tileset->tileCountX + x];
-                ImGui_Quad_TexCoords(tile->texcoords, min, max);
+    ImGui::SetNextWindowSize(ImVec2( 480, 520 ), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Tiles", &g->tilesetOpen)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::SetNextItemWidth(120);
+    ImGui::InputTextWithHint("##TileSearch", "index or a-b", g->tileSearch, sizeof(g->tileSearch));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(90);
+    ImGui::Combo("##TileShow", &g->tileShow, "All\0Used\0Unused\0");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(110);
+    ImGui::Combo("Sort", &g->tileSort, "Index\0Most Used\0Least Used\0");
+
+    Palette_Update(g, tileset->tiles.size());
+    ImGui::TextDisabled("%lu of %lu tiles", palette.visible.size(), tileset->tiles.size());
+
+    // the cursor can be left past the edge by a resize or a smaller map being loaded, picking is off until it's moved
+    current = NULL;
+    if (tileMode.curX >= 0 && tileMode.curY >= 0 && (uint32_t)tileMode.curX < mapData->mWidth
+        && (uint32_t)tileMode.curY < mapData->mHeight
+        && (uint64_t)tileMode.curY * mapData->mWidth + tileMode.curX < mapData->mTiles.size())
+    {
+        current = &mapData->mTiles[(uint64_t)tileMode.curY * mapData->mWidth + tileMode.curX];
+    }
+    if (ImGui::BeginChild("##Palette")) {
+        perRow = std::max(1.0f, (ImGui::GetContentRegionAvail().x + style.ItemSpacing.x)
+            / (textureSize.x + style.FramePadding.x * 2 + style.ItemSpacing.x));
+        numRows = (palette.visible.size() + perRow - 1) / perRow;
+
+        clipper.Begin(numRows, textureSize.y + style.FramePadding.y * 2 + style.ItemSpacing.y);
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                const uint32_t end = std::min((uint32_t)palette.visible.size(), (row + 1) * perRow);
+
+                for (uint32_t i = row * perRow; i < end; i++) {
+                    const uint32_t index = palette.visible[i];
 
-                ImGui::PushID(1);
-                if (ImGui::ImageButton((ImTextureID)(uint64_t)texture->mId, textureSize, min, max) || ImGui::IsItemClicked()) {
-                    maptile_t *t = &mapData->mTiles[tileMode.curY * mapData->mWidth + tileMode.curX];
-                    memcpy(t->texcoords, tile->texcoords, sizeof(t->texcoords));
-                    t->index = y * tileset->tileCountX + x;
+                    tile = &tileset->tiles[index];
+                    ImGui_Quad_TexCoords(tile->texcoords, min, max);
+
+                    if (i != row * perRow) {
+                        ImGui::SameLine();
+                    }
+                    ImGui::PushID(index);
+                    if (ImGui::ImageButton((ImTextureID)(uint64_t)texture->mId, textureSize, min, max) && current) {
+                        memcpy(current->texcoords, tile->texcoords, sizeof(current->texcoords));
+                        current->index = index;
+                    }
+                    if (current && current->index == (int32_t)index) {
+                        ImGui::GetWindowDrawList()->AddRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(),
+                            IM_COL32( 255, 255, 0, 255 ), 0.0f, 0, 2.0f);
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        Palette_TilePreview(tileset.get(), index, textureSize, min, max);
+                    }
+                    ImGui::PopID();
                 }
-                ImGui::PopID();
-                ImGui::SameLine();
             }
-            ImGui::NewLine();
         }
     }
+    ImGui::EndChild();
     ImGui::End();
 }
 
@@ -1062,10 +1300,14 @@ static void View_Menu(void)
     if (ImGui::MenuItem("Tileset")) {
         globals->view.tilesetOpen = true;
     }
+    if (ItemWithTooltip("Profiler", "Frame times and the most expensive scopes,\nuse /profileDump to save a trace")) {
+        globals->view.profilerOpen = true;
+    }
 }
 
 void Widgets_Draw(void)
 {
+    PROFILE_FUNC();
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("File")) {
             File_Menu();
@@ -1092,13 +1334,14 @@ void Widgets_Draw(void)
     Edit_Checkpoint();
     Edit_Spawn();
     View_Tileset();
+    Profile_DrawOverlay(&globals->view.profilerOpen);
     TileMode();
 
     configGlobals_t *g = &globals->config;
     if (ImGuiFileDialog::Instance()->IsOpened("SelectDiffuseTexturePathDlg")) {
         if (ImGuiFileDialog::Instance()->Display("SelectDiffuseTexturePathDlg", ImGuiWindowFlags_NoResize, FileDlgWindowSize, FileDlgWindowSize)) {
             if (ImGuiFileDialog::Instance()->IsOk()) {
-                project->tileset->texData->Load(ImGuiFileDialog::Instance()->GetFilePathName());
+                project->tileset->texData->Load(ImGuiFileDialog::Instance()->GetFilePathName(), Tileset_TextureReady);
             }
             ImGuiFileDialog::Instance()->Close();
         }